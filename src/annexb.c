@@ -0,0 +1,208 @@
+/**
+ * @file annexb.c
+ * @brief Start code search and emulation prevention removal, SIMD kernels
+ */
+
+#include <string.h>
+
+#include <xrtp_bytes.h>
+
+#include "annexb.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+# define ANNEXB_X86 1
+# include <immintrin.h>
+# if defined(_MSC_VER)
+#  include <intrin.h>
+#  define ANNEXB_TARGET( t )
+# else
+#  define ANNEXB_TARGET( t ) __attribute__((target( t )))
+# endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+# define ANNEXB_NEON 1
+# include <arm_neon.h>
+#endif
+
+/* first p where p[0] == 0, p[1] == 0 and p[2] == x, p_end if none */
+typedef const uint8_t *(*annexb_find_t)( const uint8_t *p, const uint8_t *p_end, uint8_t x );
+
+static const uint8_t *
+find_c ( const uint8_t *p, const uint8_t *p_end, uint8_t x )
+{
+    /* p[2] rules out up to 3 positions at once (x is 1 or 3) */
+    while( p + 2 < p_end )
+    {
+        if( p[2] > x )
+            p += 3;
+        else if( p[1] )
+            p += 2;
+        else if( p[0] || p[2] != x )
+            p++;
+        else
+            return p;
+    }
+
+    return p_end;
+}
+
+#if defined(ANNEXB_X86)
+ANNEXB_TARGET( "sse2" ) static const uint8_t *
+find_sse2 ( const uint8_t *p, const uint8_t *p_end, uint8_t x )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i third = _mm_set1_epi8( (char)x );
+
+    /* 16 candidates per round, each needs its 2 next bytes */
+    while( p_end - p >= 18 )
+    {
+        __m128i a = _mm_loadu_si128( (const __m128i *)p );
+        __m128i b = _mm_loadu_si128( (const __m128i *)(p + 1) );
+        __m128i c = _mm_loadu_si128( (const __m128i *)(p + 2) );
+        __m128i m = _mm_and_si128( _mm_and_si128( _mm_cmpeq_epi8( a, zero ),
+                                                  _mm_cmpeq_epi8( b, zero ) ),
+                                   _mm_cmpeq_epi8( c, third ) );
+        unsigned i_mask = (unsigned)_mm_movemask_epi8( m );
+
+        if( i_mask )
+            return p + xrtp_ctz32( i_mask );
+        p += 16;
+    }
+
+    return find_c( p, p_end, x );
+}
+
+ANNEXB_TARGET( "avx2" ) static const uint8_t *
+find_avx2 ( const uint8_t *p, const uint8_t *p_end, uint8_t x )
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i third = _mm256_set1_epi8( (char)x );
+
+    while( p_end - p >= 34 )
+    {
+        __m256i a = _mm256_loadu_si256( (const __m256i *)p );
+        __m256i b = _mm256_loadu_si256( (const __m256i *)(p + 1) );
+        __m256i c = _mm256_loadu_si256( (const __m256i *)(p + 2) );
+        __m256i m = _mm256_and_si256( _mm256_and_si256( _mm256_cmpeq_epi8( a, zero ),
+                                                        _mm256_cmpeq_epi8( b, zero ) ),
+                                      _mm256_cmpeq_epi8( c, third ) );
+        uint32_t i_mask = (uint32_t)_mm256_movemask_epi8( m );
+
+        if( i_mask )
+            return p + xrtp_ctz32( i_mask );
+        p += 32;
+    }
+
+    return find_sse2( p, p_end, x );
+}
+
+static int
+cpu_avx2 ( void )
+{
+#if defined(_MSC_VER)
+    int r[4];
+
+    __cpuid( r, 0 );
+    if( r[0] < 7 )
+        return 0;
+    __cpuid( r, 1 );
+    /* OSXSAVE and AVX, and the OS saves the YMM registers */
+    if( (r[2] & 0x18000000) != 0x18000000 || (_xgetbv( 0 ) & 6) != 6 )
+        return 0;
+    __cpuidex( r, 7, 0 );
+    return (r[1] & 0x20) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" );
+#endif
+}
+#endif
+
+#if defined(ANNEXB_NEON)
+static const uint8_t *
+find_neon ( const uint8_t *p, const uint8_t *p_end, uint8_t x )
+{
+    const uint8x16_t zero  = vdupq_n_u8( 0 );
+    const uint8x16_t third = vdupq_n_u8( x );
+
+    while( p_end - p >= 18 )
+    {
+        uint8x16_t m = vandq_u8( vandq_u8( vceqq_u8( vld1q_u8( p ), zero ),
+                                           vceqq_u8( vld1q_u8( p + 1 ), zero ) ),
+                                 vceqq_u8( vld1q_u8( p + 2 ), third ) );
+        /* 4 bits per byte */
+        uint64_t i_mask = vget_lane_u64( vreinterpret_u64_u8(
+                              vshrn_n_u16( vreinterpretq_u16_u8( m ), 4 ) ), 0 );
+
+        if( i_mask )
+            return p + (xrtp_ctz64( i_mask ) >> 2);
+        p += 16;
+    }
+
+    return find_c( p, p_end, x );
+}
+#endif
+
+static annexb_find_t pf_find = find_c;
+
+const char *annexb_init( void )
+{
+#if defined(ANNEXB_X86)
+    if( cpu_avx2() )
+    {
+        pf_find = find_avx2;
+        return "avx2";
+    }
+    /* always there on x86_64, assumed on the 32 bits builds */
+    pf_find = find_sse2;
+    return "sse2";
+#elif defined(ANNEXB_NEON)
+    pf_find = find_neon;
+    return "neon";
+#else
+    pf_find = find_c;
+    return "c";
+#endif
+}
+
+int annexb_select( const char *psz_kernel )
+{
+    if( !strcmp( psz_kernel, "c" ) )
+        pf_find = find_c;
+#if defined(ANNEXB_X86)
+    else if( !strcmp( psz_kernel, "sse2" ) )
+        pf_find = find_sse2;
+    else if( !strcmp( psz_kernel, "avx2" ) && cpu_avx2() )
+        pf_find = find_avx2;
+#elif defined(ANNEXB_NEON)
+    else if( !strcmp( psz_kernel, "neon" ) )
+        pf_find = find_neon;
+#endif
+    else
+        return -1;
+
+    return 0;
+}
+
+const uint8_t *annexb_find_startcode( const uint8_t *p, const uint8_t *p_end )
+{
+    return pf_find( p, p_end, 0x01 );
+}
+
+int annexb_unescape( uint8_t *p_dst, const uint8_t *p_src, int i_src )
+{
+    const uint8_t *p_end = p_src + i_src;
+    uint8_t *p_out = p_dst;
+
+    while( p_src < p_end )
+    {
+        /* copy up to and with the 00 00, drop the 03 */
+        const uint8_t *p = pf_find( p_src, p_end, 0x03 );
+        size_t i_copy = p < p_end ? (size_t)(p + 2 - p_src) : (size_t)(p_end - p_src);
+
+        memmove( p_out, p_src, i_copy );
+        p_out += i_copy;
+        p_src += i_copy + (p < p_end);
+    }
+
+    return (int)(p_out - p_dst);
+}
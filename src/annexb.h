@@ -0,0 +1,29 @@
+#ifndef _ANNEXB_H_
+#define _ANNEXB_H_
+
+#include <stdint.h>
+
+/*
+ * Annex B byte stream helpers for the full payload inspections: start
+ * code search and emulation prevention removal (the bit reader drops the
+ * emulation prevention bytes itself, as it reads).
+ *
+ * Both are built on one kernel looking for 00 00 xx, with SSE2, AVX2
+ * and NEON versions. annexb_init() picks the best one the CPU runs,
+ * the plain C one is used until then. annexb_bench compares them.
+ */
+
+/* selects the kernel, returns its name */
+const char    *annexb_init( void );
+/* selects a kernel by name: c, sse2, avx2, neon; -1 if not available */
+int            annexb_select( const char *psz_kernel );
+
+/* first 00 00 01 in [p, p_end), p_end if none; a 4 bytes start code
+ * is found at its second byte */
+const uint8_t *annexb_find_startcode( const uint8_t *p, const uint8_t *p_end );
+
+/* copies a NAL unit without its 00 00 03 emulation prevention bytes,
+ * p_dst may be p_src; returns the size written (at most i_src) */
+int            annexb_unescape( uint8_t *p_dst, const uint8_t *p_src, int i_src );
+
+#endif //_ANNEXB_H_
@@ -0,0 +1,176 @@
+/**
+ * @file annexb_bench.c
+ * @brief Start code search and unescape kernels against the plain C one
+ *
+ * annexb_bench [MB]: scans a buffer of emulation prevented NAL units
+ * with every kernel the CPU runs, then removes its emulation prevention
+ * bytes. Checks that each kernel finds the same start codes and writes
+ * the same bytes as the C kernel, and prints their throughput. Exits
+ * with 1 on a mismatch.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "annexb.h"
+
+#define BENCH_ROUNDS    8
+
+static const char *kernels[] = { "c", "sse2", "avx2", "neon" };
+
+static uint32_t i_seed = 1;
+
+static uint32_t bench_rand( void )
+{
+    i_seed = i_seed * 1103515245 + 12345;
+    return i_seed >> 8;
+}
+
+/* NAL units of 16 bytes to 32 KB behind 3 or 4 bytes start codes, one
+ * byte in 8 zero so that the 00 00 candidates are frequent */
+static size_t bench_fill( uint8_t *p, size_t i_size )
+{
+    size_t i = 0;
+
+    while( i + 4 + 32768 + 32768 / 2 < i_size )
+    {
+        size_t i_nal = 16 + bench_rand() % 32768, n;
+        int i_zeros = 0;
+
+        if( bench_rand() & 1 )
+            p[i++] = 0;
+        p[i++] = 0; p[i++] = 0; p[i++] = 1;
+
+        p[i++] = 0x41;                          /* a NAL header */
+        for( n = 1; n < i_nal; n++ )
+        {
+            uint8_t b = bench_rand() % 8 ? (uint8_t)bench_rand() : 0;
+
+            /* emulation prevention */
+            if( i_zeros >= 2 && b <= 3 )
+            {
+                p[i++] = 3;
+                i_zeros = 0;
+            }
+            p[i++] = b;
+            i_zeros = b ? 0 : i_zeros + 1;
+        }
+        if( i_zeros )
+            p[i++] = 0x80;                      /* rbsp trailing bits */
+    }
+
+    return i;
+}
+
+/* start codes found, and the sum of their offsets */
+static size_t bench_scan( const uint8_t *p, size_t i_size, uint64_t *pi_sum )
+{
+    const uint8_t *p_end = p + i_size;
+    const uint8_t *s = annexb_find_startcode( p, p_end );
+    size_t i_count = 0;
+
+    *pi_sum = 0;
+    while( s < p_end )
+    {
+        i_count++;
+        *pi_sum += (uint64_t)(s - p);
+        s = annexb_find_startcode( s + 3, p_end );
+    }
+
+    return i_count;
+}
+
+static uint64_t bench_hash( const uint8_t *p, size_t i_size )
+{
+    uint64_t i_hash = 0;
+    size_t   i;
+
+    for( i = 0; i < i_size; i++ )
+        i_hash = i_hash * 31 + p[i];
+
+    return i_hash;
+}
+
+static double bench_rate( size_t i_size, clock_t t )
+{
+    double f_seconds = (double)(clock() - t) / CLOCKS_PER_SEC;
+
+    return f_seconds > 0 ? BENCH_ROUNDS * (double)i_size / f_seconds / 1e9 : 0.;
+}
+
+int main( int argc, char **argv )
+{
+    size_t   i_allocated = (size_t)(argc > 1 ? atoi( argv[1] ) : 64) << 20;
+    uint8_t *p = (uint8_t *)malloc( i_allocated );
+    uint8_t *p_dst = (uint8_t *)malloc( i_allocated );
+    size_t   i_size, i_ref = 0, i_ref_out = 0;
+    uint64_t i_ref_sum = 0, i_ref_hash = 0;
+    unsigned i, k;
+    int      i_ret = 0;
+
+    if( p == NULL || p_dst == NULL || i_allocated < (1 << 20) || i_allocated > INT_MAX )
+    {
+        fprintf( stderr, "usage: annexb_bench [MB], at least 1, below 2048\n" );
+        free( p );
+        free( p_dst );
+        return 2;
+    }
+
+    i_size = bench_fill( p, i_allocated );
+
+    for( k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++ )
+    {
+        uint64_t i_sum = 0, i_hash = 0;
+        size_t   i_count = 0, i_out = 0;
+        clock_t  t;
+        double   f_find, f_unescape;
+
+        if( annexb_select( kernels[k] ) < 0 )
+        {
+            printf( "%-5s not available\n", kernels[k] );
+            continue;
+        }
+
+        t = clock();
+        for( i = 0; i < BENCH_ROUNDS; i++ )
+            i_count = bench_scan( p, i_size, &i_sum );
+        f_find = bench_rate( i_size, t );
+
+        t = clock();
+        for( i = 0; i < BENCH_ROUNDS; i++ )
+            i_out = (size_t)annexb_unescape( p_dst, p, (int)i_size );
+        f_unescape = bench_rate( i_size, t );
+        i_hash = bench_hash( p_dst, i_out );
+
+        if( k == 0 )
+        {
+            i_ref      = i_count;
+            i_ref_sum  = i_sum;
+            i_ref_out  = i_out;
+            i_ref_hash = i_hash;
+        }
+        else if( i_count != i_ref || i_sum != i_ref_sum )
+        {
+            printf( "%-5s MISMATCH: %zu start codes, c found %zu\n", kernels[k], i_count, i_ref );
+            i_ret = 1;
+            continue;
+        }
+        else if( i_out != i_ref_out || i_hash != i_ref_hash )
+        {
+            printf( "%-5s MISMATCH: unescaped to %zu bytes, c to %zu\n", kernels[k], i_out, i_ref_out );
+            i_ret = 1;
+            continue;
+        }
+
+        printf( "%-5s %zu start codes in %zu MB, %.2f GB/s; unescaped to %zu MB, %.2f GB/s\n",
+                kernels[k], i_count, i_size >> 20, f_find, i_out >> 20, f_unescape );
+    }
+
+    free( p );
+    free( p_dst );
+
+    return i_ret;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file archive.c
+ * @brief Indexed multi-stream archive of the extracted frames
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_printf.h>
+#include <xrtp_bytes.h>
+
+#include "archive.h"
+
+#define ARCHIVE_INDEX_MINIMUM   4096
+
+static const char archive_magic[8] = "XRTPARC";
+static const char index_magic[8]   = "XRTPIDX";
+
+static int archive_segment( archive_t *a );
+
+archive_t *archive_open( const char *psz_file, uint32_t i_flags )
+{
+    archive_t *a = (archive_t *)calloc( 1, sizeof(archive_t) );
+    uint8_t header[ARCHIVE_HEADER_SIZE];
+
+    if( a == NULL )
+        return NULL;
+
+    /* shared by the analysis threads: no writer of its own */
+    a->out = output_open( psz_file, i_flags & (OUTPUT_DIRECT | OUTPUT_PREALLOCATE), NULL );
+    if( a->out == NULL )
+    {
+        xrtp_printf( XRTP_ERR, "archive_open> can't open %s.\n", psz_file );
+        free( a );
+        return NULL;
+    }
+
+    xrtp_mutex_init( &a->lock );
+    a->i_segment = -1;
+
+    memcpy( header, archive_magic, 8 );
+    SetDWLE( header + 8, ARCHIVE_VERSION );
+    SetDWLE( header + 12, 0 );
+    output_write( a->out, header, sizeof(header) );
+
+    return a;
+}
+
+int archive_write( archive_t *a, archive_entry_t *e, const void *p )
+{
+    uint8_t record[ARCHIVE_RECORD_SIZE];
+    output_iov_t iov[2];
+    int i_ret;
+
+    SetDWLE( record, e->ssrc );
+    SetDWLE( record + 4, e->i_size );
+    SetDWLE( record + 8, e->i_rtp_timestamp );
+    record[12] = e->i_pt;
+    record[13] = e->i_type;
+    record[14] = e->i_flags;
+    record[15] = ARCHIVE_KIND_FRAME;
+    SetQWLE( record + 16, (uint64_t)e->i_arrival );
+
+    iov[0].p      = record;
+    iov[0].i_size = sizeof(record);
+    iov[1].p      = p;
+    iov[1].i_size = e->i_size;
+
+    xrtp_mutex_lock( &a->lock );
+
+    if( a->i_index == a->i_allocated )
+    {
+        size_t i_allocated = a->i_allocated ? 2 * a->i_allocated : ARCHIVE_INDEX_MINIMUM;
+        archive_entry_t *index = realloc( a->index, i_allocated * sizeof(*index) );
+
+        if( index == NULL )
+        {
+            xrtp_mutex_unlock( &a->lock );
+            xrtp_printf( XRTP_ERR, "archive_write> can't grow the index.\n" );
+            return -1;
+        }
+        a->index       = index;
+        a->i_allocated = i_allocated;
+    }
+
+    e->i_offset = output_tell( a->out );
+    i_ret = output_writev( a->out, iov, 2 );
+    if( i_ret == 0 )
+    {
+        a->index[a->i_index++] = *e;
+        a->i_bytes += e->i_size;
+
+        if( a->i_index == ARCHIVE_SEGMENT )
+            i_ret = archive_segment( a );
+    }
+
+    xrtp_mutex_unlock( &a->lock );
+
+    return i_ret;
+}
+
+static int entry_cmp( const void *a, const void *b )
+{
+    const archive_entry_t *x = (const archive_entry_t *)a;
+    const archive_entry_t *y = (const archive_entry_t *)b;
+
+    if( x->ssrc != y->ssrc )
+        return x->ssrc < y->ssrc ? -1 : 1;
+    if( x->i_arrival != y->i_arrival )
+        return x->i_arrival < y->i_arrival ? -1 : 1;
+
+    /* same arrival: in file order */
+    return x->i_offset < y->i_offset ? -1 : x->i_offset > y->i_offset;
+}
+
+void archive_entry_pack( uint8_t p[ARCHIVE_ENTRY_SIZE], const archive_entry_t *e )
+{
+    SetQWLE( p, (uint64_t)e->i_offset );
+    SetQWLE( p + 8, (uint64_t)e->i_arrival );
+    SetDWLE( p + 16, e->ssrc );
+    SetDWLE( p + 20, e->i_rtp_timestamp );
+    SetDWLE( p + 24, e->i_size );
+    p[28] = e->i_pt;
+    p[29] = e->i_type;
+    p[30] = e->i_flags;
+    p[31] = 0;
+}
+
+/**
+ * Writes the entries held as an index segment after the frames they
+ * index, chained to the previous one. Called with the lock held.
+ */
+static int archive_segment( archive_t *a )
+{
+    uint8_t header[ARCHIVE_RECORD_SIZE];
+    uint8_t entry[ARCHIVE_ENTRY_SIZE];
+    int64_t i_segment = output_tell( a->out );
+    int i_ret;
+    size_t i;
+
+    if( a->i_index == 0 )
+        return 0;
+
+    qsort( a->index, a->i_index, sizeof(archive_entry_t), entry_cmp );
+
+    memset( header, 0, sizeof(header) );
+    SetDWLE( header + 4, (uint32_t)(a->i_index * ARCHIVE_ENTRY_SIZE) );
+    header[15] = ARCHIVE_KIND_SEGMENT;
+    SetQWLE( header + 16, (uint64_t)a->i_segment );
+    i_ret = output_write( a->out, header, sizeof(header) );
+
+    for( i = 0; i < a->i_index && i_ret == 0; i++ )
+    {
+        archive_entry_pack( entry, &a->index[i] );
+        i_ret = output_write( a->out, entry, sizeof(entry) );
+    }
+
+    a->i_segment  = i_segment;
+    a->i_entries += a->i_index;
+    a->i_index    = 0;
+
+    return i_ret;
+}
+
+void archive_close( archive_t *a )
+{
+    uint8_t trailer[ARCHIVE_TRAILER_SIZE];
+
+    if( a == NULL )
+        return;
+
+    archive_segment( a );
+
+    SetQWLE( trailer, (uint64_t)a->i_segment );
+    SetQWLE( trailer + 8, a->i_entries );
+    memcpy( trailer + 16, index_magic, 8 );
+    output_write( a->out, trailer, sizeof(trailer) );
+
+    xrtp_printf( XRTP_DBG, "archive_close> %llu frames, %llu bytes.\n",
+                           (unsigned long long)a->i_entries, (unsigned long long)a->i_bytes );
+
+    output_close( a->out );
+    xrtp_mutex_destroy( &a->lock );
+
+    free( a->index );
+    free( a );
+}
@@ -0,0 +1,106 @@
+#ifndef _ARCHIVE_H_
+#define _ARCHIVE_H_
+
+#include <datatype.h>
+#include <xrtp_thread.h>
+
+#include "xrtp.h"
+#include "output.h"
+
+/*
+ * Indexed multi-stream archive: the frames of all the sources appended
+ * to one file, instead of one .es file per source, with an index to
+ * fetch a frame or a time range by random access.
+ *
+ *   header    "XRTPARC\0", u32 version, u32 0                  16 bytes
+ *   records   per frame: u32 ssrc, u32 size, u32 RTP timestamp,
+ *             u8 payload type, u8 type, u8 flags, u8 kind 0,
+ *             i64 arrival (us), then size bytes of frame          24 bytes
+ *   segments  between the records: u32 0, u32 size, u32 0,
+ *             u8 0, u8 0, u8 0, u8 kind 1, i64 offset of the
+ *             previous segment (-1 for the first), then size
+ *             bytes of index entries                              24 bytes
+ *   entries   per frame: i64 offset of the record, i64 arrival,
+ *             u32 ssrc, u32 RTP timestamp, u32 size,
+ *             u8 payload type, u8 type, u8 flags, u8 0            32 bytes
+ *   trailer   i64 offset of the last segment (-1: no frame),
+ *             u64 entries, "XRTPIDX\0"                            24 bytes
+ *
+ * Little endian. The index is written in segments of ARCHIVE_SEGMENT
+ * entries at most, as the frames go, so that its memory is bounded: a
+ * segment indexes the frames written since the previous one, sorted by
+ * SSRC, then arrival. A reader seeks the trailer at the end of the file,
+ * follows the segments backwards and binary searches each of them. The
+ * records carry the same fields and the segments are skipped by their
+ * kind, so a file without trailer (interrupted) can still be walked from
+ * the header.
+ *
+ * A frame is an access unit in Annex B for H.264/H.265, a payload for
+ * the other formats. The archive is shared by the analysis threads: the
+ * writes are serialized and synchronous.
+ */
+
+#define ARCHIVE_VERSION         2
+
+#define ARCHIVE_SEGMENT         65536   /* entries, 2 MB */
+
+#define ARCHIVE_HEADER_SIZE     16
+#define ARCHIVE_RECORD_SIZE     24
+#define ARCHIVE_ENTRY_SIZE      32
+#define ARCHIVE_TRAILER_SIZE    24
+
+/* type */
+#define ARCHIVE_TYPE_UNKNOWN    0
+#define ARCHIVE_TYPE_I          1
+#define ARCHIVE_TYPE_P          2
+#define ARCHIVE_TYPE_B          3
+
+/* flags */
+#define ARCHIVE_FLAG_KEY        0x01    /* random access point */
+#define ARCHIVE_FLAG_DAMAGED    0x02    /* packets lost, or no marker bit */
+
+/* kind */
+#define ARCHIVE_KIND_FRAME      0
+#define ARCHIVE_KIND_SEGMENT    1
+
+typedef struct _archive_entry_t
+{
+    int64_t   i_offset;         /* of the record, set by archive_write() */
+    mtime_t   i_arrival;
+    uint32_t  ssrc;
+    uint32_t  i_rtp_timestamp;
+    uint32_t  i_size;
+    uint8_t   i_pt;
+    uint8_t   i_type;
+    uint8_t   i_flags;
+
+}archive_entry_t;
+
+typedef struct _archive_t
+{
+    xrtp_mutex_t     lock;
+    output_t        *out;
+
+    archive_entry_t *index;     /* not written yet */
+    size_t           i_index;
+    size_t           i_allocated;
+
+    int64_t          i_segment; /* last one written, -1: none */
+    uint64_t         i_entries; /* in the segments */
+
+    uint64_t         i_bytes;   /* of frames */
+
+}archive_t;
+
+/* i_flags: OUTPUT_DIRECT and OUTPUT_PREALLOCATE */
+archive_t *archive_open( const char *psz_file, uint32_t i_flags );
+/* writes the index */
+void       archive_close( archive_t *a );
+
+/* appends e->i_size bytes of frame, any thread */
+int        archive_write( archive_t *a, archive_entry_t *e, const void *p );
+
+/* an index entry, as written to the file */
+void       archive_entry_pack( uint8_t p[ARCHIVE_ENTRY_SIZE], const archive_entry_t *e );
+
+#endif //_ARCHIVE_H_
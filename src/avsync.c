@@ -0,0 +1,215 @@
+/**
+ * @file avsync.c
+ * @brief Audio/video synchronization from RTCP sender reports
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_printf.h>
+
+#include "avsync.h"
+#include "rtcp.h"
+#include "session.h"
+
+avsync_t *avsync_create( const uint32_t *map, unsigned i_map, int b_cname )
+{
+    avsync_t *av = (avsync_t *)calloc( 1, sizeof(avsync_t) );
+    unsigned i;
+
+    if( av == NULL )
+        return NULL;
+
+    for( i = 0; i < i_map && i < AVSYNC_PAIRS; i++ )
+    {
+        av->pair[i].audio = map[2 * i];
+        av->pair[i].video = map[2 * i + 1];
+    }
+    av->i_pairs = i;
+    av->b_cname = (uint8_t)b_cname;
+
+    return av;
+}
+
+static void
+avsync_write ( avsync_pair_t *p )
+{
+    if( p->fp == NULL )
+    {
+        char psz_file[64];
+
+        sprintf( psz_file, "avsync_0x%x_0x%x.txt", p->audio, p->video );
+        p->fp = fopen( psz_file, "w" );
+        if( p->fp == NULL )
+        {
+            xrtp_printf( XRTP_ERR, "avsync_write> can't open %s.\n", psz_file );
+            return;
+        }
+
+        fprintf( p->fp, "# time(s) offset_avg(us) offset_min(us) offset_max(us), video - audio\n" );
+    }
+
+    fprintf( p->fp, "%lld %lld %lld %lld\n",
+             (long long)(p->i_second - p->first / CLOCK_FREQ),
+             (long long)(p->sec_sum / p->i_count),
+             (long long)p->sec_min, (long long)p->sec_max );
+}
+
+static void
+avsync_sample ( avsync_pair_t *p, mtime_t offset, mtime_t arrival )
+{
+    int64_t i_second = arrival / CLOCK_FREQ;
+
+    if( p->i_samples == 0 )
+    {
+        p->first = arrival;
+        p->min   = p->max = offset;
+    }
+    p->i_samples++;
+    p->sum += offset;
+    if( offset < p->min ) p->min = offset;
+    if( offset > p->max ) p->max = offset;
+
+    if( p->i_count && i_second != p->i_second )
+    {
+        avsync_write( p );
+        p->i_count = 0;
+    }
+
+    if( p->i_count == 0 )
+    {
+        p->i_second = i_second;
+        p->sec_sum  = 0;
+        p->sec_min  = p->sec_max = offset;
+    }
+    p->i_count++;
+    p->sec_sum += offset;
+    if( offset < p->sec_min ) p->sec_min = offset;
+    if( offset > p->sec_max ) p->sec_max = offset;
+}
+
+static int
+avsync_paired ( const avsync_t *av, uint32_t ssrc )
+{
+    unsigned i;
+
+    for( i = 0; i < av->i_pairs; i++ )
+    {
+        if( av->pair[i].audio == ssrc || av->pair[i].video == ssrc )
+            return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Pairs src, whose CNAME just arrived or changed, with an audio/video
+ * source of the same CNAME.
+ */
+void avsync_cname( avsync_t *av, const rtp_session_t *session,
+                   const rtp_source_t *src )
+{
+    unsigned i;
+
+    if( !av->b_cname || av->i_pairs >= AVSYNC_PAIRS || src->control == NULL
+     || src->control->cname[0] == '\0' || avsync_paired( av, src->ssrc ) )
+        return;
+
+    for( i = 0; i < session->srcc; i++ )
+    {
+        const rtp_source_t *other = session->srcv[i];
+        avsync_pair_t *p = &av->pair[av->i_pairs];
+
+        if( other == src || other->control == NULL
+         || strcmp( other->control->cname, src->control->cname )
+         || rtp_source_is_video( other ) == rtp_source_is_video( src )
+         || avsync_paired( av, other->ssrc ) )
+            continue;
+
+        p->audio = rtp_source_is_video( src ) ? other->ssrc : src->ssrc;
+        p->video = rtp_source_is_video( src ) ? src->ssrc : other->ssrc;
+        av->i_pairs++;
+
+        xrtp_printf( XRTP_OUT, "avsync> cname %s: audio 0x%x, video 0x%x.\n",
+                               src->control->cname, p->audio, p->video );
+        return;
+    }
+}
+
+void avsync_update( avsync_t *av, const rtp_source_t *src, uint32_t ts,
+                    int b_frame, mtime_t arrival )
+{
+    const rtcp_sr_t *sr;
+    mtime_t wall, delay;
+    unsigned i;
+
+    sr = rtcp_last_sr( src->control );
+    if( sr == NULL )
+        return;
+
+    /* sender wallclock of the packet, from NTP 32.32 */
+    wall = (mtime_t)(sr->ntp >> 32) * CLOCK_FREQ
+         + (mtime_t)(((sr->ntp & 0xFFFFFFFF) * CLOCK_FREQ) >> 32)
+         + (mtime_t)(int32_t)(ts - sr->rtp) * CLOCK_FREQ / src->pt.frequency;
+    delay = arrival - wall;
+
+    for( i = 0; i < av->i_pairs; i++ )
+    {
+        avsync_pair_t *p = &av->pair[i];
+
+        if( p->audio == src->ssrc )
+        {
+            p->delay_audio = delay;
+            p->b_audio     = 1;
+        }
+        else if( p->video == src->ssrc && b_frame )
+        {
+            p->delay_video = delay;
+            p->b_video     = 1;
+
+            if( p->b_audio )
+                avsync_sample( p, p->delay_video - p->delay_audio, arrival );
+        }
+    }
+}
+
+void avsync_destroy( avsync_t *av )
+{
+    unsigned i;
+
+    if( av == NULL )
+        return;
+
+    for( i = 0; i < av->i_pairs; i++ )
+    {
+        avsync_pair_t *p = &av->pair[i];
+
+        if( p->i_count )
+            avsync_write( p );
+
+        if( p->fp )
+            fclose( p->fp );
+    }
+
+    free( av );
+}
+
+void avsync_report( const avsync_t *av, FILE *fp )
+{
+    unsigned i;
+
+    for( i = 0; i < av->i_pairs; i++ )
+    {
+        const avsync_pair_t *p = &av->pair[i];
+
+        fprintf( fp, "avsync audio 0x%08x, video 0x%08x:", p->audio, p->video );
+
+        if( p->i_samples )
+            fprintf( fp, " offset avg %lld us, min %lld us, max %lld us (%llu frames)\n",
+                         (long long)(p->sum / (mtime_t)p->i_samples),
+                         (long long)p->min, (long long)p->max,
+                         (unsigned long long)p->i_samples );
+        else
+            fprintf( fp, " no sender reports for both\n" );
+    }
+}
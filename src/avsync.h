@@ -0,0 +1,67 @@
+#ifndef _AVSYNC_H_
+#define _AVSYNC_H_
+
+#include <stdio.h>
+
+#include "xrtp.h"
+
+/*
+ * Audio/video synchronization through the RTCP sender reports.
+ *
+ * Every packet is placed on the sender wallclock with the last SR of its
+ * source (NTP time + (RTP timestamp - SR RTP timestamp) / clock). Its
+ * delay is the arrival time minus that wallclock, up to the offset of the
+ * capture clock, which cancels out between two streams: the sync offset
+ * is the delay of a video frame minus the delay of the last audio packet,
+ * positive when video comes late.
+ *
+ * Pairs are given by the user or formed by CNAME once SDES is received.
+ */
+
+#define AVSYNC_PAIRS    XRTP_AVSYNC_MAXIMUM
+
+typedef struct _avsync_pair_t
+{
+    uint32_t audio, video;
+    FILE    *fp;                /* offset timeline, one line per second */
+
+    mtime_t  delay_audio;       /* last delays, us */
+    mtime_t  delay_video;
+    int      b_audio, b_video;
+
+    /* whole run */
+    mtime_t  first;             /* arrival of the first sample */
+    uint64_t i_samples;
+    mtime_t  sum, min, max;
+
+    /* current second */
+    int64_t  i_second;
+    unsigned i_count;
+    mtime_t  sec_sum, sec_min, sec_max;
+
+}avsync_pair_t;
+
+struct _avsync_t
+{
+    avsync_pair_t pair[AVSYNC_PAIRS];
+    unsigned      i_pairs;
+
+    uint8_t       b_cname;      /* pair sources by CNAME */
+
+};
+
+/* map: i_map pairs of audio, video ssrc */
+avsync_t *avsync_create( const uint32_t *map, unsigned i_map, int b_cname );
+void      avsync_destroy( avsync_t *av );
+
+/* one packet of src, b_frame: first packet of an RTP timestamp */
+void      avsync_update( avsync_t *av, const rtp_source_t *src, uint32_t ts,
+                         int b_frame, mtime_t arrival );
+
+/* src got a new CNAME from SDES: pairs it by CNAME if asked to */
+void      avsync_cname( avsync_t *av, const rtp_session_t *session,
+                        const rtp_source_t *src );
+
+void      avsync_report( const avsync_t *av, FILE *fp );
+
+#endif //_AVSYNC_H_
@@ -260,3 +260,114 @@ static int bs_size_te( int x, int val )
         return x264_ue_size_tab[val+1];
 }
 
+
+/* reader */
+
+#include <xrtp_bytes.h>
+
+void bsr_init( bsr_t *s, const void *p_data, int i_data )
+{
+    s->p         = (const uint8_t *)p_data;
+    s->p_end     = s->p + (i_data > 0 ? i_data : 0);
+    s->cache     = 0;
+    s->i_cache   = 0;
+    s->i_zeros   = 0;
+    s->i_overrun = 0;
+    s->b_error   = 0;
+}
+
+/* at least 57 bits in the cache */
+static void bsr_refill( bsr_t *s )
+{
+    while( s->i_cache <= 56 )
+    {
+        uint64_t b;
+
+        if( s->p < s->p_end )
+        {
+            b = *s->p++;
+
+            /* 00 00 03: emulation prevention */
+            if( s->i_zeros >= 2 && b == 0x03 )
+            {
+                s->i_zeros = 0;
+                continue;
+            }
+            s->i_zeros = b ? 0 : s->i_zeros + 1;
+        }
+        else
+        {
+            b = 0;
+            s->i_overrun += 8;
+        }
+
+        s->cache   |= b << (56 - s->i_cache);
+        s->i_cache += 8;
+    }
+}
+
+static void bsr_consume( bsr_t *s, int i_count )
+{
+    s->cache   <<= i_count;
+    s->i_cache  -= i_count;
+
+    if( s->i_overrun > s->i_cache )
+        s->b_error = 1;
+}
+
+uint32_t bsr_read( bsr_t *s, int i_count )
+{
+    uint32_t v;
+
+    if( i_count <= 0 )
+        return 0;
+
+    bsr_refill( s );
+    v = (uint32_t)(s->cache >> (64 - i_count));
+    bsr_consume( s, i_count );
+
+    return v;
+}
+
+uint32_t bsr_read1( bsr_t *s )
+{
+    return bsr_read( s, 1 );
+}
+
+void bsr_skip( bsr_t *s, int i_count )
+{
+    while( i_count > 32 )
+    {
+        bsr_read( s, 32 );
+        i_count -= 32;
+    }
+    bsr_read( s, i_count );
+}
+
+uint32_t bsr_read_ue( bsr_t *s )
+{
+    int i_zeros;
+
+    bsr_refill( s );
+
+    /* leading zeros, then the 1 and as many bits */
+    if( s->cache == 0 || (i_zeros = xrtp_clz64( s->cache )) > 31 )
+    {
+        /* the cache may be full: a 64 bits shift is undefined */
+        s->b_error = 1;
+        s->cache   = 0;
+        s->i_cache = 0;
+        return 0;
+    }
+
+    bsr_consume( s, i_zeros );
+
+    return bsr_read( s, i_zeros + 1 ) - 1;
+}
+
+int32_t bsr_read_se( bsr_t *s )
+{
+    uint32_t v = bsr_read_ue( s );
+
+    return v & 1 ? (int32_t)((v + 1) >> 1) : -(int32_t)(v >> 1);
+}
@@ -44,5 +44,27 @@ void bs_rbsp_trailing( bs_t *s );
 void bs_flush( bs_t *s );
 int  bs_pos( bs_t *s );
 
+/* reader, over a NAL unit payload: emulation prevention bytes are
+ * dropped on the fly, reading past the end returns zeros and sets
+ * b_error */
+typedef struct bsr_s
+{
+    const uint8_t *p;
+    const uint8_t *p_end;
+
+    uint64_t cache;         /* next bits, msb first */
+    int      i_cache;       /* valid bits in cache */
+    int      i_zeros;       /* zero bytes before p */
+    int      i_overrun;     /* bits past the end in cache */
+    int      b_error;
+} bsr_t;
+
+void     bsr_init( bsr_t *s, const void *p_data, int i_data );
+uint32_t bsr_read( bsr_t *s, int i_count );     /* i_count <= 32 */
+uint32_t bsr_read1( bsr_t *s );
+void     bsr_skip( bsr_t *s, int i_count );
+uint32_t bsr_read_ue( bsr_t *s );
+int32_t  bsr_read_se( bsr_t *s );
+
 #endif //_BITSTREAM_H_
 
@@ -0,0 +1,136 @@
+#ifndef _XRTP_BYTES_H
+#define _XRTP_BYTES_H
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+#endif
+
+/* big endian readers, network byte order fields of RTP/RTCP */
+
+static inline uint64_t GetQWBE( const void * _p )
+{
+    const uint8_t * p = (const uint8_t *)_p;
+    return ( ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48)
+              | ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32)
+              | ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16)
+              | ((uint64_t)p[6] << 8) | p[7] );
+}
+
+static inline uint32_t GetDWBE( const void * _p )
+{
+    const uint8_t * p = (const uint8_t *)_p;
+    return ( ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+              | ((uint32_t)p[2] << 8) | p[3] );
+}
+
+static inline uint16_t GetWBE( const void * _p )
+{
+    const uint8_t * p = (const uint8_t *)_p;
+    return ( ((uint16_t)p[0] << 8) | p[1] );
+}
+
+/* big endian writers, the mp4 boxes */
+
+static inline void SetWBE( void *_p, uint16_t i )
+{
+    uint8_t *p = (uint8_t *)_p;
+    p[0] = i >> 8;
+    p[1] = i & 0xff;
+}
+
+static inline void SetDWBE( void *_p, uint32_t i )
+{
+    uint8_t *p = (uint8_t *)_p;
+    p[0] = i >> 24;
+    p[1] = (i >> 16) & 0xff;
+    p[2] = (i >> 8) & 0xff;
+    p[3] = i & 0xff;
+}
+
+static inline void SetQWBE( void *_p, uint64_t i )
+{
+    SetDWBE( _p, (uint32_t)(i >> 32) );
+    SetDWBE( (uint8_t *)_p + 4, (uint32_t)i );
+}
+
+/* little endian readers and writers, the archive files */
+
+static inline uint32_t GetDWLE( const void * _p )
+{
+    const uint8_t * p = (const uint8_t *)_p;
+    return ( ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16)
+              | ((uint32_t)p[1] << 8) | p[0] );
+}
+
+static inline uint64_t GetQWLE( const void * _p )
+{
+    const uint8_t * p = (const uint8_t *)_p;
+    return GetDWLE( p ) | ((uint64_t)GetDWLE( p + 4 ) << 32);
+}
+
+static inline void SetDWLE( void *_p, uint32_t i )
+{
+    uint8_t *p = (uint8_t *)_p;
+    p[0] = i & 0xff;
+    p[1] = (i >> 8) & 0xff;
+    p[2] = (i >> 16) & 0xff;
+    p[3] = i >> 24;
+}
+
+static inline void SetQWLE( void *_p, uint64_t i )
+{
+    SetDWLE( _p, (uint32_t)i );
+    SetDWLE( (uint8_t *)_p + 4, (uint32_t)(i >> 32) );
+}
+
+/* number of leading zero bits, x must not be 0 */
+static inline unsigned xrtp_clz32( uint32_t x )
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanReverse( &i, x );
+    return 31 - i;
+#else
+    return __builtin_clz( x );
+#endif
+}
+
+/* number of leading zero bits, x must not be 0 */
+static inline unsigned xrtp_clz64( uint64_t x )
+{
+#if defined(_MSC_VER)
+    uint32_t hi = (uint32_t)(x >> 32);
+
+    return hi ? xrtp_clz32( hi ) : 32 + xrtp_clz32( (uint32_t)x );
+#else
+    return __builtin_clzll( x );
+#endif
+}
+
+/* number of trailing zero bits, x must not be 0 */
+static inline unsigned xrtp_ctz32( uint32_t x )
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward( &i, x );
+    return i;
+#else
+    return __builtin_ctz( x );
+#endif
+}
+
+/* number of trailing zero bits, x must not be 0 */
+static inline unsigned xrtp_ctz64( uint64_t x )
+{
+#if defined(_MSC_VER)
+    uint32_t lo = (uint32_t)x;
+
+    return lo ? xrtp_ctz32( lo ) : 32 + xrtp_ctz32( (uint32_t)(x >> 32) );
+#else
+    return __builtin_ctzll( x );
+#endif
+}
+
+#endif // _XRTP_BYTES_H
@@ -2,13 +2,15 @@
 
 int g_xrtp_print_level = XRTP_DBG;
 
-// NOTE: 1. this is *not* reentrantable now!!
+// NOTE: 1. one fprintf() per message, so lines from worker threads
+//          don't interleave
 //       2. always print on stderr
 void xrtp_printf( int i_level, const char *psz_fmt, ... )
 {
     if( i_level >= g_xrtp_print_level )
     {
         char *psz_prefix;
+        char psz_msg[1024];
 
         va_list arg;
         va_start( arg, psz_fmt );
@@ -28,8 +30,9 @@ void xrtp_printf( int i_level, const char *psz_fmt, ... )
                 psz_prefix = "unknown";
                 break;
         }
-        fprintf( stderr, "xrtp [%s]: ", psz_prefix );
-        vfprintf( stderr, psz_fmt, arg );        
+
+        vsnprintf( psz_msg, sizeof(psz_msg), psz_fmt, arg );
+        fprintf( stderr, "xrtp [%s]: %s", psz_prefix, psz_msg );
         
         va_end( arg );
     }
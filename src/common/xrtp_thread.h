@@ -0,0 +1,124 @@
+#ifndef _XRTP_THREAD_H
+#define _XRTP_THREAD_H
+
+#include <stdint.h>
+
+/*
+ * Minimal threading layer: Win32 threads on Windows, pthreads elsewhere.
+ *
+ * Thread entry points are declared with XRTP_THREAD_FUNC() and must end
+ * with XRTP_THREAD_RETURN, so the same body builds on both platforms.
+ */
+
+#if defined(_WIN32) || defined(_WIN64)
+# include <windows.h>
+# include <process.h>
+
+typedef HANDLE              xrtp_thread_t;
+typedef CRITICAL_SECTION    xrtp_mutex_t;
+
+# define XRTP_THREAD_FUNC(name, arg)    unsigned __stdcall name( void *arg )
+# define XRTP_THREAD_RETURN             return 0
+
+static inline int xrtp_thread_create( xrtp_thread_t *t,
+                                      unsigned (__stdcall *func)( void * ),
+                                      void *arg )
+{
+    *t = (HANDLE)_beginthreadex( NULL, 0, func, arg, 0, NULL );
+    return *t ? 0 : -1;
+}
+
+static inline void xrtp_thread_join( xrtp_thread_t t )
+{
+    WaitForSingleObject( t, INFINITE );
+    CloseHandle( t );
+}
+
+static inline void xrtp_thread_yield( void )
+{
+    SwitchToThread();
+}
+
+static inline void xrtp_thread_sleep( int i_ms )
+{
+    Sleep( i_ms );
+}
+
+static inline void xrtp_mutex_init( xrtp_mutex_t *m )    { InitializeCriticalSection( m ); }
+static inline void xrtp_mutex_destroy( xrtp_mutex_t *m ) { DeleteCriticalSection( m ); }
+static inline void xrtp_mutex_lock( xrtp_mutex_t *m )    { EnterCriticalSection( m ); }
+static inline void xrtp_mutex_unlock( xrtp_mutex_t *m )  { LeaveCriticalSection( m ); }
+
+/* acquire load / release store of a shared 32-bit index */
+static inline uint32_t xrtp_atomic_load( volatile uint32_t *p )
+{
+    return (uint32_t)InterlockedOr( (volatile LONG *)p, 0 );
+}
+
+static inline void xrtp_atomic_store( volatile uint32_t *p, uint32_t v )
+{
+    InterlockedExchange( (volatile LONG *)p, (LONG)v );
+}
+
+static inline uint32_t xrtp_atomic_add( volatile uint32_t *p, uint32_t v )
+{
+    return (uint32_t)InterlockedExchangeAdd( (volatile LONG *)p, (LONG)v ) + v;
+}
+
+#else
+# include <pthread.h>
+# include <sched.h>
+# include <time.h>
+
+typedef pthread_t           xrtp_thread_t;
+typedef pthread_mutex_t     xrtp_mutex_t;
+
+# define XRTP_THREAD_FUNC(name, arg)    void *name( void *arg )
+# define XRTP_THREAD_RETURN             return NULL
+
+static inline int xrtp_thread_create( xrtp_thread_t *t,
+                                      void *(*func)( void * ),
+                                      void *arg )
+{
+    return pthread_create( t, NULL, func, arg ) ? -1 : 0;
+}
+
+static inline void xrtp_thread_join( xrtp_thread_t t )
+{
+    pthread_join( t, NULL );
+}
+
+static inline void xrtp_thread_yield( void )
+{
+    sched_yield();
+}
+
+static inline void xrtp_thread_sleep( int i_ms )
+{
+    struct timespec ts = { i_ms / 1000, (i_ms % 1000) * 1000000L };
+    nanosleep( &ts, NULL );
+}
+
+static inline void xrtp_mutex_init( xrtp_mutex_t *m )    { pthread_mutex_init( m, NULL ); }
+static inline void xrtp_mutex_destroy( xrtp_mutex_t *m ) { pthread_mutex_destroy( m ); }
+static inline void xrtp_mutex_lock( xrtp_mutex_t *m )    { pthread_mutex_lock( m ); }
+static inline void xrtp_mutex_unlock( xrtp_mutex_t *m )  { pthread_mutex_unlock( m ); }
+
+static inline uint32_t xrtp_atomic_load( volatile uint32_t *p )
+{
+    return __atomic_load_n( p, __ATOMIC_ACQUIRE );
+}
+
+static inline void xrtp_atomic_store( volatile uint32_t *p, uint32_t v )
+{
+    __atomic_store_n( p, v, __ATOMIC_RELEASE );
+}
+
+static inline uint32_t xrtp_atomic_add( volatile uint32_t *p, uint32_t v )
+{
+    return __atomic_add_fetch( p, v, __ATOMIC_ACQ_REL );
+}
+
+#endif
+
+#endif // _XRTP_THREAD_H
@@ -0,0 +1,125 @@
+/**
+ * @file drift.c
+ * @brief RTP clock drift estimation
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "drift.h"
+#include "session.h"
+
+drift_t *drift_create( uint32_t freq )
+{
+    drift_t *d = (drift_t *)calloc( 1, sizeof(drift_t) );
+    if( d == NULL )
+        return NULL;
+
+    d->freq = freq;
+
+    return d;
+}
+
+void drift_destroy( drift_t *d )
+{
+    if( d )
+        free( d );
+}
+
+/* Welford update, numerically safe over long captures */
+static void
+drift_fit_add ( drift_fit_t *f, double x, double y )
+{
+    double dx = x - f->mx;
+    double dy = y - f->my;
+
+    f->n  += 1;
+    f->mx += dx / f->n;
+    f->my += dy / f->n;
+
+    f->cxx += dx * (x - f->mx);
+    f->cxy += dx * (y - f->my);
+    f->cyy += dy * (y - f->my);
+}
+
+static double
+drift_fit_slope ( const drift_fit_t *f )
+{
+    return f->cxx > 0 ? f->cxy / f->cxx : 0;
+}
+
+/* rms of the residuals around the fitted line */
+static double
+drift_fit_residual ( const drift_fit_t *f )
+{
+    double sse;
+
+    if( f->n < 3 || f->cxx <= 0 )
+        return 0;
+
+    sse = f->cyy - f->cxy * f->cxy / f->cxx;
+
+    return sse > 0 ? sqrt( sse / (f->n - 2) ) : 0;
+}
+
+void drift_update( drift_t *d, int64_t ext_ts, mtime_t arrival )
+{
+    double  x, y;
+    int64_t i_bucket = arrival / DRIFT_BUCKET;
+
+    if( !d->b_started )
+    {
+        d->x0        = arrival;
+        d->ts0       = ext_ts;
+        d->i_bucket  = i_bucket;
+        d->b_started = 1;
+    }
+
+    /* seconds, and us of delay up to the clock offset */
+    x = (double)(arrival - d->x0) / CLOCK_FREQ;
+    y = (double)(arrival - d->x0) - (double)(ext_ts - d->ts0) * CLOCK_FREQ / d->freq;
+
+    drift_fit_add( &d->all, x, y );
+
+    if( i_bucket != d->i_bucket )
+    {
+        if( d->b_bucket )
+            drift_fit_add( &d->low, d->bucket_x, d->bucket_y );
+
+        d->i_bucket = i_bucket;
+        d->b_bucket = 0;
+    }
+
+    if( !d->b_bucket || y < d->bucket_y )
+    {
+        d->bucket_x = x;
+        d->bucket_y = y;
+        d->b_bucket = 1;
+    }
+}
+
+double drift_skew( const drift_t *d )
+{
+    if( d->low.n < DRIFT_MIN_FIT )
+        return 0;
+
+    /* y grows by 1 - rtp rate per second of arrival, in us */
+    return -drift_fit_slope( &d->low ) / CLOCK_FREQ;
+}
+
+void drift_report( const drift_t *d, FILE *fp )
+{
+    if( d->all.n < 2 )
+        return;
+
+    fprintf( fp, "  drift:  %.1f ppm (all packets %.1f ppm, residual rms %.0f us)",
+                 drift_skew( d ) * 1e6,
+                 -drift_fit_slope( &d->all ), drift_fit_residual( &d->all ) );
+
+    if( d->low.n >= DRIFT_MIN_FIT )
+        fprintf( fp, ", offset %.0f us, lower bound residual rms %.0f us",
+                     d->low.my - drift_fit_slope( &d->low ) * d->low.mx,
+                     drift_fit_residual( &d->low ) );
+
+    fprintf( fp, "\n" );
+}
@@ -0,0 +1,56 @@
+#ifndef _DRIFT_H_
+#define _DRIFT_H_
+
+#include <stdio.h>
+
+#include "xrtp.h"
+
+/*
+ * RTP clock versus capture clock drift.
+ *
+ * y = arrival - RTP time drifts linearly with the arrival time x when the
+ * sender clock is off, queueing adds positive noise on top of it. Two
+ * streaming least squares fits are kept: over every packet, and over the
+ * minimum y of every DRIFT_BUCKET of arrival time, a lower bound much less
+ * sensitive to queueing. The latter gives the estimate.
+ */
+
+#define DRIFT_BUCKET    1000000     /* us */
+#define DRIFT_MIN_FIT   5           /* buckets before the estimate is used */
+
+typedef struct _drift_fit_t
+{
+    double   n;
+    double   mx, my;        /* running means */
+    double   cxx, cxy, cyy; /* co-moments */
+
+}drift_fit_t;
+
+struct _drift_t
+{
+    uint32_t    freq;
+    int         b_started;
+    mtime_t     x0;         /* first arrival */
+    int64_t     ts0;        /* first unwrapped RTP timestamp */
+
+    drift_fit_t all;
+    drift_fit_t low;
+
+    int64_t     i_bucket;
+    double      bucket_x, bucket_y;
+    int         b_bucket;
+
+};
+
+drift_t *drift_create( uint32_t freq );
+void     drift_destroy( drift_t *d );
+
+/* one packet in arrival order, ext_ts: unwrapped RTP timestamp */
+void     drift_update( drift_t *d, int64_t ext_ts, mtime_t arrival );
+
+/* RTP clock rate error (+ fast), 0 until known */
+double   drift_skew( const drift_t *d );
+
+void     drift_report( const drift_t *d, FILE *fp );
+
+#endif //_DRIFT_H_
@@ -0,0 +1,212 @@
+/**
+ * @file frame.c
+ * @brief Access unit assembler
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_printf.h>
+
+#include "frame.h"
+#include "session.h"
+
+#define FRAME_BUFFER_MINIMUM    (64 * 1024)
+
+#define FRAME_BLOCK_FLAGS       (BLOCK_FLAG_TYPE_I | BLOCK_FLAG_TYPE_P | BLOCK_FLAG_TYPE_B \
+                               | BLOCK_FLAG_TYPE_PB | BLOCK_FLAG_NO_KEYFRAME)
+
+frame_asm_t *frame_asm_create( frame_output_t pf_output, void *opaque )
+{
+    frame_asm_t *fa = (frame_asm_t *)calloc( 1, sizeof(frame_asm_t) );
+    if( fa == NULL )
+        return NULL;
+
+    fa->pf_output = pf_output;
+    fa->opaque    = opaque;
+
+    return fa;
+}
+
+void frame_asm_destroy( frame_asm_t *fa )
+{
+    frame_t *f;
+
+    if( fa == NULL )
+        return;
+
+    frame_asm_flush( fa );
+
+    while( (f = fa->pool) != NULL )
+    {
+        fa->pool = f->p_next;
+        free( f->p_buffer );
+        free( f );
+    }
+
+    free( fa );
+}
+
+static frame_t *
+frame_get ( frame_asm_t *fa )
+{
+    frame_t *f = fa->pool;
+
+    if( f )
+    {
+        fa->pool = f->p_next;
+        fa->i_pool--;
+    }
+    else
+    {
+        f = (frame_t *)calloc( 1, sizeof(frame_t) );
+        if( f == NULL )
+            return NULL;
+    }
+
+    f->p_next        = NULL;
+    f->i_buffer      = 0;
+    f->i_packets     = 0;
+    f->i_gaps        = 0;
+    f->i_bytes       = 0;
+    f->i_flags       = 0;
+    f->i_block_flags = 0;
+    f->i_frame_num   = -1;
+    f->i_poc         = -1;
+    f->i_temporal_id = -1;
+    f->i_reference   = -1;
+    f->i_key         = 0;
+    f->i_width       = 0;
+    f->i_height      = 0;
+
+    return f;
+}
+
+static void
+frame_release ( frame_asm_t *fa, frame_t *f )
+{
+    if( fa->i_pool >= FRAME_POOL_MAXIMUM )
+    {
+        free( f->p_buffer );
+        free( f );
+        return;
+    }
+
+    f->p_next = fa->pool;
+    fa->pool  = f;
+    fa->i_pool++;
+}
+
+void frame_asm_flush( frame_asm_t *fa )
+{
+    frame_t *f = fa->cur;
+
+    if( f == NULL )
+        return;
+
+    fa->cur = NULL;
+
+    if( fa->pf_output )
+        fa->pf_output( fa->opaque, f );
+
+    frame_release( fa, f );
+}
+
+int frame_asm_packet( frame_asm_t *fa, const block_t *block )
+{
+    frame_t *f = fa->cur;
+    int b_loss = (block->i_flags & BLOCK_FLAG_DISCONTINUITY) != 0;
+
+    if( f && f->i_rtp_timestamp != (uint32_t)block->i_rtp_timestamp )
+    {
+        /* the gap took the tail and the marker of the open frame: charge
+         * it there, the new frame may well be intact */
+        if( b_loss )
+        {
+            f->i_flags |= FRAME_FLAG_LOSS;
+            f->i_gaps++;
+            b_loss = 0;
+        }
+        f->i_flags |= FRAME_FLAG_NO_MARKER;
+        frame_asm_flush( fa );
+        f = NULL;
+    }
+
+    if( f == NULL )
+    {
+        f = frame_get( fa );
+        if( f == NULL )
+        {
+            xrtp_printf( XRTP_ERR, "frame_asm_packet> can't alloc frame.\n" );
+            return -1;
+        }
+
+        f->i_rtp_timestamp = (uint32_t)block->i_rtp_timestamp;
+        f->first_arrival   = block->i_pts;
+        fa->cur = f;
+    }
+
+    /* packets of a frame may be reordered */
+    if( block->i_pts < f->first_arrival )
+        f->first_arrival = block->i_pts;
+    if( f->i_packets == 0 || block->i_pts > f->last_arrival )
+        f->last_arrival = block->i_pts;
+    f->i_packets++;
+    f->i_bytes += block->i_buffer;
+
+    if( b_loss )
+    {
+        f->i_flags |= FRAME_FLAG_LOSS;
+        f->i_gaps++;
+    }
+
+    /* already tagged by a depacketizer */
+    f->i_block_flags |= block->i_flags & FRAME_BLOCK_FLAGS;
+    if( block->i_key )
+        f->i_key = block->i_key;
+    if( f->i_temporal_id < 0 )
+        f->i_temporal_id = block->i_temporal_id;
+    if( block->i_reference > f->i_reference )
+        f->i_reference = block->i_reference;
+
+    return 0;
+}
+
+int frame_asm_write( frame_asm_t *fa, const void *p, size_t i_size )
+{
+    frame_t *f = fa->cur;
+
+    if( f == NULL )
+        return -1;
+
+    if( f->i_buffer + i_size > f->i_allocated )
+    {
+        size_t   i_new = f->i_allocated ? f->i_allocated : FRAME_BUFFER_MINIMUM;
+        uint8_t *p_new;
+
+        while( i_new < f->i_buffer + i_size )
+            i_new *= 2;
+
+        p_new = (uint8_t *)realloc( f->p_buffer, i_new );
+        if( p_new == NULL )
+        {
+            xrtp_printf( XRTP_ERR, "frame_asm_write> can't grow frame to %u bytes.\n",
+                                   (unsigned)i_new );
+            return -1;
+        }
+
+        f->p_buffer    = p_new;
+        f->i_allocated = i_new;
+    }
+
+    memcpy( f->p_buffer + f->i_buffer, p, i_size );
+    f->i_buffer += i_size;
+
+    return 0;
+}
+
+void frame_asm_packet_end( frame_asm_t *fa, const block_t *block )
+{
+    if( fa->cur && (block->i_flags & BLOCK_FLAG_END_OF_FRAME) )
+        frame_asm_flush( fa );
+}
@@ -0,0 +1,92 @@
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+#include <stddef.h>
+
+#include "xrtp.h"
+#include "session.h"    /* BLOCK_FLAG_* */
+
+/*
+ * Access unit assembler: gathers the packets of one RTP timestamp, up to
+ * the marker bit, into one contiguous buffer, and hands the whole frame
+ * to an output callback. A frame is also closed, flagged
+ * FRAME_FLAG_NO_MARKER, when a packet of another timestamp arrives first;
+ * if that packet follows a sequence gap, the loss is the tail of the open
+ * frame, not the head of the new one.
+ *
+ * Frames come from a small pool and keep their buffer when recycled, so
+ * a steady stream does not allocate. The output callback does not own
+ * the frame: it is recycled as soon as the callback returns.
+ */
+
+#define FRAME_FLAG_LOSS         0x01    /* packets lost before or inside the frame */
+#define FRAME_FLAG_NO_MARKER    0x02    /* closed without its marker bit */
+#define FRAME_FLAG_DAMAGED      (FRAME_FLAG_LOSS | FRAME_FLAG_NO_MARKER)
+
+#define FRAME_POOL_MAXIMUM      4
+
+/* random access point kind, i_key */
+#define FRAME_KEY_IDR           1
+#define FRAME_KEY_CRA           2
+#define FRAME_KEY_BLA           3
+
+/* keyframe: intra, and no slice says otherwise (IDR/IRAP) */
+#define FRAME_IS_KEY( f ) \
+    (((f)->i_block_flags & (BLOCK_FLAG_TYPE_I | BLOCK_FLAG_NO_KEYFRAME)) == BLOCK_FLAG_TYPE_I)
+
+typedef struct _frame_t frame_t;
+
+struct _frame_t
+{
+    frame_t    *p_next;         /* pool */
+
+    uint8_t    *p_buffer;       /* payload written by the depacketizer */
+    size_t      i_buffer;
+    size_t      i_allocated;
+
+    uint32_t    i_rtp_timestamp;
+    mtime_t     first_arrival;  /* earliest packet */
+    mtime_t     last_arrival;   /* latest packet */
+    unsigned    i_packets;
+    unsigned    i_gaps;         /* packets following a sequence gap */
+    uint64_t    i_bytes;        /* RTP payload received */
+    uint32_t    i_flags;
+
+    /* from the slice headers, when the depacketizer parses them */
+    uint32_t    i_block_flags;  /* BLOCK_FLAG_TYPE_* and NO_KEYFRAME of the slices */
+    int         i_frame_num;    /* -1 if unknown */
+    int         i_poc;
+    int         i_width, i_height;
+    int         i_temporal_id;  /* H.265 TemporalId, -1 if unknown */
+    int         i_reference;    /* 1 if a slice is used for reference, 0 if none, -1 unknown */
+    uint8_t     i_key;          /* FRAME_KEY_*, 0 if not a random access point */
+};
+
+typedef void (*frame_output_t)( void *opaque, const frame_t *f );
+
+struct _frame_asm_t
+{
+    frame_t        *cur;        /* NULL between frames */
+    frame_t        *pool;
+    unsigned        i_pool;
+
+    frame_output_t  pf_output;
+    void           *opaque;
+
+};
+
+frame_asm_t *frame_asm_create( frame_output_t pf_output, void *opaque );
+/* outputs the pending frame */
+void         frame_asm_destroy( frame_asm_t *fa );
+
+/* a packet starts: closes the current frame if its timestamp differs */
+int          frame_asm_packet( frame_asm_t *fa, const block_t *block );
+/* appends to the current frame, between frame_asm_packet() and frame_asm_packet_end() */
+int          frame_asm_write( frame_asm_t *fa, const void *p, size_t i_size );
+/* the packet is done: closes the frame on the marker bit */
+void         frame_asm_packet_end( frame_asm_t *fa, const block_t *block );
+
+/* outputs the current frame, if any */
+void         frame_asm_flush( frame_asm_t *fa );
+
+#endif //_FRAME_H_
@@ -0,0 +1,316 @@
+/**
+ * @file gcc.c
+ * @brief Delay-based bandwidth estimation replay (GCC)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <xrtp_printf.h>
+
+#include "gcc.h"
+#include "session.h"
+
+#define GCC_GROUP_LENGTH    5000    /* send time span of a packet group, us */
+#define GCC_BURST_DELTA     5000    /* arrival delta of a burst, us */
+#define GCC_SMOOTHING       0.9
+#define GCC_THRESHOLD_GAIN  4.0
+#define GCC_MAX_DELTAS      60
+#define GCC_OVERUSE_TIME    10.0    /* ms */
+#define GCC_K_UP            0.0087
+#define GCC_K_DOWN          0.039
+#define GCC_BETA            0.85
+
+static const char *state_name[3] = { "normal", "underuse", "overuse" };
+
+gcc_t *gcc_create( const char *psz_file, uint32_t freq )
+{
+    gcc_t *g = (gcc_t *)calloc( 1, sizeof(gcc_t) );
+    if( g == NULL )
+        return NULL;
+
+    g->freq      = freq;
+    g->threshold = 12.5;
+    g->time_over = -1;
+    g->state     = GCC_NORMAL;
+
+    if( psz_file )
+    {
+        g->fp = fopen( psz_file, "w" );
+        if( g->fp == NULL )
+        {
+            xrtp_printf( XRTP_ERR, "gcc_create> can't open %s.\n", psz_file );
+            free( g );
+            return NULL;
+        }
+
+        fprintf( g->fp, "# arrival(ms) send_delta(ms) arrival_delta(ms) trend threshold "
+                        "state incoming(bps) estimate(bps)\n" );
+    }
+
+    return g;
+}
+
+void gcc_destroy( gcc_t *g )
+{
+    if( g == NULL )
+        return;
+
+    if( g->fp )
+        fclose( g->fp );
+
+    free( g );
+}
+
+/**
+ * Incoming bitrate over the last GCC_RATE_WINDOW.
+ */
+static void
+gcc_incoming ( gcc_t *g, mtime_t arrival, int i_size )
+{
+    const mtime_t i_bucket = GCC_RATE_WINDOW / 32;
+    mtime_t  t = arrival / i_bucket;
+    uint64_t sum = 0;
+    int i;
+
+    if( g->bucket_time == 0 || t - g->bucket_time >= 32 )
+    {
+        memset( g->bucket, 0, sizeof(g->bucket) );
+    }
+    else
+    {
+        for( ; g->bucket_time < t; )
+            g->bucket[++g->bucket_time & 31] = 0;
+    }
+    if( t > g->bucket_time )
+        g->bucket_time = t;
+
+    g->bucket[t & 31] += i_size;
+
+    for( i = 0; i < 32; i++ )
+        sum += g->bucket[i];
+
+    g->incoming = sum * 8 * CLOCK_FREQ / GCC_RATE_WINDOW;
+}
+
+/**
+ * Least squares slope of the smoothed accumulated delay.
+ */
+static double
+gcc_slope ( const gcc_t *g )
+{
+    double sx = 0, sy = 0, num = 0, den = 0;
+    int i;
+
+    for( i = 0; i < GCC_WINDOW; i++ )
+    {
+        sx += g->x[i];
+        sy += g->y[i];
+    }
+    sx /= GCC_WINDOW;
+    sy /= GCC_WINDOW;
+
+    for( i = 0; i < GCC_WINDOW; i++ )
+    {
+        num += (g->x[i] - sx) * (g->y[i] - sy);
+        den += (g->x[i] - sx) * (g->x[i] - sx);
+    }
+
+    return den != 0 ? num / den : 0;
+}
+
+static void
+gcc_detect ( gcc_t *g, double send_delta, mtime_t now )
+{
+    double trend = g->trend * (g->i_groups < GCC_MAX_DELTAS ? g->i_groups : GCC_MAX_DELTAS)
+                 * GCC_THRESHOLD_GAIN;
+    double dt;
+    int    state = g->state;
+
+    if( trend > g->threshold )
+    {
+        if( g->time_over < 0 )
+            g->time_over = send_delta / 2;
+        else
+            g->time_over += send_delta;
+        g->i_over++;
+
+        if( g->time_over > GCC_OVERUSE_TIME && g->i_over > 1 && trend >= g->prev_trend )
+        {
+            g->time_over = 0;
+            g->i_over    = 0;
+            state = GCC_OVERUSING;
+        }
+    }
+    else
+    {
+        g->time_over = -1;
+        g->i_over    = 0;
+        state = trend < -g->threshold ? GCC_UNDERUSING : GCC_NORMAL;
+    }
+    g->prev_trend = trend;
+
+    /* adaptive threshold, not driven by sudden spikes */
+    dt = g->last_update ? (double)(now - g->last_update) / 1000 : 0;
+    if( dt > 100 )
+        dt = 100;
+    if( fabs( trend ) <= g->threshold + 15 )
+    {
+        double k = fabs( trend ) < g->threshold ? GCC_K_DOWN : GCC_K_UP;
+
+        g->threshold += k * (fabs( trend ) - g->threshold) * dt;
+        if( g->threshold < 6 )   g->threshold = 6;
+        if( g->threshold > 600 ) g->threshold = 600;
+    }
+    g->last_update = now;
+
+    if( state == GCC_OVERUSING && g->state != GCC_OVERUSING )
+        g->i_overuse++;
+    if( state == GCC_UNDERUSING && g->state != GCC_UNDERUSING )
+        g->i_underuse++;
+
+    g->state = state;
+}
+
+static void
+gcc_rate ( gcc_t *g, mtime_t now )
+{
+    double dt = g->last_change ? (double)(now - g->last_change) / CLOCK_FREQ : 0;
+
+    if( g->incoming == 0 )
+        return;
+
+    if( g->estimate == 0 )
+    {   /* start from the first full incoming bitrate window */
+        if( now - g->first_arrival < GCC_RATE_WINDOW )
+            return;
+        g->estimate = (double)g->incoming;
+    }
+    else if( g->state == GCC_OVERUSING )
+    {
+        double r = GCC_BETA * g->incoming;
+
+        if( r < g->estimate )
+            g->estimate = r;
+    }
+    else if( g->state == GCC_NORMAL )
+    {
+        /* multiplicative increase, 8% per second */
+        g->estimate *= pow( 1.08, dt < 1. ? dt : 1. );
+
+        if( g->estimate > 1.5 * g->incoming + 10000 )
+            g->estimate = 1.5 * g->incoming + 10000;
+    }
+    /* underusing: hold */
+
+    g->last_change = now;
+
+    if( g->estimate_min == 0 || g->estimate < g->estimate_min )
+        g->estimate_min = g->estimate;
+    if( g->estimate > g->estimate_max )
+        g->estimate_max = g->estimate;
+}
+
+/**
+ * A packet group is complete: compare it with the previous one.
+ */
+static void
+gcc_group ( gcc_t *g )
+{
+    const gcc_group_t *cur = &g->cur, *prev = &g->prev;
+    double send_delta    = (double)(cur->last_send - prev->last_send) / 1000;
+    double arrival_delta = (double)(cur->last_arrival - prev->last_arrival) / 1000;
+    double x;
+
+    g->i_groups++;
+
+    /* trendline filter */
+    g->accumulated += arrival_delta - send_delta;
+    g->smoothed     = GCC_SMOOTHING * g->smoothed + (1 - GCC_SMOOTHING) * g->accumulated;
+
+    x = (double)(cur->last_arrival - g->first_arrival) / 1000;
+    g->x[g->i_samples % GCC_WINDOW] = x;
+    g->y[g->i_samples % GCC_WINDOW] = g->smoothed;
+    g->i_samples++;
+
+    if( g->i_samples >= GCC_WINDOW )
+        g->trend = gcc_slope( g );
+
+    gcc_detect( g, send_delta, cur->last_arrival );
+    gcc_rate( g, cur->last_arrival );
+
+    if( g->fp )
+        fprintf( g->fp, "%.3f %.3f %.3f %.4f %.2f %s %llu %.0f\n",
+                 x, send_delta, arrival_delta,
+                 g->prev_trend, g->threshold, state_name[g->state],
+                 (unsigned long long)g->incoming, g->estimate );
+}
+
+void gcc_update( gcc_t *g, mtime_t send_time, int64_t ext_ts,
+                 mtime_t arrival, int i_size )
+{
+    gcc_group_t *cur = &g->cur;
+
+    if( send_time < 0 )
+        send_time = ext_ts * CLOCK_FREQ / g->freq;
+
+    if( g->first_arrival == 0 )
+        g->first_arrival = arrival;
+
+    gcc_incoming( g, arrival, i_size );
+
+    if( cur->b_valid )
+    {
+        /* reordered: not used for the delay estimation */
+        if( send_time < cur->first_send )
+            return;
+
+        if( send_time - cur->first_send > GCC_GROUP_LENGTH
+         && !( arrival - cur->last_arrival < GCC_BURST_DELTA
+            && (arrival - cur->last_arrival) - (send_time - cur->last_send) < 0 ) )
+        {
+            /* new group */
+            if( g->prev.b_valid )
+            {
+                mtime_t t = cur->last_arrival - g->prev.last_arrival;
+
+                gcc_group( g );
+                g->state_time[g->state] += t;
+            }
+
+            g->prev = *cur;
+            cur->b_valid = 0;
+        }
+    }
+
+    if( !cur->b_valid )
+    {
+        cur->first_send    = send_time;
+        cur->first_arrival = arrival;
+        cur->i_size        = 0;
+        cur->b_valid       = 1;
+    }
+
+    if( send_time > cur->last_send || cur->i_size == 0 )
+        cur->last_send = send_time;
+    cur->last_arrival = arrival;
+    cur->i_size      += i_size;
+}
+
+void gcc_report( const gcc_t *g, FILE *fp )
+{
+    mtime_t total = g->state_time[0] + g->state_time[1] + g->state_time[2];
+
+    fprintf( fp, "  gcc:    estimate %.0f bps (min %.0f, max %.0f), incoming %llu bps\n",
+                 g->estimate, g->estimate_min, g->estimate_max,
+                 (unsigned long long)g->incoming );
+
+    fprintf( fp, "          groups %u, overuse %u, underuse %u",
+                 g->i_groups, g->i_overuse, g->i_underuse );
+    if( total > 0 )
+        fprintf( fp, ", time overusing %.1f%%, underusing %.1f%%",
+                     g->state_time[GCC_OVERUSING] * 100. / total,
+                     g->state_time[GCC_UNDERUSING] * 100. / total );
+    fprintf( fp, "\n" );
+}
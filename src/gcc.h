@@ -0,0 +1,88 @@
+#ifndef _GCC_H_
+#define _GCC_H_
+
+#include <stdio.h>
+
+#include "xrtp.h"
+
+/*
+ * Offline replay of the delay-based bandwidth estimator of Google
+ * congestion control (draft-ietf-rmcat-gcc): packet groups, trendline
+ * filter, adaptive overuse detector and AIMD rate control.
+ *
+ * Runs per source in arrival order. Send times come from abs-send-time
+ * when it is mapped, from the RTP timestamps otherwise (as the single
+ * stream remote estimator does). Every completed packet group appends a
+ * line to the estimate timeline.
+ */
+
+#define GCC_WINDOW          20      /* trendline window, packet groups */
+#define GCC_RATE_WINDOW     500000  /* incoming bitrate window, us */
+
+#define GCC_NORMAL          0
+#define GCC_UNDERUSING      1
+#define GCC_OVERUSING       2
+
+typedef struct _gcc_group_t
+{
+    mtime_t  first_send;
+    mtime_t  last_send;
+    mtime_t  first_arrival;
+    mtime_t  last_arrival;
+    uint32_t i_size;
+    int      b_valid;
+
+}gcc_group_t;
+
+struct _gcc_t
+{
+    FILE        *fp;            /* timeline, NULL if not written */
+
+    uint32_t    freq;           /* RTP clock, when there is no abs-send-time */
+
+    gcc_group_t cur, prev;
+
+    /* trendline */
+    double      accumulated;
+    double      smoothed;
+    double      x[GCC_WINDOW], y[GCC_WINDOW];
+    unsigned    i_samples;
+    mtime_t     first_arrival;
+    double      trend;          /* slope, before the gain */
+
+    /* overuse detector */
+    double      threshold;
+    double      prev_trend;     /* last modified trend */
+    double      time_over;
+    int         i_over;
+    mtime_t     last_update;
+    int         state;
+
+    /* incoming bitrate, sliding window of 32 buckets */
+    uint32_t    bucket[32];
+    mtime_t     bucket_time;
+    uint64_t    incoming;       /* bit/s */
+
+    /* AIMD */
+    double      estimate;       /* bit/s */
+    mtime_t     last_change;
+
+    /* summary */
+    unsigned    i_groups;
+    unsigned    i_overuse, i_underuse;
+    double      estimate_min, estimate_max;
+    mtime_t     state_time[3];
+
+};
+
+gcc_t *gcc_create( const char *psz_file, uint32_t freq );
+void   gcc_destroy( gcc_t *g );
+
+/* one packet in arrival order, send_time < 0 if unknown,
+ * ext_ts: unwrapped RTP timestamp */
+void   gcc_update( gcc_t *g, mtime_t send_time, int64_t ext_ts,
+                   mtime_t arrival, int i_size );
+
+void   gcc_report( const gcc_t *g, FILE *fp );
+
+#endif //_GCC_H_
@@ -0,0 +1,376 @@
+/**
+ * @file h264.c
+ * @brief H.264 parameter sets and slice header parsing
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "h264.h"
+#include "bitstream.h"
+
+h264_parser_t *h264_parser_create( void )
+{
+    return (h264_parser_t *)calloc( 1, sizeof(h264_parser_t) );
+}
+
+void h264_parser_destroy( h264_parser_t *p )
+{
+    if( p )
+        free( p );
+}
+
+static void
+h264_skip_scaling_list ( bsr_t *s, int i_size )
+{
+    int i, i_last = 8, i_next = 8;
+
+    for( i = 0; i < i_size && i_next != 0; i++ )
+    {
+        i_next = (i_last + bsr_read_se( s ) + 256) % 256;
+        if( i_next != 0 )
+            i_last = i_next;
+    }
+}
+
+static int
+h264_read_sps ( bsr_t *s, h264_sps_t *p_sps )
+{
+    h264_sps_t sps;
+    unsigned i_id, i_chroma = 1, i;
+    unsigned i_mbs_w, i_map_h, i_log2;
+    int i_crop_x, i_crop_y;
+
+    memset( &sps, 0, sizeof(sps) );
+
+    sps.i_profile = (uint8_t)bsr_read( s, 8 );
+    bsr_skip( s, 8 );                                   /* constraint flags */
+    sps.i_level   = (uint8_t)bsr_read( s, 8 );
+
+    i_id = bsr_read_ue( s );
+    if( i_id >= H264_SPS_MAXIMUM )
+        return -1;
+
+    switch( sps.i_profile )
+    {
+        case 100: case 110: case 122: case 244: case 44:
+        case 83:  case 86:  case 118: case 128: case 138:
+        case 139: case 134: case 135:
+            i_chroma = bsr_read_ue( s );
+            if( i_chroma > 3 )
+                return -1;
+            if( i_chroma == 3 )
+                sps.b_separate_colour_plane = (uint8_t)bsr_read1( s );
+            sps.b_chroma_format    = 1;
+            sps.i_bit_depth_luma   = (uint8_t)bsr_read_ue( s );
+            sps.i_bit_depth_chroma = (uint8_t)bsr_read_ue( s );
+            bsr_skip( s, 1 );                           /* qpprime_y_zero_transform_bypass */
+            if( bsr_read1( s ) )                        /* seq_scaling_matrix_present */
+            {
+                for( i = 0; i < (i_chroma != 3 ? 8u : 12u); i++ )
+                {
+                    if( bsr_read1( s ) )
+                        h264_skip_scaling_list( s, i < 6 ? 16 : 64 );
+                }
+            }
+            break;
+    }
+
+    /* both at most 16: they size the slice header fields and the wraps */
+    i_log2 = bsr_read_ue( s );
+    if( i_log2 > 16 - 4 )
+        return -1;
+    sps.i_log2_max_frame_num = (uint8_t)(i_log2 + 4);
+    sps.i_poc_type           = (uint8_t)bsr_read_ue( s );
+
+    if( sps.i_poc_type == 0 )
+    {
+        i_log2 = bsr_read_ue( s );
+        if( i_log2 > 16 - 4 )
+            return -1;
+        sps.i_log2_max_poc_lsb = (uint8_t)(i_log2 + 4);
+    }
+    else if( sps.i_poc_type == 1 )
+    {
+        sps.b_delta_pic_order_always_zero    = (uint8_t)bsr_read1( s );
+        sps.i_offset_for_non_ref_pic         = bsr_read_se( s );
+        sps.i_offset_for_top_to_bottom_field = bsr_read_se( s );
+        sps.i_ref_frames_in_poc_cycle        = bsr_read_ue( s );
+        if( sps.i_ref_frames_in_poc_cycle > H264_POC_CYCLE_MAXIMUM )
+            return -1;
+        for( i = 0; i < sps.i_ref_frames_in_poc_cycle; i++ )
+            sps.i_offset_for_ref_frame[i] = bsr_read_se( s );
+    }
+    else if( sps.i_poc_type != 2 )
+        return -1;
+
+    bsr_read_ue( s );                                   /* max_num_ref_frames */
+    bsr_skip( s, 1 );                                   /* gaps_in_frame_num_allowed */
+    i_mbs_w = bsr_read_ue( s ) + 1;
+    i_map_h = bsr_read_ue( s ) + 1;
+    sps.b_frame_mbs_only = (uint8_t)bsr_read1( s );
+    if( !sps.b_frame_mbs_only )
+        bsr_skip( s, 1 );                               /* mb_adaptive_frame_field */
+    bsr_skip( s, 1 );                                   /* direct_8x8_inference */
+
+    sps.i_width  = i_mbs_w * 16;
+    sps.i_height = (2 - sps.b_frame_mbs_only) * i_map_h * 16;
+
+    if( bsr_read1( s ) )                                /* frame_cropping */
+    {
+        unsigned l = bsr_read_ue( s ), r = bsr_read_ue( s );
+        unsigned t = bsr_read_ue( s ), b = bsr_read_ue( s );
+
+        if( sps.b_separate_colour_plane || i_chroma == 0 )
+        {
+            i_crop_x = 1;
+            i_crop_y = 2 - sps.b_frame_mbs_only;
+        }
+        else
+        {
+            i_crop_x = i_chroma == 3 ? 1 : 2;
+            i_crop_y = (i_chroma == 1 ? 2 : 1) * (2 - sps.b_frame_mbs_only);
+        }
+
+        sps.i_width  -= i_crop_x * (l + r);
+        sps.i_height -= i_crop_y * (t + b);
+    }
+
+    if( s->b_error || sps.i_width <= 0 || sps.i_height <= 0 )
+        return -1;
+
+    sps.i_chroma_format = (uint8_t)i_chroma;
+    sps.b_valid = 1;
+    *p_sps = sps;
+
+    return (int)i_id;
+}
+
+int h264_parse_sps( const uint8_t *p_data, int i_data, h264_sps_t *sps )
+{
+    bsr_t s;
+
+    bsr_init( &s, p_data, i_data );
+
+    return h264_read_sps( &s, sps );
+}
+
+static int
+h264_parse_pps ( h264_parser_t *p, bsr_t *s )
+{
+    unsigned i_id  = bsr_read_ue( s );
+    unsigned i_sps = bsr_read_ue( s );
+    h264_pps_t *pps;
+
+    if( i_id >= H264_PPS_MAXIMUM || i_sps >= H264_SPS_MAXIMUM )
+        return -1;
+
+    pps = &p->pps[i_id];
+
+    bsr_skip( s, 1 );                                   /* entropy_coding_mode */
+    pps->b_bottom_field_pic_order = (uint8_t)bsr_read1( s );
+    pps->i_sps   = (uint8_t)i_sps;
+    pps->b_valid = !s->b_error;
+
+    return s->b_error ? -1 : 0;
+}
+
+/**
+ * Picture order count, 8.2.1, of the first slice of a picture.
+ */
+static void
+h264_poc ( h264_parser_t *p, const h264_sps_t *sps, h264_slice_t *sl,
+           unsigned i_poc_lsb, int i_delta_bottom, const int *i_delta )
+{
+    int i_max_frame_num = 1 << sps->i_log2_max_frame_num;
+    int i_frame_num_offset = 0;
+    int i_top = 0, i_bottom = 0;
+
+    if( sps->i_poc_type == 0 )
+    {
+        int i_max_lsb = 1 << sps->i_log2_max_poc_lsb;
+        int i_lsb = (int)i_poc_lsb;
+        int i_msb;
+
+        if( sl->b_idr )
+            p->i_prev_poc_msb = p->i_prev_poc_lsb = 0;
+
+        if( i_lsb < p->i_prev_poc_lsb && p->i_prev_poc_lsb - i_lsb >= i_max_lsb / 2 )
+            i_msb = p->i_prev_poc_msb + i_max_lsb;
+        else if( i_lsb > p->i_prev_poc_lsb && i_lsb - p->i_prev_poc_lsb > i_max_lsb / 2 )
+            i_msb = p->i_prev_poc_msb - i_max_lsb;
+        else
+            i_msb = p->i_prev_poc_msb;
+
+        i_top    = i_msb + i_lsb;
+        i_bottom = sl->b_field ? i_top : i_top + i_delta_bottom;
+
+        if( sl->i_nal_ref_idc )
+        {
+            p->i_prev_poc_msb = i_msb;
+            p->i_prev_poc_lsb = i_lsb;
+        }
+    }
+    else
+    {
+        if( !sl->b_idr )
+        {
+            i_frame_num_offset = p->i_prev_frame_num_offset;
+            if( p->i_prev_frame_num > sl->i_frame_num )
+                i_frame_num_offset += i_max_frame_num;
+        }
+
+        if( sps->i_poc_type == 1 )
+        {
+            int i_abs = sps->i_ref_frames_in_poc_cycle ? i_frame_num_offset + sl->i_frame_num : 0;
+            int i_expected = 0;
+            unsigned i;
+
+            if( sl->i_nal_ref_idc == 0 && i_abs > 0 )
+                i_abs--;
+
+            if( i_abs > 0 )
+            {
+                int i_cycle = (i_abs - 1) / sps->i_ref_frames_in_poc_cycle;
+                int i_in_cycle = (i_abs - 1) % sps->i_ref_frames_in_poc_cycle;
+                int i_delta_cycle = 0;
+
+                for( i = 0; i < sps->i_ref_frames_in_poc_cycle; i++ )
+                    i_delta_cycle += sps->i_offset_for_ref_frame[i];
+
+                i_expected = i_cycle * i_delta_cycle;
+                for( i = 0; i <= (unsigned)i_in_cycle; i++ )
+                    i_expected += sps->i_offset_for_ref_frame[i];
+            }
+            if( sl->i_nal_ref_idc == 0 )
+                i_expected += sps->i_offset_for_non_ref_pic;
+
+            /* a bottom field takes the offset too (8-10), with
+             * delta_pic_order_cnt[ 0 ], its [ 1 ] is not coded */
+            i_top    = i_expected + i_delta[0];
+            i_bottom = i_top + sps->i_offset_for_top_to_bottom_field + i_delta[1];
+        }
+        else
+        {
+            i_top = sl->b_idr ? 0 : 2 * (i_frame_num_offset + sl->i_frame_num)
+                                  - (sl->i_nal_ref_idc == 0);
+            i_bottom = i_top;
+        }
+
+        p->i_prev_frame_num_offset = i_frame_num_offset;
+    }
+
+    p->i_prev_frame_num = sl->i_frame_num;
+
+    sl->i_poc = sl->b_field ? (sl->b_bottom ? i_bottom : i_top)
+                            : (i_top < i_bottom ? i_top : i_bottom);
+}
+
+static int
+h264_parse_slice ( h264_parser_t *p, bsr_t *s, h264_slice_t *sl )
+{
+    const h264_pps_t *pps;
+    const h264_sps_t *sps;
+    unsigned i_pps, i_type, i_poc_lsb = 0;
+    int i_delta_bottom = 0, i_delta[2] = { 0, 0 };
+
+    sl->i_first_mb = bsr_read_ue( s );
+    i_type         = bsr_read_ue( s );
+    i_pps          = bsr_read_ue( s );
+
+    if( i_type > 9 || i_pps >= H264_PPS_MAXIMUM || !p->pps[i_pps].b_valid )
+        return -1;
+
+    pps = &p->pps[i_pps];
+    sps = &p->sps[pps->i_sps];
+    if( !sps->b_valid )
+        return -1;
+
+    sl->i_slice_type = (uint8_t)(i_type % 5);
+
+    if( sps->b_separate_colour_plane )
+        bsr_skip( s, 2 );                               /* colour_plane_id */
+
+    sl->i_frame_num = (int)bsr_read( s, sps->i_log2_max_frame_num );
+
+    if( !sps->b_frame_mbs_only )
+    {
+        sl->b_field = (uint8_t)bsr_read1( s );
+        if( sl->b_field )
+            sl->b_bottom = (uint8_t)bsr_read1( s );
+    }
+
+    if( sl->b_idr )
+        bsr_read_ue( s );                               /* idr_pic_id */
+
+    if( sps->i_poc_type == 0 )
+    {
+        i_poc_lsb = bsr_read( s, sps->i_log2_max_poc_lsb );
+        if( pps->b_bottom_field_pic_order && !sl->b_field )
+            i_delta_bottom = bsr_read_se( s );
+    }
+    else if( sps->i_poc_type == 1 && !sps->b_delta_pic_order_always_zero )
+    {
+        i_delta[0] = bsr_read_se( s );
+        if( pps->b_bottom_field_pic_order && !sl->b_field )
+            i_delta[1] = bsr_read_se( s );
+    }
+
+    if( s->b_error )
+        return -1;
+
+    sl->i_width  = sps->i_width;
+    sl->i_height = sps->i_height;
+
+    /* POC state moves once per picture */
+    if( sl->i_first_mb == 0 )
+        h264_poc( p, sps, sl, i_poc_lsb, i_delta_bottom, i_delta );
+
+    return 0;
+}
+
+int h264_parse_nal( h264_parser_t *p, uint8_t nal_header,
+                    const uint8_t *p_data, int i_data, h264_slice_t *slice )
+{
+    int i_type = nal_header & 0x1F;
+    bsr_t s;
+
+    slice->i_nal_type = 0;
+    bsr_init( &s, p_data, i_data );
+
+    switch( i_type )
+    {
+        case H264_NAL_SPS:
+        {
+            h264_sps_t sps;
+            int i_id = h264_read_sps( &s, &sps );
+
+            if( i_id < 0 )
+                return -1;
+            p->sps[i_id] = sps;
+            return i_type;
+        }
+
+        case H264_NAL_PPS:
+            return h264_parse_pps( p, &s ) < 0 ? -1 : i_type;
+
+        case H264_NAL_SLICE:
+        case H264_NAL_IDR:
+            memset( slice, 0, sizeof(*slice) );
+            slice->i_nal_type    = (uint8_t)i_type;
+            slice->i_nal_ref_idc = (nal_header >> 5) & 3;
+            slice->b_idr         = i_type == H264_NAL_IDR;
+            slice->i_poc         = -1;
+
+            if( h264_parse_slice( p, &s, slice ) < 0 )
+            {
+                slice->i_nal_type = 0;
+                return -1;
+            }
+            return i_type;
+
+
+        default:
+            return i_type;
+    }
+}
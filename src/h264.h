@@ -0,0 +1,93 @@
+#ifndef _H264_H_
+#define _H264_H_
+
+#include "xrtp.h"
+
+/*
+ * H.264 parameter sets and slice headers, as much as needed to tag the
+ * frames: slice type, IDR, frame_num, POC and resolution. Slices are
+ * only read up to the POC fields, a few bytes.
+ *
+ * POC is derived as in 8.2.1 without memory_management_control_operation
+ * 5 (it sits after the reference lists and weights).
+ */
+
+#define H264_NAL_SLICE      1
+#define H264_NAL_IDR        5
+#define H264_NAL_SEI        6
+#define H264_NAL_SPS        7
+#define H264_NAL_PPS        8
+#define H264_NAL_AUD        9
+
+#define H264_SPS_MAXIMUM    32
+#define H264_PPS_MAXIMUM    256
+#define H264_POC_CYCLE_MAXIMUM 256
+
+typedef struct _h264_sps_t
+{
+    uint8_t  b_valid;
+    uint8_t  i_profile, i_level;
+    uint8_t  b_chroma_format;       /* the high profiles: chroma and bit depths coded */
+    uint8_t  i_chroma_format;       /* chroma_format_idc, 1 if not coded */
+    uint8_t  i_bit_depth_luma, i_bit_depth_chroma;     /* minus 8 */
+    uint8_t  b_separate_colour_plane;
+    uint8_t  b_frame_mbs_only;
+    uint8_t  i_log2_max_frame_num;
+    uint8_t  i_poc_type;
+    uint8_t  i_log2_max_poc_lsb;
+    uint8_t  b_delta_pic_order_always_zero;
+    int32_t  i_offset_for_non_ref_pic;
+    int32_t  i_offset_for_top_to_bottom_field;
+    unsigned i_ref_frames_in_poc_cycle;
+    int32_t  i_offset_for_ref_frame[H264_POC_CYCLE_MAXIMUM];
+    int      i_width, i_height;
+
+}h264_sps_t;
+
+typedef struct _h264_pps_t
+{
+    uint8_t  b_valid;
+    uint8_t  i_sps;
+    uint8_t  b_bottom_field_pic_order;
+
+}h264_pps_t;
+
+typedef struct _h264_slice_t
+{
+    uint8_t  i_nal_type;
+    uint8_t  i_nal_ref_idc;
+    uint8_t  i_slice_type;      /* 0 P, 1 B, 2 I, 3 SP, 4 SI */
+    uint8_t  b_idr;
+    uint8_t  b_field, b_bottom;
+    unsigned i_first_mb;
+    int      i_frame_num;
+    int      i_poc;
+    int      i_width, i_height;
+
+}h264_slice_t;
+
+typedef struct _h264_parser_t
+{
+    h264_sps_t sps[H264_SPS_MAXIMUM];
+    h264_pps_t pps[H264_PPS_MAXIMUM];
+
+    /* POC state of the previous picture */
+    int        i_prev_poc_msb, i_prev_poc_lsb;
+    int        i_prev_frame_num, i_prev_frame_num_offset;
+
+}h264_parser_t;
+
+h264_parser_t *h264_parser_create( void );
+void           h264_parser_destroy( h264_parser_t *p );
+
+/* nal_header: first byte of the NAL unit, p: the bytes after it.
+ * Returns the NAL type, -1 if a parameter set or slice header is broken;
+ * slice is filled for slices with a known PPS (i_nal_type set). */
+int h264_parse_nal( h264_parser_t *p, uint8_t nal_header,
+                    const uint8_t *p_data, int i_data, h264_slice_t *slice );
+
+/* an SPS alone, p: the bytes after the NAL header.
+ * Returns seq_parameter_set_id, -1 if broken. */
+int h264_parse_sps( const uint8_t *p_data, int i_data, h264_sps_t *sps );
+
+#endif //_H264_H_
@@ -0,0 +1,318 @@
+/**
+ * @file h265.c
+ * @brief H.265 parameter sets and slice segment header parsing
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "h265.h"
+#include "bitstream.h"
+
+h265_parser_t *h265_parser_create( void )
+{
+    h265_parser_t *p = (h265_parser_t *)calloc( 1, sizeof(h265_parser_t) );
+
+    if( p )
+        p->b_first_picture = 1;
+
+    return p;
+}
+
+void h265_parser_destroy( h265_parser_t *p )
+{
+    if( p )
+        free( p );
+}
+
+/* profile_tier_level( 1, i_max_sub_layers - 1 ), keeps the general part */
+static void
+h265_read_profile_tier_level ( bsr_t *s, int i_max_sub_layers, uint8_t general[12] )
+{
+    uint8_t b_profile[8], b_level[8];
+    int i;
+
+    /* general profile, general_level_idc: byte aligned in the SPS */
+    for( i = 0; i < 12; i++ )
+        general[i] = (uint8_t)bsr_read( s, 8 );
+
+    for( i = 0; i < i_max_sub_layers - 1; i++ )
+    {
+        b_profile[i] = (uint8_t)bsr_read1( s );
+        b_level[i]   = (uint8_t)bsr_read1( s );
+    }
+    if( i_max_sub_layers > 1 )
+        bsr_skip( s, 2 * (9 - i_max_sub_layers) );      /* reserved_zero_2bits */
+
+    for( i = 0; i < i_max_sub_layers - 1; i++ )
+    {
+        if( b_profile[i] )
+            bsr_skip( s, 88 );
+        if( b_level[i] )
+            bsr_skip( s, 8 );
+    }
+}
+
+static int
+h265_parse_vps ( h265_parser_t *p, bsr_t *s )
+{
+    unsigned i_id = bsr_read( s, 4 );
+    h265_vps_t *vps = &p->vps[i_id];
+
+    bsr_skip( s, 2 );                                   /* base_layer flags */
+    bsr_skip( s, 6 );                                   /* max_layers_minus1 */
+    vps->i_max_sub_layers = (uint8_t)(bsr_read( s, 3 ) + 1);
+    vps->b_valid = !s->b_error && vps->i_max_sub_layers <= 7;
+
+    return vps->b_valid ? 0 : -1;
+}
+
+static int
+h265_read_sps ( bsr_t *s, h265_sps_t *p_sps )
+{
+    h265_sps_t sps;
+    unsigned i_id, i_chroma, i, i_first;
+    unsigned i_log2_ctb, i_ctbs, i_pic_width, i_pic_height;
+    int i_sub_x = 1, i_sub_y = 1;
+
+    memset( &sps, 0, sizeof(sps) );
+
+    bsr_skip( s, 4 );                                   /* sps_video_parameter_set_id */
+    sps.i_max_sub_layers = (uint8_t)(bsr_read( s, 3 ) + 1);
+    if( sps.i_max_sub_layers > 7 )
+        return -1;
+    sps.b_temporal_id_nesting = (uint8_t)bsr_read1( s );
+    h265_read_profile_tier_level( s, sps.i_max_sub_layers, sps.general_ptl );
+
+    i_id = bsr_read_ue( s );
+    if( i_id >= H265_SPS_MAXIMUM )
+        return -1;
+
+    i_chroma = bsr_read_ue( s );
+    if( i_chroma > 3 )
+        return -1;
+    sps.i_chroma_format = (uint8_t)i_chroma;
+    if( i_chroma == 3 )
+        sps.b_separate_colour_plane = (uint8_t)bsr_read1( s );
+    if( !sps.b_separate_colour_plane && (i_chroma == 1 || i_chroma == 2) )
+    {
+        i_sub_x = 2;
+        i_sub_y = i_chroma == 1 ? 2 : 1;
+    }
+
+    i_pic_width  = bsr_read_ue( s );                   /* pic_width_in_luma_samples */
+    i_pic_height = bsr_read_ue( s );
+    sps.i_width  = (int)i_pic_width;
+    sps.i_height = (int)i_pic_height;
+
+    if( bsr_read1( s ) )                                /* conformance_window */
+    {
+        unsigned l = bsr_read_ue( s ), r = bsr_read_ue( s );
+        unsigned t = bsr_read_ue( s ), b = bsr_read_ue( s );
+
+        sps.i_width  -= i_sub_x * (l + r);
+        sps.i_height -= i_sub_y * (t + b);
+    }
+    sps.i_bit_depth_luma   = (uint8_t)bsr_read_ue( s );
+    sps.i_bit_depth_chroma = (uint8_t)bsr_read_ue( s );
+    sps.i_log2_max_poc_lsb = (uint8_t)(bsr_read_ue( s ) + 4);
+    if( sps.i_log2_max_poc_lsb > 16 )
+        return -1;
+
+    i_first = bsr_read1( s ) ? 0 : sps.i_max_sub_layers - 1;   /* sub_layer_ordering_info */
+    for( i = i_first; i < sps.i_max_sub_layers; i++ )
+    {
+        bsr_read_ue( s );                               /* max_dec_pic_buffering */
+        bsr_read_ue( s );                               /* max_num_reorder_pics */
+        bsr_read_ue( s );                               /* max_latency_increase */
+    }
+
+    i_log2_ctb  = bsr_read_ue( s ) + 3;                 /* log2_min_luma_coding_block_size */
+    i_log2_ctb += bsr_read_ue( s );                     /* log2_diff_max_min */
+    if( s->b_error || i_log2_ctb > 6 || sps.i_width <= 0 || sps.i_height <= 0 )
+        return -1;
+
+    /* picture size in CTBs, of the uncropped picture */
+    {
+        unsigned i_w = (i_pic_width + (1u << i_log2_ctb) - 1) >> i_log2_ctb;
+        unsigned i_h = (i_pic_height + (1u << i_log2_ctb) - 1) >> i_log2_ctb;
+
+        i_ctbs = i_w * i_h;
+    }
+    while( (1u << sps.i_ctb_address_bits) < i_ctbs )
+        sps.i_ctb_address_bits++;
+
+    sps.b_valid = 1;
+    *p_sps = sps;
+
+    return (int)i_id;
+}
+
+int h265_parse_sps( const uint8_t *p_data, int i_data, h265_sps_t *sps )
+{
+    bsr_t s;
+
+    bsr_init( &s, p_data, i_data );
+
+    return h265_read_sps( &s, sps );
+}
+
+static int
+h265_parse_pps ( h265_parser_t *p, bsr_t *s )
+{
+    unsigned i_id  = bsr_read_ue( s );
+    unsigned i_sps = bsr_read_ue( s );
+    h265_pps_t *pps;
+
+    if( i_id >= H265_PPS_MAXIMUM || i_sps >= H265_SPS_MAXIMUM )
+        return -1;
+
+    pps = &p->pps[i_id];
+
+    pps->b_dependent_slice_segments = (uint8_t)bsr_read1( s );
+    pps->b_output_flag_present      = (uint8_t)bsr_read1( s );
+    pps->i_extra_slice_header_bits  = (uint8_t)bsr_read( s, 3 );
+    pps->i_sps   = (uint8_t)i_sps;
+    pps->b_valid = !s->b_error;
+
+    return s->b_error ? -1 : 0;
+}
+
+/**
+ * Picture order count, 8.3.1, of the first slice segment of a picture.
+ */
+static void
+h265_poc ( h265_parser_t *p, const h265_sps_t *sps, h265_slice_t *sl, int i_lsb )
+{
+    int i_max_lsb = 1 << sps->i_log2_max_poc_lsb;
+    int t = sl->i_nal_type;
+    int i_msb;
+
+    /* IRAP with NoRaslOutputFlag: IDR, BLA, CRA starting the stream */
+    if( H265_IS_IDR( t ) || (t >= H265_NAL_BLA_W_LP && t < H265_NAL_IDR_W_RADL)
+     || (t == H265_NAL_CRA && p->b_first_picture) )
+        i_msb = 0;
+    else if( i_lsb < p->i_prev_poc_lsb && p->i_prev_poc_lsb - i_lsb >= i_max_lsb / 2 )
+        i_msb = p->i_prev_poc_msb + i_max_lsb;
+    else if( i_lsb > p->i_prev_poc_lsb && i_lsb - p->i_prev_poc_lsb > i_max_lsb / 2 )
+        i_msb = p->i_prev_poc_msb - i_max_lsb;
+    else
+        i_msb = p->i_prev_poc_msb;
+
+    sl->i_poc = i_msb + i_lsb;
+    p->b_first_picture = 0;
+
+    /* prevTid0Pic: not RADL, RASL nor a sub-layer non-reference picture */
+    if( sl->i_temporal_id == 0
+     && !(t >= H265_NAL_RADL_N && t <= H265_NAL_RASL_R)
+     && !(t <= 14 && (t & 1) == 0) )
+    {
+        p->i_prev_poc_msb = i_msb;
+        p->i_prev_poc_lsb = i_lsb;
+    }
+}
+
+static int
+h265_parse_slice ( h265_parser_t *p, bsr_t *s, h265_slice_t *sl )
+{
+    const h265_pps_t *pps;
+    const h265_sps_t *sps;
+    unsigned i_pps, i_type;
+    int i_lsb = 0;
+
+    sl->b_first = (uint8_t)bsr_read1( s );
+    if( H265_IS_IRAP( sl->i_nal_type ) )
+        bsr_skip( s, 1 );                               /* no_output_of_prior_pics */
+
+    i_pps = bsr_read_ue( s );
+    if( i_pps >= H265_PPS_MAXIMUM || !p->pps[i_pps].b_valid )
+        return -1;
+
+    pps = &p->pps[i_pps];
+    sps = &p->sps[pps->i_sps];
+    if( !sps->b_valid )
+        return -1;
+
+    sl->i_width  = sps->i_width;
+    sl->i_height = sps->i_height;
+
+    /* TRAIL_N, TSA_N, ... are still referenced by the higher sub-layers */
+    sl->b_reference = !( sl->i_nal_type <= 14 && (sl->i_nal_type & 1) == 0
+                      && sl->i_temporal_id + 1 >= sps->i_max_sub_layers );
+
+    if( !sl->b_first )
+    {
+        if( pps->b_dependent_slice_segments )
+            sl->b_dependent = (uint8_t)bsr_read1( s );
+        bsr_skip( s, sps->i_ctb_address_bits );         /* slice_segment_address */
+    }
+
+    if( sl->b_dependent )
+    {
+        sl->i_slice_type = p->i_slice_type;
+        return s->b_error ? -1 : 0;
+    }
+
+    bsr_skip( s, pps->i_extra_slice_header_bits );
+    i_type = bsr_read_ue( s );
+    if( i_type > 2 )
+        return -1;
+    sl->i_slice_type = p->i_slice_type = (uint8_t)i_type;
+
+    if( pps->b_output_flag_present )
+        bsr_skip( s, 1 );                               /* pic_output_flag */
+    if( sps->b_separate_colour_plane )
+        bsr_skip( s, 2 );                               /* colour_plane_id */
+    if( !H265_IS_IDR( sl->i_nal_type ) )
+        i_lsb = (int)bsr_read( s, sps->i_log2_max_poc_lsb );
+
+    if( s->b_error )
+        return -1;
+
+    if( sl->b_first )
+        h265_poc( p, sps, sl, i_lsb );
+
+    return 0;
+}
+
+int h265_parse_nal( h265_parser_t *p, const uint8_t nal[2],
+                    const uint8_t *p_data, int i_data, h265_slice_t *slice )
+{
+    int i_type = (nal[0] >> 1) & 0x3F;
+    bsr_t s;
+
+    slice->i_nal_type = 0xFF;
+    bsr_init( &s, p_data, i_data );
+
+    if( i_type == H265_NAL_VPS )
+        return h265_parse_vps( p, &s ) < 0 ? -1 : i_type;
+    if( i_type == H265_NAL_SPS )
+    {
+        h265_sps_t sps;
+        int i_id = h265_read_sps( &s, &sps );
+
+        if( i_id < 0 )
+            return -1;
+        p->sps[i_id] = sps;
+        return i_type;
+    }
+    if( i_type == H265_NAL_PPS )
+        return h265_parse_pps( p, &s ) < 0 ? -1 : i_type;
+
+    /* VCL: 0..9 and IRAP 16..21, the rest is reserved */
+    if( i_type > 21 || (i_type > 9 && i_type < H265_NAL_BLA_W_LP) )
+        return i_type;
+
+    memset( slice, 0, sizeof(*slice) );
+    slice->i_nal_type    = (uint8_t)i_type;
+    slice->i_temporal_id = (uint8_t)((nal[1] & 0x07) - 1);
+    slice->i_poc         = -1;
+
+    if( h265_parse_slice( p, &s, slice ) < 0 )
+    {
+        slice->i_nal_type = 0xFF;
+        return -1;
+    }
+
+    return i_type;
+}
@@ -0,0 +1,104 @@
+#ifndef _H265_H_
+#define _H265_H_
+
+#include "xrtp.h"
+
+/*
+ * H.265 parameter sets and slice segment headers, as much as needed to
+ * tag the pictures: NAL type (IRAP), temporal ID, slice type, POC and
+ * resolution. Slice segments are only read up to the POC LSB.
+ */
+
+#define H265_NAL_TRAIL_N    0
+#define H265_NAL_RADL_N     6
+#define H265_NAL_RASL_R     9
+#define H265_NAL_BLA_W_LP   16
+#define H265_NAL_IDR_W_RADL 19
+#define H265_NAL_IDR_N_LP   20
+#define H265_NAL_CRA        21
+#define H265_NAL_IRAP_MAX   23
+#define H265_NAL_VPS        32
+#define H265_NAL_SPS        33
+#define H265_NAL_PPS        34
+#define H265_NAL_AUD        35
+
+#define H265_IS_IRAP( t )   ((t) >= H265_NAL_BLA_W_LP && (t) <= H265_NAL_IRAP_MAX)
+#define H265_IS_IDR( t )    ((t) == H265_NAL_IDR_W_RADL || (t) == H265_NAL_IDR_N_LP)
+
+#define H265_VPS_MAXIMUM    16
+#define H265_SPS_MAXIMUM    16
+#define H265_PPS_MAXIMUM    64
+
+typedef struct _h265_vps_t
+{
+    uint8_t  b_valid;
+    uint8_t  i_max_sub_layers;
+
+}h265_vps_t;
+
+typedef struct _h265_sps_t
+{
+    uint8_t  b_valid;
+    uint8_t  i_max_sub_layers;
+    uint8_t  b_temporal_id_nesting;
+    uint8_t  general_ptl[12];       /* general_profile_space to general_level_idc, as coded */
+    uint8_t  i_chroma_format;       /* chroma_format_idc */
+    uint8_t  i_bit_depth_luma, i_bit_depth_chroma;     /* minus 8 */
+    uint8_t  b_separate_colour_plane;
+    uint8_t  i_log2_max_poc_lsb;
+    uint8_t  i_ctb_address_bits;    /* slice_segment_address */
+    int      i_width, i_height;
+
+}h265_sps_t;
+
+typedef struct _h265_pps_t
+{
+    uint8_t  b_valid;
+    uint8_t  i_sps;
+    uint8_t  b_dependent_slice_segments;
+    uint8_t  b_output_flag_present;
+    uint8_t  i_extra_slice_header_bits;
+
+}h265_pps_t;
+
+typedef struct _h265_slice_t
+{
+    uint8_t  i_nal_type;        /* 0xFF if not a parsed slice segment */
+    uint8_t  i_temporal_id;
+    uint8_t  b_reference;       /* not a sub-layer non-reference picture of the top layer */
+    uint8_t  b_first;           /* first slice segment of the picture */
+    uint8_t  b_dependent;
+    uint8_t  i_slice_type;      /* 0 B, 1 P, 2 I, as the independent segment */
+    int      i_poc;
+    int      i_width, i_height;
+
+}h265_slice_t;
+
+typedef struct _h265_parser_t
+{
+    h265_vps_t vps[H265_VPS_MAXIMUM];
+    h265_sps_t sps[H265_SPS_MAXIMUM];
+    h265_pps_t pps[H265_PPS_MAXIMUM];
+
+    uint8_t    i_slice_type;    /* of the last independent segment */
+
+    /* POC of the previous TemporalId 0 picture, 8.3.1 */
+    uint8_t    b_first_picture;
+    int        i_prev_poc_msb, i_prev_poc_lsb;
+
+}h265_parser_t;
+
+h265_parser_t *h265_parser_create( void );
+void           h265_parser_destroy( h265_parser_t *p );
+
+/* nal: the 2 bytes NAL unit header, p: the bytes after it.
+ * Returns the NAL type, -1 if a parameter set or slice header is broken;
+ * slice is filled for slice segments with a known PPS. */
+int h265_parse_nal( h265_parser_t *p, const uint8_t nal[2],
+                    const uint8_t *p_data, int i_data, h265_slice_t *slice );
+
+/* an SPS alone, p: the bytes after the NAL unit header.
+ * Returns sps_seq_parameter_set_id, -1 if broken. */
+int h265_parse_sps( const uint8_t *p_data, int i_data, h265_sps_t *sps );
+
+#endif //_H265_H_
@@ -0,0 +1,140 @@
+/**
+ * @file impact.c
+ * @brief Loss impact propagation and visibly corrupted seconds
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "impact.h"
+
+impact_t *impact_create( uint32_t freq )
+{
+    impact_t *im = (impact_t *)calloc( 1, sizeof(impact_t) );
+    if( im == NULL )
+        return NULL;
+
+    im->freq = freq ? freq : 90000;
+
+    return im;
+}
+
+void impact_destroy( impact_t *im )
+{
+    if( im )
+        free( im );
+}
+
+/**
+ * Marks the second of a corrupted frame, counting it once.
+ */
+static void
+impact_second ( impact_t *im, int64_t ts )
+{
+    int64_t i_sec = ts > im->first_ts ? (ts - im->first_ts) / im->freq : 0;
+    int64_t i_off;
+
+    if( i_sec > im->i_second )
+    {
+        int64_t i_shift = i_sec - im->i_second;
+
+        im->seconds  = i_shift >= IMPACT_SECONDS ? 0 : im->seconds << i_shift;
+        im->i_second = i_sec;
+    }
+
+    i_off = im->i_second - i_sec;
+    if( i_off >= IMPACT_SECONDS )
+        return;     /* too old, too far reordered */
+
+    if( !(im->seconds & ((uint64_t)1 << i_off)) )
+    {
+        im->seconds |= (uint64_t)1 << i_off;
+        im->i_seconds_corrupted++;
+    }
+}
+
+void impact_frame( impact_t *im, const frame_t *f )
+{
+    int b_damaged   = (f->i_flags & FRAME_FLAG_LOSS) != 0;
+    int b_key       = FRAME_IS_KEY( f );
+    int b_reference = b_key || f->i_reference > 0;  /* < 0: unknown */
+    int64_t ts;
+
+    if( !im->b_started )
+    {
+        im->ext_ts = im->first_ts = im->max_ts = f->i_rtp_timestamp;
+        im->b_started = 1;
+    }
+    else
+        im->ext_ts += (int32_t)(f->i_rtp_timestamp - im->last_ts);
+    im->last_ts = f->i_rtp_timestamp;
+    ts = im->ext_ts;
+    if( ts > im->max_ts )
+        im->max_ts = ts;
+
+    im->i_frames++;
+
+    if( b_damaged )
+    {
+        im->i_hit++;
+        im->i_gaps += f->i_gaps;
+
+        if( b_key )
+            im->i_hit_key++;
+        else if( f->i_reference > 0 )
+            im->i_hit_reference++;
+        else if( f->i_reference == 0 )
+            im->i_hit_other++;
+        else
+            im->i_hit_unknown++;
+    }
+    else if( b_key && im->b_corrupted )
+    {
+        /* refreshed */
+        hist_add( &im->recovery, (uint64_t)(ts - im->corrupted_ts) * 1000 / im->freq );
+        im->b_corrupted = 0;
+    }
+
+    if( b_damaged && b_reference && !im->b_corrupted )
+    {
+        im->b_corrupted  = 1;
+        im->corrupted_ts = ts;
+        im->i_corruptions++;
+    }
+
+    if( b_damaged || im->b_corrupted )
+    {
+        im->i_corrupted++;
+        if( !b_damaged )
+            im->i_propagated++;
+
+        impact_second( im, ts );
+    }
+}
+
+void impact_report( const impact_t *im, FILE *fp )
+{
+    uint64_t i_seconds;
+
+    if( im->i_frames == 0 )
+        return;
+
+    /* seconds with at least a frame */
+    i_seconds = (im->max_ts - im->first_ts) / im->freq + 1;
+
+    fprintf( fp, "  impact: gaps %u hit %u frames (key %u, reference %u, non-reference %u, "
+                 "unknown %u), corrupted %llu frames (%llu propagated)\n",
+                 im->i_gaps, im->i_hit, im->i_hit_key, im->i_hit_reference, im->i_hit_other,
+                 im->i_hit_unknown,
+                 (unsigned long long)im->i_corrupted, (unsigned long long)im->i_propagated );
+
+    fprintf( fp, "  vcs:    %llu of %llu s visibly corrupted (%.2f%%), corruptions %u",
+                 (unsigned long long)im->i_seconds_corrupted, (unsigned long long)i_seconds,
+                 im->i_seconds_corrupted * 100. / i_seconds, im->i_corruptions );
+    if( im->recovery.i_total )
+        fprintf( fp, ", recovery p50 %u, max %u ms",
+                     hist_quantile( &im->recovery, .5 ), im->recovery.max );
+    if( im->b_corrupted )
+        fprintf( fp, ", not recovered at the end" );
+    fprintf( fp, "\n" );
+}
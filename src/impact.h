@@ -0,0 +1,65 @@
+#ifndef _IMPACT_H_
+#define _IMPACT_H_
+
+#include <stdio.h>
+
+#include "xrtp.h"
+#include "stats.h"      /* hist_t */
+#include "frame.h"
+
+/*
+ * Loss impact: which frames the sequence gaps hit, and how long the
+ * damage stays on screen.
+ *
+ * A frame is hit when a packet after a gap belongs to it, or when the gap
+ * took its tail and marker; a missing marker alone is not a loss. A hit on a keyframe or a reference frame
+ * corrupts every following frame until the next intact keyframe
+ * (IDR/IRAP); a hit on a non-reference frame only spoils that frame, as
+ * does a hit on a frame of unknown reference status (counted apart).
+ * Only the H.264/H.265 sources are tracked: the tags come from their
+ * parsers.
+ *
+ * A second of media time (RTP timestamps) is visibly corrupted if one of
+ * its frames is. Only the last IMPACT_SECONDS seconds are kept, enough
+ * for the decoding to presentation reordering.
+ */
+
+#define IMPACT_SECONDS  64
+
+struct _impact_t
+{
+    uint32_t   freq;
+    int        b_started;
+    uint32_t   last_ts;
+    int64_t    ext_ts;          /* unwrapped timestamp of the last frame */
+    int64_t    first_ts;
+    int64_t    max_ts;
+
+    /* propagation */
+    int        b_corrupted;
+    int64_t    corrupted_ts;    /* first damaged frame of the current corruption */
+
+    /* seconds, bit i: second i_second - i */
+    int64_t    i_second;
+    uint64_t   seconds;
+
+    /* summary */
+    uint64_t   i_frames;
+    uint32_t   i_gaps;
+    uint32_t   i_hit, i_hit_key, i_hit_reference, i_hit_other, i_hit_unknown;
+    uint64_t   i_corrupted, i_propagated;
+    uint32_t   i_corruptions;
+    uint64_t   i_seconds_corrupted;
+    hist_t     recovery;        /* first damaged frame to the next intact keyframe, ms */
+
+};
+
+impact_t *impact_create( uint32_t freq );
+void      impact_destroy( impact_t *im );
+
+/* one assembled frame, in decoding order */
+void      impact_frame( impact_t *im, const frame_t *f );
+
+void      impact_report( const impact_t *im, FILE *fp );
+
+#endif //_IMPACT_H_
@@ -0,0 +1,209 @@
+/**
+ * @file jbsim.c
+ * @brief Jitter buffer playout simulation
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jbsim.h"
+#include "session.h"
+
+#define JB_SLOT         (JB_WINDOW / JB_SLOTS)
+#define JB_MIN_DELAY    25000       /* us, as rtp_dequeue() */
+#define JB_ALPHA        0.998       /* Ramjee et al., algorithm 1 */
+
+static const char *jb_name[] = { "", "fixed", "jitter", "ramjee" };
+
+int jbsim_parse( const char *psz, xrtp_jb_t *jb, unsigned *pi_count )
+{
+    while( *psz )
+    {
+        char   psz_type[16];
+        double f;
+        int    i_len, i;
+
+        if( *pi_count >= XRTP_JB_MAXIMUM
+         || sscanf( psz, "%15[a-z]:%lf%n", psz_type, &f, &i_len ) != 2 || f < 0 )
+            return -1;
+
+        for( i = JB_FIXED; i <= JB_RAMJEE; i++ )
+        {
+            if( !strcmp( psz_type, jb_name[i] ) )
+                break;
+        }
+        if( i > JB_RAMJEE )
+            return -1;
+
+        jb[*pi_count].i_type  = (uint8_t)i;
+        jb[*pi_count].f_param = f;
+        (*pi_count)++;
+
+        psz += i_len;
+        if( *psz == ',' )
+            psz++;
+        else if( *psz )
+            return -1;
+    }
+
+    return 0;
+}
+
+jbsim_t *jbsim_create( const xrtp_jb_t *jb, unsigned i_count, uint32_t freq )
+{
+    jbsim_t *sim = (jbsim_t *)calloc( 1, sizeof(jbsim_t) );
+    unsigned i;
+
+    if( sim == NULL )
+        return NULL;
+
+    sim->freq    = freq;
+    sim->i_count = i_count < XRTP_JB_MAXIMUM ? i_count : XRTP_JB_MAXIMUM;
+
+    for( i = 0; i < sim->i_count; i++ )
+        sim->s[i].cfg = jb[i];
+
+    return sim;
+}
+
+void jbsim_destroy( jbsim_t *sim )
+{
+    if( sim )
+        free( sim );
+}
+
+/**
+ * Playout offset of a new frame.
+ */
+static mtime_t
+jbsim_offset ( const jbsim_t *sim, const jb_strategy_t *s, mtime_t base, mtime_t jitter )
+{
+    mtime_t target;
+
+    switch( s->cfg.i_type )
+    {
+        case JB_FIXED:
+            return sim->first_transit + (mtime_t)(s->cfg.f_param * 1000);
+
+        case JB_JITTER:
+            target = (mtime_t)(s->cfg.f_param * jitter);
+            return base + (target > JB_MIN_DELAY ? target : JB_MIN_DELAY);
+
+        case JB_RAMJEE:
+        default:
+            return (mtime_t)(sim->d_hat + s->cfg.f_param * sim->v_hat);
+    }
+}
+
+void jbsim_update( jbsim_t *sim, int64_t ext_ts, mtime_t arrival, mtime_t jitter )
+{
+    int64_t i_slot = arrival / JB_SLOT;
+    mtime_t media, transit, base;
+    double  alpha;
+    int     b_frame;
+    unsigned i;
+
+    if( !sim->b_started )
+    {
+        sim->ts0      = ext_ts;
+        sim->frame_ts = ext_ts - 1;
+        sim->i_slot   = i_slot;
+        for( i = 0; i < JB_SLOTS; i++ )
+            sim->slot_min[i] = INT64_MAX;
+    }
+
+    media   = (ext_ts - sim->ts0) * CLOCK_FREQ / sim->freq;
+    transit = arrival - media;
+
+    if( !sim->b_started )
+    {
+        sim->first_transit = transit;
+        sim->d_hat         = (double)transit;
+        sim->b_started     = 1;
+    }
+
+    /* shared estimates: sliding minimum and smoothed transit */
+    for( ; sim->i_slot < i_slot; )
+    {
+        sim->i_slot++;
+        sim->slot_min[sim->i_slot % JB_SLOTS] = INT64_MAX;
+
+        if( i_slot - sim->i_slot >= JB_SLOTS )
+            sim->i_slot = i_slot - JB_SLOTS;
+    }
+    if( transit < sim->slot_min[i_slot % JB_SLOTS] )
+        sim->slot_min[i_slot % JB_SLOTS] = transit;
+
+    base = transit;
+    for( i = 0; i < JB_SLOTS; i++ )
+    {
+        if( sim->slot_min[i] < base )
+            base = sim->slot_min[i];
+    }
+
+    /* running mean until the EWMA has enough history */
+    sim->i_packets++;
+    alpha = 1. - 1. / sim->i_packets;
+    if( alpha > JB_ALPHA )
+        alpha = JB_ALPHA;
+
+    sim->d_hat = alpha * sim->d_hat + (1 - alpha) * transit;
+    sim->v_hat = alpha * sim->v_hat
+               + (1 - alpha) * (transit > sim->d_hat ? transit - sim->d_hat : sim->d_hat - transit);
+
+    b_frame = ext_ts > sim->frame_ts;
+    if( b_frame )
+        sim->frame_ts = ext_ts;
+
+    for( i = 0; i < sim->i_count; i++ )
+    {
+        jb_strategy_t *s = &sim->s[i];
+        mtime_t playout;
+
+        if( b_frame )
+        {
+            s->offset = jbsim_offset( sim, s, base, jitter );
+            s->b_late = 0;
+            s->i_frames++;
+        }
+
+        playout = media + s->offset;
+        s->i_packets++;
+
+        if( arrival > playout )
+        {
+            s->i_late++;
+
+            if( ext_ts == sim->frame_ts && !s->b_late )
+            {
+                s->b_late = 1;
+                s->i_underruns++;
+            }
+        }
+        else
+        {
+            s->delay_sum += playout - arrival;
+            if( playout - arrival > s->delay_max )
+                s->delay_max = playout - arrival;
+        }
+    }
+}
+
+void jbsim_report( const jbsim_t *sim, FILE *fp )
+{
+    unsigned i;
+
+    for( i = 0; i < sim->i_count; i++ )
+    {
+        const jb_strategy_t *s = &sim->s[i];
+        uint64_t i_on_time = s->i_packets - s->i_late;
+
+        fprintf( fp, "  jb:     %s:%g, late %.2f%%, underruns %u of %u frames, "
+                     "delay avg %.1f ms, max %.1f ms\n",
+                     jb_name[s->cfg.i_type], s->cfg.f_param,
+                     s->i_packets ? s->i_late * 100. / s->i_packets : 0.,
+                     s->i_underruns, s->i_frames,
+                     i_on_time ? s->delay_sum / 1000. / i_on_time : 0.,
+                     s->delay_max / 1000. );
+    }
+}
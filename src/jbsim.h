@@ -0,0 +1,74 @@
+#ifndef _JBSIM_H_
+#define _JBSIM_H_
+
+#include <stdio.h>
+
+#include "xrtp.h"
+
+/*
+ * Jitter buffer playout simulation, several strategies in one pass.
+ *
+ * A frame (RTP timestamp) is played at its media time plus a playout
+ * offset chosen by the strategy when its first packet arrives; packets
+ * arriving after that instant are late-lost, a frame with a late packet
+ * is an underrun. Strategies:
+ *  - fixed:<ms>  offset anchored on the first packet transit plus <ms>,
+ *  - jitter:<k>  minimum transit of the last 10 s plus k times the
+ *                RFC 3550 jitter, at least 25 ms (as rtp_dequeue()),
+ *  - ramjee:<k>  smoothed transit plus k times its smoothed deviation.
+ *
+ * Transit estimates are shared, each strategy only keeps its counters.
+ */
+
+#define JB_FIXED        1
+#define JB_JITTER       2
+#define JB_RAMJEE       3
+
+#define JB_SLOTS        16          /* sliding minimum of the transit */
+#define JB_WINDOW       10000000    /* us */
+
+typedef struct _jb_strategy_t
+{
+    xrtp_jb_t  cfg;
+
+    mtime_t    offset;          /* playout offset of the newest frame */
+    uint8_t    b_late;          /* newest frame already underran */
+
+    uint64_t   i_packets, i_late;
+    uint32_t   i_frames, i_underruns;
+    mtime_t    delay_sum, delay_max; /* buffering of the on time packets */
+
+}jb_strategy_t;
+
+struct _jbsim_t
+{
+    uint32_t   freq;
+    int        b_started;
+    int64_t    ts0;
+    int64_t    frame_ts;        /* newest frame, unwrapped RTP timestamp */
+    mtime_t    first_transit;
+
+    /* shared transit estimates, us */
+    mtime_t    slot_min[JB_SLOTS];
+    int64_t    i_slot;
+    double     d_hat, v_hat;
+    uint64_t   i_packets;
+
+    unsigned   i_count;
+    jb_strategy_t s[XRTP_JB_MAXIMUM];
+
+};
+
+/* "fixed:20,jitter:3,ramjee:4" appended to jb[], return -1 on error */
+int       jbsim_parse( const char *psz, xrtp_jb_t *jb, unsigned *pi_count );
+
+jbsim_t  *jbsim_create( const xrtp_jb_t *jb, unsigned i_count, uint32_t freq );
+void      jbsim_destroy( jbsim_t *sim );
+
+/* one packet in arrival order, jitter: RFC 3550 estimate in us.
+ * Packets of older frames (reordering, B frames) use the newest offset. */
+void      jbsim_update( jbsim_t *sim, int64_t ext_ts, mtime_t arrival, mtime_t jitter );
+
+void      jbsim_report( const jbsim_t *sim, FILE *fp );
+
+#endif //_JBSIM_H_
@@ -0,0 +1,255 @@
+/**
+ * @file lossmap.c
+ * @brief Loss/duplicate run-length bitmaps and burst/gap metrics (RFC 3611)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_printf.h>
+
+#include "lossmap.h"
+#include "session.h"
+
+#define BIT_GET(map, i) ((map)[(i) >> 3] & (0x80 >> ((i) & 7)))
+#define BIT_SET(map, i) ((map)[(i) >> 3] |= (0x80 >> ((i) & 7)))
+
+lossmap_t *lossmap_create( const char *psz_file )
+{
+    lossmap_t *lm = (lossmap_t *)calloc( 1, sizeof(lossmap_t) );
+    if( lm == NULL )
+        return NULL;
+
+    if( psz_file )
+    {
+        lm->fp = fopen( psz_file, "w" );
+        if( lm->fp == NULL )
+        {
+            xrtp_printf( XRTP_ERR, "lossmap_create> can't open %s.\n", psz_file );
+            free( lm );
+            return NULL;
+        }
+
+        fprintf( lm->fp, "# begin_seq end_seq loss <rle chunks> dup <rle chunks>\n" );
+    }
+
+    return lm;
+}
+
+/**
+ * Run-length encodes a bitmap as RFC 3611 chunks: run length chunks for
+ * runs of at least 15 equal bits, 15-bit vector chunks otherwise.
+ */
+static unsigned
+lossmap_rle ( const uint8_t *bits, unsigned n, uint16_t *chunk )
+{
+    unsigned i = 0, c = 0;
+
+    while( i < n )
+    {
+        unsigned b = BIT_GET( bits, i ) ? 1 : 0;
+        unsigned r = 1;
+
+        while( i + r < n && r < 0x3FFF && (BIT_GET( bits, i + r ) ? 1 : 0) == b )
+            r++;
+
+        if( r >= 15 )
+        {
+            chunk[c++] = (uint16_t)((b << 14) | r);
+            i += r;
+        }
+        else
+        {
+            uint16_t v = 0x8000;
+            unsigned k;
+
+            for( k = 0; k < 15 && i + k < n; k++ )
+            {
+                if( BIT_GET( bits, i + k ) )
+                    v |= 1 << (14 - k);
+            }
+            chunk[c++] = v;
+            i += 15;
+        }
+    }
+
+    return c;
+}
+
+static void
+lossmap_close ( lossmap_t *lm )
+{
+    if( lm->fp && lm->i_count )
+    {
+        uint16_t chunk[LOSSMAP_CHUNKS];
+        unsigned i, n;
+
+        fprintf( lm->fp, "%u %u loss", lm->begin_seq,
+                         (uint16_t)(lm->begin_seq + lm->i_count - 1) );
+
+        n = lossmap_rle( lm->recv, lm->i_count, chunk );
+        for( i = 0; i < n; i++ )
+            fprintf( lm->fp, " %04x", chunk[i] );
+
+        fprintf( lm->fp, " dup" );
+
+        n = lossmap_rle( lm->dup, lm->i_count, chunk );
+        for( i = 0; i < n; i++ )
+            fprintf( lm->fp, " %04x", chunk[i] );
+
+        fprintf( lm->fp, "\n" );
+    }
+
+    memcpy( lm->prev_recv, lm->recv, sizeof(lm->recv) );
+    lm->prev_seq  = lm->begin_seq;
+    lm->b_prev    = 1;
+
+    lm->begin_seq += LOSSMAP_INTERVAL;
+    lm->i_count    = 0;
+    memset( lm->recv, 0, sizeof(lm->recv) );
+    memset( lm->dup, 0, sizeof(lm->dup) );
+}
+
+static void
+lossmap_status ( lossmap_t *lm, int b_received )
+{
+    if( b_received )
+    {
+        BIT_SET( lm->recv, lm->i_count );
+        lm->i_received++;
+        lm->pkt++;
+    }
+    else
+    {
+        lm->i_lost++;
+
+        if( lm->pkt >= LOSSMAP_GMIN )
+        {   /* end of a gap, start of a burst */
+            if( lm->lost_count == 1 )
+                lm->c14++;
+            else
+                lm->c13++;
+            lm->lost_count = 1;
+            lm->c11 += lm->pkt;
+        }
+        else
+        {
+            lm->lost_count++;
+            if( lm->pkt == 0 )
+                lm->c33++;
+            else
+            {
+                lm->c23++;
+                lm->c22 += lm->pkt - 1;
+            }
+        }
+        lm->pkt = 0;
+    }
+
+    if( ++lm->i_count == LOSSMAP_INTERVAL )
+        lossmap_close( lm );
+}
+
+void lossmap_decoded( lossmap_t *lm, uint16_t seq, unsigned i_lost, mtime_t arrival )
+{
+    if( !lm->b_started )
+    {
+        lm->begin_seq = seq - i_lost;
+        lm->first     = arrival;
+        lm->b_started = 1;
+    }
+    lm->last = arrival;
+
+    while( i_lost-- > 0 )
+        lossmap_status( lm, 0 );
+
+    lossmap_status( lm, 1 );
+}
+
+void lossmap_duplicate( lossmap_t *lm, uint16_t seq )
+{
+    uint16_t i_off = seq - lm->begin_seq;
+
+    lm->i_duplicated++;
+
+    if( lm->b_started && i_off < LOSSMAP_INTERVAL )
+        BIT_SET( lm->dup, i_off );
+}
+
+int lossmap_late( lossmap_t *lm, uint16_t seq )
+{
+    uint16_t i_off  = seq - lm->begin_seq;
+    uint16_t i_prev = seq - lm->prev_seq;
+
+    if( i_off < lm->i_count )
+    {
+        if( BIT_GET( lm->recv, i_off ) )
+        {
+            BIT_SET( lm->dup, i_off );
+            lm->i_duplicated++;
+            return 0;
+        }
+    }
+    else if( lm->b_prev && i_prev < LOSSMAP_INTERVAL )
+    {
+        if( BIT_GET( lm->prev_recv, i_prev ) )
+        {
+            lm->i_duplicated++;
+            return 0;
+        }
+    }
+
+    /* counted lost already, received too late */
+    lm->i_late++;
+    return 1;
+}
+
+void lossmap_destroy( lossmap_t *lm )
+{
+    if( lm == NULL )
+        return;
+
+    if( lm->i_count )
+        lossmap_close( lm );
+
+    if( lm->fp )
+        fclose( lm->fp );
+
+    free( lm );
+}
+
+void lossmap_report( const lossmap_t *lm, FILE *fp )
+{
+    /* the current gap is not closed yet */
+    double c11 = lm->c11 + lm->pkt, c13 = lm->c13, c14 = lm->c14;
+    double c22 = lm->c22, c23 = lm->c23, c33 = lm->c33;
+    double c31 = c13, c32 = c23;
+    double p23, p32;
+    uint64_t i_total = lm->i_received + lm->i_lost;
+
+    fprintf( fp, "  loss:   received %llu, lost %llu (%.2f%%), duplicated %llu, late %llu\n",
+                 (unsigned long long)lm->i_received, (unsigned long long)lm->i_lost,
+                 i_total ? lm->i_lost * 100. / i_total : 0.,
+                 (unsigned long long)lm->i_duplicated, (unsigned long long)lm->i_late );
+
+    if( lm->i_lost == 0 )
+        return;
+
+    p32 = c31 + c32 + c33 > 0 ? c32 / (c31 + c32 + c33) : 0;
+    p23 = c22 + c23 < 1 ? 1 : 1 - c22 / (c22 + c23);
+
+    fprintf( fp, "  burst:  density %.1f%%, gap density %.2f%%",
+                 p23 + p32 > 0 ? 100 * p23 / (p23 + p32) : 0,
+                 c11 + c14 > 0 ? 100 * c14 / (c11 + c14) : 0 );
+
+    if( c13 > 0 && i_total > 1 )
+    {
+        double m = (double)(lm->last - lm->first) / 1000 / (i_total - 1);   /* ms */
+        double ctotal = c11 + c14 + c13 + c22 + c23 + c31 + c32 + c33;
+        double gap    = (c11 + c14 + c13) * m / c13;
+
+        fprintf( fp, ", burst %.1f ms, gap %.1f ms", ctotal * m / c13 - gap, gap );
+    }
+
+    fprintf( fp, "\n" );
+}
@@ -0,0 +1,60 @@
+#ifndef _LOSSMAP_H_
+#define _LOSSMAP_H_
+
+#include <stdio.h>
+
+#include "xrtp.h"
+
+/*
+ * Per source receive status in sequence order, in the spirit of RTCP XR
+ * (RFC 3611): loss and duplicate run-length encoded bitmaps per interval
+ * of LOSSMAP_INTERVAL sequence numbers, and the burst/gap metrics of the
+ * VoIP metrics block (Gmin = 16).
+ *
+ * Only the current and the previous intervals are kept.
+ */
+
+#define LOSSMAP_INTERVAL    1024    /* multiple of 8 */
+#define LOSSMAP_GMIN        16
+#define LOSSMAP_CHUNKS      (LOSSMAP_INTERVAL / 15 + 2)
+
+struct _lossmap_t
+{
+    FILE     *fp;               /* RLE per interval, NULL if not written */
+
+    /* current interval, 1 = received / duplicated */
+    uint16_t  begin_seq;
+    unsigned  i_count;
+    uint8_t   recv[LOSSMAP_INTERVAL / 8];
+    uint8_t   dup[LOSSMAP_INTERVAL / 8];
+
+    /* previous interval, for late duplicates */
+    uint16_t  prev_seq;
+    uint8_t   prev_recv[LOSSMAP_INTERVAL / 8];
+    int       b_prev;
+    int       b_started;
+
+    /* burst/gap state transitions (RFC 3611 A.2) */
+    uint32_t  c11, c13, c14, c22, c23, c33;
+    uint32_t  pkt;              /* received since the last loss */
+    uint32_t  lost_count;       /* losses in the current burst */
+
+    uint64_t  i_received, i_lost, i_duplicated, i_late;
+    mtime_t   first, last;      /* arrival of the first and last decoded packets */
+
+};
+
+lossmap_t *lossmap_create( const char *psz_file );
+void       lossmap_destroy( lossmap_t *lm );
+
+/* packet seq decoded after i_lost missing ones, in sequence order */
+void lossmap_decoded( lossmap_t *lm, uint16_t seq, unsigned i_lost, mtime_t arrival );
+/* packet seq arrived again before it was decoded */
+void lossmap_duplicate( lossmap_t *lm, uint16_t seq );
+/* packet seq arrived after it was decoded or given up,
+ * return 1 if it was given up, 0 if it is a duplicate */
+int  lossmap_late( lossmap_t *lm, uint16_t seq );
+
+void lossmap_report( const lossmap_t *lm, FILE *fp );
+
+#endif //_LOSSMAP_H_
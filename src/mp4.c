@@ -0,0 +1,642 @@
+/**
+ * @file mp4.c
+ * @brief Streaming fragmented MP4 of the extracted H.264/H.265 streams
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_printf.h>
+#include <xrtp_bytes.h>
+
+#include "mp4.h"
+#include "annexb.h"
+#include "h264.h"
+#include "h265.h"
+
+#define MP4_PARAM_VPS       0
+#define MP4_PARAM_SPS       1
+#define MP4_PARAM_PPS       2
+
+/* trun: data offset, duration, size, flags, composition offset */
+#define MP4_TRUN_FLAGS      0x000F01
+#define MP4_SAMPLE_SYNC     0x02000000  /* depends on no other */
+#define MP4_SAMPLE_NON_SYNC 0x01010000  /* depends on others, not a sync sample */
+
+/*****************************************************************************
+ * box writing
+ *****************************************************************************/
+static void
+mp4_need ( mp4_buffer_t *b, size_t i_size )
+{
+    if( b->i_size + i_size > b->i_allocated && !b->b_error )
+    {
+        size_t   i_allocated = b->i_allocated ? 2 * b->i_allocated : 4096;
+        uint8_t *p;
+
+        while( i_allocated < b->i_size + i_size )
+            i_allocated *= 2;
+
+        p = (uint8_t *)realloc( b->p, i_allocated );
+        if( p == NULL )
+            b->b_error = 1;
+        else
+        {
+            b->p           = p;
+            b->i_allocated = i_allocated;
+        }
+    }
+}
+
+static void
+mp4_bytes ( mp4_buffer_t *b, const void *p, size_t i_size )
+{
+    mp4_need( b, i_size );
+    if( b->b_error )
+        return;
+    memcpy( b->p + b->i_size, p, i_size );
+    b->i_size += i_size;
+}
+
+static void
+mp4_u8 ( mp4_buffer_t *b, uint8_t i )
+{
+    mp4_bytes( b, &i, 1 );
+}
+
+static void
+mp4_u16 ( mp4_buffer_t *b, uint16_t i )
+{
+    uint8_t p[2];
+
+    SetWBE( p, i );
+    mp4_bytes( b, p, 2 );
+}
+
+static void
+mp4_u32 ( mp4_buffer_t *b, uint32_t i )
+{
+    uint8_t p[4];
+
+    SetDWBE( p, i );
+    mp4_bytes( b, p, 4 );
+}
+
+static void
+mp4_u64 ( mp4_buffer_t *b, uint64_t i )
+{
+    uint8_t p[8];
+
+    SetQWBE( p, i );
+    mp4_bytes( b, p, 8 );
+}
+
+static void
+mp4_zeros ( mp4_buffer_t *b, size_t i_size )
+{
+    mp4_need( b, i_size );
+    if( b->b_error )
+        return;
+    memset( b->p + b->i_size, 0, i_size );
+    b->i_size += i_size;
+}
+
+static void
+mp4_box ( mp4_buffer_t *b, const char *psz_type )
+{
+    b->box[b->i_box++] = b->i_size;
+    mp4_u32( b, 0 );
+    mp4_bytes( b, psz_type, 4 );
+}
+
+static void
+mp4_full_box ( mp4_buffer_t *b, const char *psz_type, uint8_t i_version, uint32_t i_flags )
+{
+    mp4_box( b, psz_type );
+    mp4_u32( b, ((uint32_t)i_version << 24) | i_flags );
+}
+
+static void
+mp4_box_end ( mp4_buffer_t *b )
+{
+    size_t i_start = b->box[--b->i_box];
+
+    if( !b->b_error )
+        SetDWBE( b->p + i_start, (uint32_t)(b->i_size - i_start) );
+}
+
+static void
+mp4_matrix ( mp4_buffer_t *b )
+{
+    static const uint32_t unity[9] =
+        { 0x10000, 0, 0, 0, 0x10000, 0, 0, 0, 0x40000000 };
+    int i;
+
+    for( i = 0; i < 9; i++ )
+        mp4_u32( b, unity[i] );
+}
+
+/*****************************************************************************
+ * decoder configurations
+ *****************************************************************************/
+static int
+mp4_avcc ( mp4_t *m, mp4_buffer_t *b )
+{
+    const uint8_t *sps = m->param[MP4_PARAM_SPS];
+    const uint8_t *pps = m->param[MP4_PARAM_PPS];
+    h264_sps_t parsed;
+
+    if( m->i_param[MP4_PARAM_SPS] < 4
+     || h264_parse_sps( sps + 1, m->i_param[MP4_PARAM_SPS] - 1, &parsed ) < 0 )
+        return -1;
+
+    mp4_box( b, "avcC" );
+    mp4_u8( b, 1 );
+    mp4_bytes( b, sps + 1, 3 );                         /* profile, compatibility, level */
+    mp4_u8( b, 0xFC | 3 );                              /* 4 bytes lengths */
+    mp4_u8( b, 0xE0 | 1 );
+    mp4_u16( b, (uint16_t)m->i_param[MP4_PARAM_SPS] );
+    mp4_bytes( b, sps, m->i_param[MP4_PARAM_SPS] );
+    mp4_u8( b, 1 );
+    mp4_u16( b, (uint16_t)m->i_param[MP4_PARAM_PPS] );
+    mp4_bytes( b, pps, m->i_param[MP4_PARAM_PPS] );
+    if( parsed.b_chroma_format )
+    {
+        mp4_u8( b, 0xFC | (parsed.i_chroma_format & 3) );
+        mp4_u8( b, 0xF8 | (parsed.i_bit_depth_luma & 7) );
+        mp4_u8( b, 0xF8 | (parsed.i_bit_depth_chroma & 7) );
+        mp4_u8( b, 0 );
+    }
+    mp4_box_end( b );
+
+    return 0;
+}
+
+static int
+mp4_hvcc ( mp4_t *m, mp4_buffer_t *b )
+{
+    h265_sps_t parsed;
+    unsigned i;
+
+    if( m->i_param[MP4_PARAM_SPS] < 16
+     || h265_parse_sps( m->param[MP4_PARAM_SPS] + 2, m->i_param[MP4_PARAM_SPS] - 2, &parsed ) < 0 )
+        return -1;
+
+    mp4_box( b, "hvcC" );
+    mp4_u8( b, 1 );
+    /* profile, tier, flags, level */
+    mp4_bytes( b, parsed.general_ptl, sizeof(parsed.general_ptl) );
+    mp4_u16( b, 0xF000 );                               /* min_spatial_segmentation */
+    mp4_u8( b, 0xFC );                                  /* parallelism */
+    mp4_u8( b, 0xFC | (parsed.i_chroma_format & 3) );
+    mp4_u8( b, 0xF8 | (parsed.i_bit_depth_luma & 7) );
+    mp4_u8( b, 0xF8 | (parsed.i_bit_depth_chroma & 7) );
+    mp4_u16( b, 0 );                                    /* avgFrameRate */
+    mp4_u8( b, (uint8_t)((parsed.i_max_sub_layers << 3) | (parsed.b_temporal_id_nesting << 2) | 3) );
+    mp4_u8( b, 3 );
+    for( i = MP4_PARAM_VPS; i <= MP4_PARAM_PPS; i++ )
+    {
+        /* not complete: the samples carry parameter sets too */
+        mp4_u8( b, (uint8_t)(H265_NAL_VPS + i) );
+        mp4_u16( b, 1 );
+        mp4_u16( b, (uint16_t)m->i_param[i] );
+        mp4_bytes( b, m->param[i], m->i_param[i] );
+    }
+    mp4_box_end( b );
+
+    return 0;
+}
+
+/*****************************************************************************
+ * init segment and fragments
+ *****************************************************************************/
+static int
+mp4_init ( mp4_t *m )
+{
+    mp4_buffer_t b;
+    int i_ret;
+
+    memset( &b, 0, sizeof(b) );
+
+    mp4_box( &b, "ftyp" );
+    mp4_bytes( &b, "isom", 4 );
+    mp4_u32( &b, 0x200 );
+    mp4_bytes( &b, "isomiso6mp41", 12 );
+    mp4_box_end( &b );
+
+    mp4_box( &b, "moov" );
+
+    mp4_full_box( &b, "mvhd", 0, 0 );
+    mp4_u32( &b, 0 );                                   /* creation */
+    mp4_u32( &b, 0 );                                   /* modification */
+    mp4_u32( &b, 1000 );
+    mp4_u32( &b, 0 );                                   /* duration: fragments */
+    mp4_u32( &b, 0x00010000 );                          /* rate */
+    mp4_u16( &b, 0x0100 );                              /* volume */
+    mp4_zeros( &b, 10 );
+    mp4_matrix( &b );
+    mp4_zeros( &b, 24 );
+    mp4_u32( &b, 2 );                                   /* next track */
+    mp4_box_end( &b );
+
+    mp4_box( &b, "trak" );
+
+    mp4_full_box( &b, "tkhd", 0, 3 );                   /* enabled, in movie */
+    mp4_u32( &b, 0 );
+    mp4_u32( &b, 0 );
+    mp4_u32( &b, 1 );                                   /* track */
+    mp4_u32( &b, 0 );
+    mp4_u32( &b, 0 );                                   /* duration */
+    mp4_zeros( &b, 8 );
+    mp4_u16( &b, 0 );                                   /* layer */
+    mp4_u16( &b, 0 );                                   /* alternate group */
+    mp4_u16( &b, 0 );                                   /* volume */
+    mp4_u16( &b, 0 );
+    mp4_matrix( &b );
+    mp4_u32( &b, (uint32_t)m->i_width << 16 );
+    mp4_u32( &b, (uint32_t)m->i_height << 16 );
+    mp4_box_end( &b );
+
+    mp4_box( &b, "mdia" );
+
+    mp4_full_box( &b, "mdhd", 0, 0 );
+    mp4_u32( &b, 0 );
+    mp4_u32( &b, 0 );
+    mp4_u32( &b, m->i_timescale );
+    mp4_u32( &b, 0 );
+    mp4_u16( &b, 0x55C4 );                              /* und */
+    mp4_u16( &b, 0 );
+    mp4_box_end( &b );
+
+    mp4_full_box( &b, "hdlr", 0, 0 );
+    mp4_u32( &b, 0 );
+    mp4_bytes( &b, "vide", 4 );
+    mp4_zeros( &b, 12 );
+    mp4_bytes( &b, "VideoHandler", 13 );
+    mp4_box_end( &b );
+
+    mp4_box( &b, "minf" );
+
+    mp4_full_box( &b, "vmhd", 0, 1 );
+    mp4_zeros( &b, 8 );
+    mp4_box_end( &b );
+
+    mp4_box( &b, "dinf" );
+    mp4_full_box( &b, "dref", 0, 0 );
+    mp4_u32( &b, 1 );
+    mp4_full_box( &b, "url ", 0, 1 );                   /* in this file */
+    mp4_box_end( &b );
+    mp4_box_end( &b );
+    mp4_box_end( &b );
+
+    mp4_box( &b, "stbl" );
+
+    mp4_full_box( &b, "stsd", 0, 0 );
+    mp4_u32( &b, 1 );
+    mp4_box( &b, m->i_codec == MP4_CODEC_H264 ? "avc3" : "hev1" );
+    mp4_zeros( &b, 6 );
+    mp4_u16( &b, 1 );                                   /* data reference */
+    mp4_zeros( &b, 16 );
+    mp4_u16( &b, (uint16_t)m->i_width );
+    mp4_u16( &b, (uint16_t)m->i_height );
+    mp4_u32( &b, 0x00480000 );                          /* 72 dpi */
+    mp4_u32( &b, 0x00480000 );
+    mp4_u32( &b, 0 );
+    mp4_u16( &b, 1 );                                   /* frame count */
+    mp4_zeros( &b, 32 );                                /* compressor name */
+    mp4_u16( &b, 0x0018 );                              /* depth */
+    mp4_u16( &b, 0xFFFF );
+    i_ret = m->i_codec == MP4_CODEC_H264 ? mp4_avcc( m, &b ) : mp4_hvcc( m, &b );
+    mp4_box_end( &b );
+    mp4_box_end( &b );
+
+    /* the samples are in the fragments */
+    mp4_full_box( &b, "stts", 0, 0 );
+    mp4_u32( &b, 0 );
+    mp4_box_end( &b );
+    mp4_full_box( &b, "stsc", 0, 0 );
+    mp4_u32( &b, 0 );
+    mp4_box_end( &b );
+    mp4_full_box( &b, "stsz", 0, 0 );
+    mp4_u32( &b, 0 );
+    mp4_u32( &b, 0 );
+    mp4_box_end( &b );
+    mp4_full_box( &b, "stco", 0, 0 );
+    mp4_u32( &b, 0 );
+    mp4_box_end( &b );
+
+    mp4_box_end( &b );                                  /* stbl */
+    mp4_box_end( &b );                                  /* minf */
+    mp4_box_end( &b );                                  /* mdia */
+    mp4_box_end( &b );                                  /* trak */
+
+    mp4_box( &b, "mvex" );
+    mp4_full_box( &b, "trex", 0, 0 );
+    mp4_u32( &b, 1 );                                   /* track */
+    mp4_u32( &b, 1 );                                   /* sample description */
+    mp4_zeros( &b, 12 );
+    mp4_box_end( &b );
+    mp4_box_end( &b );
+
+    mp4_box_end( &b );                                  /* moov */
+
+    if( i_ret == 0 && !b.b_error )
+        i_ret = output_write( m->out, b.p, b.i_size );
+    else
+        i_ret = -1;
+
+    free( b.p );
+
+    return i_ret;
+}
+
+static int pts_cmp( const void *a, const void *b )
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Writes the samples gathered as a moof/mdat.
+ */
+static int
+mp4_fragment ( mp4_t *m )
+{
+    mp4_buffer_t *b = &m->moof;
+    int64_t  sorted[MP4_FRAGMENT_MAXIMUM + MP4_REORDER];
+    int64_t  i_dts;
+    uint8_t  header[8];
+    output_iov_t iov[3];
+    size_t   i_offset;
+    unsigned i;
+
+    if( m->i_samples == 0 )
+        return 0;
+
+    /* decode times: the sorted presentation times */
+    for( i = 0; i < m->i_samples; i++ )
+        sorted[i] = m->samples[i].i_pts;
+    qsort( sorted, m->i_samples, sizeof(int64_t), pts_cmp );
+
+    if( m->i_sequence == 0 )
+        m->i_origin = sorted[0];
+
+    /* frames missing: forward; the last duration too long: from there */
+    i_dts = sorted[0] - m->i_origin;
+    if( i_dts < m->i_dts )
+        i_dts = m->i_dts;
+
+    b->i_size = 0;
+    b->i_box  = 0;
+
+    mp4_box( b, "moof" );
+
+    mp4_full_box( b, "mfhd", 0, 0 );
+    mp4_u32( b, ++m->i_sequence );
+    mp4_box_end( b );
+
+    mp4_box( b, "traf" );
+
+    mp4_full_box( b, "tfhd", 0, 0x020000 );             /* default base is moof */
+    mp4_u32( b, 1 );
+    mp4_box_end( b );
+
+    mp4_full_box( b, "tfdt", 1, 0 );
+    mp4_u64( b, (uint64_t)i_dts );
+    mp4_box_end( b );
+
+    mp4_full_box( b, "trun", 1, MP4_TRUN_FLAGS );
+    mp4_u32( b, m->i_samples );
+    i_offset = b->i_size;
+    mp4_u32( b, 0 );                                    /* data offset */
+
+    for( i = 0; i < m->i_samples; i++ )
+    {
+        const mp4_sample_t *s = &m->samples[i];
+        int64_t i_next = i_dts + m->i_duration;
+
+        if( i + 1 < m->i_samples )
+        {
+            if( sorted[i + 1] > sorted[i] )
+                m->i_duration = (uint32_t)(sorted[i + 1] - sorted[i]);
+            i_next = sorted[i + 1] - m->i_origin;
+            if( i_next < i_dts )
+                i_next = i_dts;
+        }
+
+        mp4_u32( b, (uint32_t)(i_next - i_dts) );
+        mp4_u32( b, s->i_size );
+        mp4_u32( b, s->b_key ? MP4_SAMPLE_SYNC : MP4_SAMPLE_NON_SYNC );
+        mp4_u32( b, (uint32_t)(int32_t)(s->i_pts - m->i_origin - i_dts) );
+
+        i_dts = i_next;
+    }
+    mp4_box_end( b );
+
+    mp4_box_end( b );                                   /* traf */
+    mp4_box_end( b );                                   /* moof */
+
+    if( b->b_error || m->mdat.b_error )
+        return -1;
+
+    SetDWBE( b->p + i_offset, (uint32_t)(b->i_size + 8) );
+
+    SetDWBE( header, (uint32_t)(8 + m->mdat.i_size) );
+    memcpy( header + 4, "mdat", 4 );
+
+    iov[0].p      = b->p;
+    iov[0].i_size = b->i_size;
+    iov[1].p      = header;
+    iov[1].i_size = 8;
+    iov[2].p      = m->mdat.p;
+    iov[2].i_size = m->mdat.i_size;
+
+    m->i_dts       = i_dts;
+    m->i_samples   = 0;
+    m->mdat.i_size = 0;
+
+    return output_writev( m->out, iov, 3 );
+}
+
+/*****************************************************************************
+ * API
+ *****************************************************************************/
+mp4_t *mp4_open( const char *psz_file, int i_codec, uint32_t i_timescale,
+                 unsigned i_fragment, uint32_t i_flags, writer_t *writer )
+{
+    mp4_t *m = (mp4_t *)calloc( 1, sizeof(mp4_t) );
+
+    if( m == NULL )
+        return NULL;
+
+    if( i_fragment == 0 )
+        i_fragment = MP4_FRAGMENT;
+    if( i_fragment > MP4_FRAGMENT_MAXIMUM )
+        i_fragment = MP4_FRAGMENT_MAXIMUM;
+
+    m->i_codec     = i_codec;
+    m->i_timescale = i_timescale ? i_timescale : 90000;
+    m->i_fragment  = i_fragment;
+    m->i_duration  = m->i_timescale / 30;
+
+    m->samples = (mp4_sample_t *)malloc( (i_fragment + MP4_REORDER) * sizeof(mp4_sample_t) );
+    if( m->samples == NULL )
+        goto err_mp4_open;
+
+    m->out = output_open( psz_file, i_flags, writer );
+    if( m->out == NULL )
+        goto err_mp4_open;
+
+    return m;
+
+err_mp4_open:
+
+    free( m->samples );
+    free( m );
+
+    return NULL;
+}
+
+void mp4_close( mp4_t *m )
+{
+    int i;
+
+    if( m == NULL )
+        return;
+
+    if( m->b_init )
+        mp4_fragment( m );
+    else
+        xrtp_printf( XRTP_ERR, "mp4_close> no keyframe with its parameter sets, empty file.\n" );
+
+    if( m->i_dropped )
+        xrtp_printf( XRTP_DBG, "mp4_close> %llu frames, %llu dropped before the first keyframe.\n",
+                               (unsigned long long)m->i_frames, (unsigned long long)m->i_dropped );
+
+    output_close( m->out );
+
+    for( i = 0; i < 3; i++ )
+        free( m->param[i] );
+    free( m->samples );
+    free( m->mdat.p );
+    free( m->moof.p );
+    free( m );
+}
+
+/* keeps a copy of a parameter set */
+static void
+mp4_param ( mp4_t *m, int i_param, const uint8_t *p, int i_size )
+{
+    uint8_t *p_copy;
+
+    if( i_size == m->i_param[i_param] && !memcmp( p, m->param[i_param], i_size ) )
+        return;
+
+    p_copy = (uint8_t *)realloc( m->param[i_param], i_size );
+    if( p_copy == NULL )
+        return;
+
+    memcpy( p_copy, p, i_size );
+    m->param[i_param]   = p_copy;
+    m->i_param[i_param] = i_size;
+}
+
+int mp4_frame( mp4_t *m, const frame_t *f )
+{
+    const uint8_t *p   = f->p_buffer;
+    const uint8_t *end = f->p_buffer + f->i_buffer;
+    size_t i_start;
+    mp4_sample_t *s;
+
+    if( m->i_frames + m->i_dropped == 0 )
+        m->i_ext_ts = f->i_rtp_timestamp;
+    else
+        m->i_ext_ts += (int32_t)(f->i_rtp_timestamp - m->i_last_ts);
+    m->i_last_ts = f->i_rtp_timestamp;
+
+    /* a frame later than the fragment: its B frames are in */
+    if( m->i_samples >= m->i_fragment
+     && (m->i_ext_ts > m->i_last_pts || m->i_samples >= m->i_fragment + MP4_REORDER)
+     && mp4_fragment( m ) < 0 )
+        return -1;
+    i_start = m->mdat.i_size;
+
+    /* Annex B to 4 bytes lengths, the parameter sets kept */
+    for( p = annexb_find_startcode( p, end ); p < end; )
+    {
+        const uint8_t *nal  = p + 3;
+        const uint8_t *next = annexb_find_startcode( nal, end );
+        const uint8_t *nal_end = next;
+        int i_type;
+
+        /* trailing zeros, and the first byte of a 4 bytes start code */
+        while( nal_end > nal && nal_end[-1] == 0 )
+            nal_end--;
+        p = next;
+
+        if( nal_end <= nal )
+            continue;
+
+        if( m->i_codec == MP4_CODEC_H264 )
+        {
+            i_type = nal[0] & 0x1F;
+            if( i_type == H264_NAL_AUD )
+                continue;
+            if( i_type == H264_NAL_SPS || i_type == H264_NAL_PPS )
+                mp4_param( m, i_type == H264_NAL_SPS ? MP4_PARAM_SPS : MP4_PARAM_PPS,
+                           nal, (int)(nal_end - nal) );
+        }
+        else
+        {
+            i_type = (nal[0] >> 1) & 0x3F;
+            if( i_type == H265_NAL_AUD )
+                continue;
+            if( i_type >= H265_NAL_VPS && i_type <= H265_NAL_PPS )
+                mp4_param( m, i_type - H265_NAL_VPS, nal, (int)(nal_end - nal) );
+        }
+
+        mp4_u32( &m->mdat, (uint32_t)(nal_end - nal) );
+        mp4_bytes( &m->mdat, nal, nal_end - nal );
+    }
+
+    if( !m->b_init )
+    {
+        int b_ready = FRAME_IS_KEY( f ) && m->param[MP4_PARAM_SPS] && m->param[MP4_PARAM_PPS]
+                   && (m->i_codec == MP4_CODEC_H264 || m->param[MP4_PARAM_VPS]);
+
+        if( b_ready )
+        {
+            m->i_width  = f->i_width > 0 ? f->i_width : 0;
+            m->i_height = f->i_height > 0 ? f->i_height : 0;
+            if( mp4_init( m ) < 0 )
+                b_ready = 0;
+            else
+                m->b_init = 1;
+        }
+        if( !b_ready )
+        {
+            m->mdat.i_size = i_start;
+            m->i_dropped++;
+            return 0;
+        }
+    }
+
+    if( m->mdat.b_error )
+        return -1;
+
+    /* no start code: the rest of a frame already out */
+    if( m->mdat.i_size == i_start )
+        return 0;
+
+    if( m->i_samples == 0 || m->i_ext_ts > m->i_last_pts )
+        m->i_last_pts = m->i_ext_ts;
+
+    s = &m->samples[m->i_samples++];
+    s->i_pts  = m->i_ext_ts;
+    s->i_size = (uint32_t)(m->mdat.i_size - i_start);
+    s->b_key  = FRAME_IS_KEY( f );
+    m->i_frames++;
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+#ifndef _MP4_H_
+#define _MP4_H_
+
+#include <datatype.h>
+
+#include "xrtp.h"
+#include "frame.h"
+#include "output.h"
+
+/*
+ * Fragmented MP4 (ISO/IEC 14496-12 and -15) of an H.264/H.265 stream,
+ * written as the frames come: ftyp and moov when the parameter sets and
+ * a keyframe are there (the frames before are dropped), then one
+ * moof/mdat per i_fragment frames or a few more: a fragment ends before
+ * a frame later than all of its frames, so that the B frames stay with
+ * their reference. Only a fragment is ever held, so the memory does not
+ * depend on the length of the capture.
+ *
+ * The sample entry is avc3/hev1: avcC/hvcC are built from the latest
+ * parameter sets, which stay in the samples too, so a change of
+ * parameters midway still decodes. Timing comes from the RTP timestamps
+ * (the track timescale is the RTP clock): the presentation times are
+ * the timestamps, the decode times their sorted values in the fragment,
+ * with signed composition offsets (trun version 1) for the B frames. The
+ * last sample of a fragment lasts as the one before.
+ */
+
+#define MP4_CODEC_H264      1
+#define MP4_CODEC_H265      2
+
+#define MP4_FRAGMENT        30      /* frames per moof/mdat, default */
+#define MP4_FRAGMENT_MAXIMUM 1024
+#define MP4_REORDER         16      /* frames a fragment may run over */
+
+typedef struct _mp4_buffer_t
+{
+    uint8_t  *p;
+    size_t    i_size;
+    size_t    i_allocated;
+    size_t    box[8];           /* offsets of the open boxes */
+    int       i_box;
+    int       b_error;          /* out of memory */
+
+}mp4_buffer_t;
+
+typedef struct _mp4_sample_t
+{
+    int64_t   i_pts;            /* unwrapped RTP timestamp */
+    uint32_t  i_size;
+    uint8_t   b_key;
+
+}mp4_sample_t;
+
+typedef struct _mp4_t
+{
+    output_t *out;
+    int       i_codec;
+    uint32_t  i_timescale;
+    unsigned  i_fragment;
+
+    /* latest VPS (H.265), SPS, PPS, with their NAL header */
+    uint8_t  *param[3];
+    int       i_param[3];
+
+    uint8_t   b_init;           /* moov written */
+    int       i_width, i_height;
+
+    /* fragment being built */
+    mp4_sample_t *samples;
+    unsigned  i_samples;
+    int64_t   i_last_pts;       /* latest of the fragment */
+    mp4_buffer_t mdat;
+    mp4_buffer_t moof;
+
+    uint32_t  i_sequence;
+    int64_t   i_dts;            /* decode time of the next fragment */
+    int64_t   i_origin;         /* pts of decode time 0 */
+    uint32_t  i_duration;       /* of the last sample, the last guess */
+
+    uint32_t  i_last_ts;
+    int64_t   i_ext_ts;
+
+    uint64_t  i_frames;
+    uint64_t  i_dropped;        /* before the first keyframe */
+
+}mp4_t;
+
+/* i_timescale: RTP clock, i_flags/writer: see output_open() */
+mp4_t *mp4_open( const char *psz_file, int i_codec, uint32_t i_timescale,
+                 unsigned i_fragment, uint32_t i_flags, writer_t *writer );
+/* writes the last fragment */
+void   mp4_close( mp4_t *m );
+
+/* an access unit in Annex B */
+int    mp4_frame( mp4_t *m, const frame_t *f );
+
+#endif //_MP4_H_
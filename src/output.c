@@ -0,0 +1,700 @@
+/**
+ * @file output.c
+ * @brief Buffered, gathered output of the extracted streams
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE            /* O_DIRECT, fallocate() */
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#ifdef _WIN32
+# include <io.h>
+# include <malloc.h>
+#else
+# include <unistd.h>
+# include <sys/uio.h>
+# include <sys/resource.h>
+#endif
+
+#include <xrtp_printf.h>
+#include <xrtp_thread.h>
+
+#include "output.h"
+#include "writer.h"
+
+#define OUTPUT_IOV_MAXIMUM  16
+
+/* descriptors of all the outputs, whatever thread writes them */
+static struct
+{
+    xrtp_mutex_t lock;
+    output_t    *p_first, *p_last;  /* LRU */
+    unsigned     i_open;
+    unsigned     i_limit;
+    size_t       i_memory;      /* output buffers, up to OUTPUT_MEMORY */
+
+}files;
+
+int output_parse( const char *psz, uint32_t *pi_flags, unsigned *pi_files )
+{
+    while( *psz )
+    {
+        size_t i_len = strcspn( psz, "," );
+
+        if( i_len == 6 && !strncmp( psz, "direct", 6 ) )
+            *pi_flags |= OUTPUT_DIRECT;
+        else if( i_len == 8 && !strncmp( psz, "prealloc", 8 ) )
+            *pi_flags |= OUTPUT_PREALLOCATE;
+        else if( i_len == 5 && !strncmp( psz, "async", 5 ) )
+            *pi_flags = (*pi_flags & ~OUTPUT_URING) | OUTPUT_ASYNC;
+        else if( i_len == 5 && !strncmp( psz, "uring", 5 ) )
+            *pi_flags = (*pi_flags & ~OUTPUT_ASYNC) | OUTPUT_URING;
+        else if( i_len > 6 && !strncmp( psz, "files=", 6 ) )
+        {
+            char *end;
+            unsigned long i_files = strtoul( psz + 6, &end, 10 );
+
+            if( end != psz + i_len || i_files < 1 )
+                return -1;
+            *pi_files = (unsigned)i_files;
+        }
+        else
+            return -1;
+
+        psz += i_len;
+        if( *psz == ',' )
+            psz++;
+    }
+
+    return 0;
+}
+
+static void *
+output_alloc ( size_t i_size )
+{
+#ifdef _WIN32
+    return _aligned_malloc( i_size, OUTPUT_ALIGN );
+#else
+    void *p;
+
+    return posix_memalign( &p, OUTPUT_ALIGN, i_size ) ? NULL : p;
+#endif
+}
+
+static void
+output_free ( void *p )
+{
+#ifdef _WIN32
+    _aligned_free( p );
+#else
+    free( p );
+#endif
+}
+
+unsigned output_init( unsigned i_files )
+{
+    unsigned i_max;
+
+    xrtp_mutex_init( &files.lock );
+
+#ifdef _WIN32
+    i_max = 2048;       /* CRT descriptors */
+#else
+    {
+        struct rlimit rl;
+
+        if( getrlimit( RLIMIT_NOFILE, &rl ) < 0 )
+            rl.rlim_cur = rl.rlim_max = 1024;
+        else if( rl.rlim_cur < rl.rlim_max )
+        {
+            /* up to what is allowed without privileges */
+            rlim_t i_soft = rl.rlim_cur;
+
+            rl.rlim_cur = rl.rlim_max;
+            if( setrlimit( RLIMIT_NOFILE, &rl ) < 0 )
+                rl.rlim_cur = i_soft;
+        }
+        i_max = rl.rlim_cur > UINT32_MAX ? UINT32_MAX : (unsigned)rl.rlim_cur;
+    }
+#endif
+
+    i_max = i_max > 2 * OUTPUT_FD_RESERVE ? i_max - OUTPUT_FD_RESERVE : OUTPUT_FD_RESERVE;
+
+    files.i_limit = i_files > 0 && i_files < i_max ? i_files : i_max;
+
+    return files.i_limit;
+}
+
+/**
+ * Opens the file of the output: created, or reopened at its end.
+ */
+static int
+output_fd_open ( output_t *o, int b_create )
+{
+#ifdef _WIN32
+    int i_mode = O_WRONLY | O_BINARY | (b_create ? O_CREAT | O_TRUNC : 0);
+
+    o->fd = _open( o->psz_file, i_mode, 0644 );
+    if( o->fd >= 0 && !b_create && _lseeki64( o->fd, o->i_written, SEEK_SET ) < 0 )
+    {
+        _close( o->fd );
+        o->fd = -1;
+    }
+#else
+    int i_mode = O_WRONLY | (b_create ? O_CREAT | O_TRUNC : 0);
+
+# ifdef __linux__
+    if( o->i_flags & OUTPUT_DIRECT )
+    {
+        o->fd = open( o->psz_file, i_mode | O_DIRECT, 0644 );
+        if( o->fd < 0 && errno == EINVAL )
+        {
+            /* tmpfs and a few others */
+            xrtp_printf( XRTP_DBG, "output_open> no O_DIRECT for %s.\n", o->psz_file );
+            o->i_flags &= ~OUTPUT_DIRECT;
+        }
+    }
+# endif
+    if( o->fd < 0 )
+        o->fd = open( o->psz_file, i_mode, 0644 );
+    /* the file ends at i_written: nothing is written past it but by
+     * the writer, which has nothing in flight for an evicted output */
+    if( o->fd >= 0 && !b_create && lseek( o->fd, (off_t)o->i_written, SEEK_SET ) < 0 )
+    {
+        close( o->fd );
+        o->fd = -1;
+    }
+#endif
+
+    return o->fd < 0 ? -1 : 0;
+}
+
+static void
+output_fd_close ( output_t *o )
+{
+#ifdef _WIN32
+    _close( o->fd );
+#else
+    close( o->fd );
+#endif
+    o->fd = -1;
+}
+
+static void
+output_lru_remove ( output_t *o )
+{
+    if( o->p_lru_prev )
+        o->p_lru_prev->p_lru_next = o->p_lru_next;
+    else
+        files.p_first = o->p_lru_next;
+    if( o->p_lru_next )
+        o->p_lru_next->p_lru_prev = o->p_lru_prev;
+    else
+        files.p_last = o->p_lru_prev;
+
+    o->p_lru_prev = o->p_lru_next = NULL;
+}
+
+static void
+output_lru_push ( output_t *o )
+{
+    o->p_lru_prev = NULL;
+    o->p_lru_next = files.p_first;
+    if( files.p_first )
+        files.p_first->p_lru_prev = o;
+    else
+        files.p_last = o;
+    files.p_first = o;
+}
+
+/**
+ * Gets the descriptor of the output, opening it again if it was evicted,
+ * and keeps it until output_release().
+ */
+static int
+output_acquire ( output_t *o, int b_create )
+{
+    int i_ret = 0;
+
+    xrtp_mutex_lock( &files.lock );
+
+    if( o->fd >= 0 )
+    {
+        output_lru_remove( o );
+        output_lru_push( o );
+    }
+    else
+    {
+        output_t *victim = files.p_last;
+
+        /* the least recently written, not in use nor being written:
+         * an output of another thread may be anywhere */
+        while( victim && files.i_open >= files.i_limit )
+        {
+            output_t *prev = victim->p_lru_prev;
+
+            if( victim->i_busy == 0 && xrtp_atomic_load( &victim->i_pending ) == 0 )
+            {
+                output_lru_remove( victim );
+                output_fd_close( victim );
+                files.i_open--;
+            }
+            victim = prev;
+        }
+
+        if( output_fd_open( o, b_create ) < 0 )
+        {
+            xrtp_printf( XRTP_ERR, "output_acquire> can't open %s (%s).\n",
+                                   o->psz_file, strerror( errno ) );
+            i_ret = -1;
+        }
+        else
+        {
+            output_lru_push( o );
+            files.i_open++;
+        }
+    }
+
+    if( i_ret == 0 )
+        o->i_busy++;
+
+    xrtp_mutex_unlock( &files.lock );
+
+    return i_ret;
+}
+
+static void
+output_release ( output_t *o )
+{
+    xrtp_mutex_lock( &files.lock );
+    o->i_busy--;
+    xrtp_mutex_unlock( &files.lock );
+}
+
+output_t *output_open( const char *psz_file, uint32_t i_flags, writer_t *writer )
+{
+    output_t *o = (output_t *)calloc( 1, sizeof(output_t) );
+
+    if( o == NULL )
+        return NULL;
+
+    o->fd = -1;
+
+#ifdef _WIN32
+    i_flags &= OUTPUT_SMALL;
+#elif !defined(__linux__)
+    i_flags &= ~(OUTPUT_DIRECT | OUTPUT_PREALLOCATE);
+#endif
+    o->i_flags  = i_flags;
+    o->psz_file = strdup( psz_file );
+    o->p_buffer = (uint8_t *)output_alloc( OUTPUT_BUFFER_MINIMUM );
+    o->i_size   = OUTPUT_BUFFER_MINIMUM;
+    if( o->psz_file == NULL || o->p_buffer == NULL )
+        goto err_output_open;
+
+    /* created now: a file that can't be is reported at once */
+    if( output_acquire( o, 1 ) < 0 )
+        goto err_output_open;
+    output_release( o );
+
+    xrtp_mutex_lock( &files.lock );
+    files.i_memory += o->i_size;
+    xrtp_mutex_unlock( &files.lock );
+
+    if( writer )
+    {
+        o->writer = writer;
+        o->p_next = writer->outputs;
+        writer->outputs = o;
+    }
+
+    return o;
+
+err_output_open:
+
+    output_free( o->p_buffer );
+    free( o->psz_file );
+    free( o );
+
+    return NULL;
+}
+
+/**
+ * Preallocates ahead of i_total more bytes.
+ */
+static void
+output_reserve ( output_t *o, int64_t i_total )
+{
+#ifdef __linux__
+    if( (o->i_flags & OUTPUT_PREALLOCATE)
+     && o->i_written + i_total > o->i_allocated )
+    {
+        int64_t i_size = o->i_written + i_total + OUTPUT_PREALLOC - o->i_allocated;
+
+        /* keep the file size: nothing to truncate at the end */
+        if( fallocate( o->fd, FALLOC_FL_KEEP_SIZE, o->i_allocated, i_size ) == 0 )
+            o->i_allocated += i_size;
+        else
+            o->i_flags &= ~OUTPUT_PREALLOCATE;
+    }
+#else
+    (void)o;
+    (void)i_total;
+#endif
+}
+
+/**
+ * Writes all the pieces, at the end of the file.
+ */
+static int
+output_send ( output_t *o, const output_iov_t *piece, int i_count )
+{
+    int64_t i_total = 0;
+    int i;
+
+    if( o->b_error )
+        return -1;
+
+    for( i = 0; i < i_count; i++ )
+        i_total += piece[i].i_size;
+
+    if( output_acquire( o, 0 ) < 0 )
+    {
+        o->b_error = 1;
+        return -1;
+    }
+
+    output_reserve( o, i_total );
+
+#ifdef _WIN32
+    for( i = 0; i < i_count; i++ )
+    {
+        const uint8_t *p = (const uint8_t *)piece[i].p;
+        size_t i_size = piece[i].i_size;
+
+        while( i_size > 0 )
+        {
+            int i_ret = _write( o->fd, p, (unsigned)(i_size > INT32_MAX ? INT32_MAX : i_size) );
+
+            if( i_ret <= 0 )
+                goto err_output_send;
+            p      += i_ret;
+            i_size -= i_ret;
+        }
+    }
+#else
+    {
+        struct iovec iov[OUTPUT_IOV_MAXIMUM];
+        int i_iov = 0;
+
+        for( i = 0; i < i_count; i++ )
+        {
+            if( piece[i].i_size == 0 )
+                continue;
+            iov[i_iov].iov_base = (void *)piece[i].p;
+            iov[i_iov].iov_len  = piece[i].i_size;
+            i_iov++;
+        }
+
+        while( i_iov > 0 )
+        {
+            ssize_t i_ret = writev( o->fd, iov, i_iov );
+
+            if( i_ret < 0 && errno == EINTR )
+                continue;
+            if( i_ret <= 0 )
+                goto err_output_send;
+
+            /* short write: skip what went out */
+            for( i = 0; i < i_iov && (size_t)i_ret >= iov[i].iov_len; i++ )
+                i_ret -= iov[i].iov_len;
+            if( i < i_iov )
+            {
+                iov[i].iov_base = (uint8_t *)iov[i].iov_base + i_ret;
+                iov[i].iov_len -= i_ret;
+            }
+            memmove( iov, iov + i, (i_iov - i) * sizeof(*iov) );
+            i_iov -= i;
+        }
+    }
+#endif
+
+    o->i_written += i_total;
+    output_release( o );
+
+    return 0;
+
+err_output_send:
+
+    xrtp_printf( XRTP_ERR, "output_send> write failed (%s).\n", strerror( errno ) );
+    o->b_error = 1;
+    output_release( o );
+
+    return -1;
+}
+
+/**
+ * Doubles the full buffer, when the other outputs leave room for it.
+ * return: 0, -1 if it has to be written out instead
+ */
+static int
+output_grow ( output_t *o )
+{
+    size_t   i_size = 2 * o->i_size;
+    uint8_t *p;
+    int      b_room;
+
+    if( i_size > OUTPUT_BUFFER || (o->i_flags & OUTPUT_SMALL) )
+        return -1;
+
+    xrtp_mutex_lock( &files.lock );
+    b_room = files.i_memory + i_size - o->i_size <= OUTPUT_MEMORY;
+    if( b_room )
+        files.i_memory += i_size - o->i_size;
+    xrtp_mutex_unlock( &files.lock );
+
+    if( !b_room )
+        return -1;
+
+    /* no realloc(): the alignment would be lost */
+    p = (uint8_t *)output_alloc( i_size );
+    if( p == NULL )
+    {
+        xrtp_mutex_lock( &files.lock );
+        files.i_memory -= i_size - o->i_size;
+        xrtp_mutex_unlock( &files.lock );
+        return -1;
+    }
+
+    memcpy( p, o->p_buffer, o->i_buffer );
+    output_free( o->p_buffer );
+    o->p_buffer = p;
+    o->i_size   = i_size;
+
+    return 0;
+}
+
+/**
+ * Writes the buffer out, but for its unaligned tail with O_DIRECT.
+ */
+static int
+output_drain ( output_t *o, int b_all )
+{
+    output_iov_t piece;
+    size_t i_keep = 0;
+
+    if( (o->i_flags & OUTPUT_DIRECT) && !b_all )
+        i_keep = o->i_buffer % OUTPUT_ALIGN;
+
+    piece.p      = o->p_buffer;
+    piece.i_size = o->i_buffer - i_keep;
+
+    if( o->writer && !b_all )
+    {
+        writer_req_t req;
+        int i_ret;
+
+        if( piece.i_size == 0 )
+            return 0;
+
+        if( output_acquire( o, 0 ) < 0 )
+        {
+            o->b_error = 1;
+            o->i_buffer = 0;
+            return -1;
+        }
+
+        /* swap the buffer for a written one, the tail goes along */
+        output_reserve( o, piece.i_size );
+
+        req.fd         = o->fd;
+        req.i_size     = piece.i_size;
+        req.i_offset   = o->i_written;
+        req.pi_pending = &o->i_pending;
+
+        if( o->i_size == OUTPUT_BUFFER )
+        {
+            req.p_buffer = o->p_buffer;
+            o->p_buffer  = writer_buffer( o->writer );
+            memcpy( o->p_buffer, req.p_buffer + req.i_size, i_keep );
+        }
+        else
+        {
+            /* only OUTPUT_BUFFER bytes buffers circulate: a smaller one
+             * is copied */
+            req.p_buffer = writer_buffer( o->writer );
+            memcpy( req.p_buffer, o->p_buffer, req.i_size );
+            memmove( o->p_buffer, o->p_buffer + req.i_size, i_keep );
+        }
+        o->i_buffer   = i_keep;
+        o->i_written += req.i_size;
+
+        /* pending from here: the descriptor is not evicted under the writer */
+        i_ret = writer_submit( o->writer, &req );
+        output_release( o );
+
+        return i_ret;
+    }
+
+    if( piece.i_size > 0 && output_send( o, &piece, 1 ) < 0 )
+    {
+        o->i_buffer = 0;
+        return -1;
+    }
+
+    memmove( o->p_buffer, o->p_buffer + piece.i_size, i_keep );
+    o->i_buffer = i_keep;
+
+    return 0;
+}
+
+int output_writev( output_t *o, const output_iov_t *iov, int i_count )
+{
+    size_t i_total = 0;
+    int i;
+
+    for( i = 0; i < i_count; i++ )
+        i_total += iov[i].i_size;
+
+    /* large and not direct: buffer and data in one writev() */
+    if( o->i_buffer + i_total > OUTPUT_BUFFER && !(o->i_flags & OUTPUT_DIRECT)
+     && o->writer == NULL && i_count < OUTPUT_IOV_MAXIMUM )
+    {
+        output_iov_t piece[OUTPUT_IOV_MAXIMUM];
+
+        piece[0].p      = o->p_buffer;
+        piece[0].i_size = o->i_buffer;
+        memcpy( piece + 1, iov, i_count * sizeof(*iov) );
+        o->i_buffer = 0;
+
+        return output_send( o, piece, i_count + 1 );
+    }
+
+    for( i = 0; i < i_count; i++ )
+    {
+        const uint8_t *p = (const uint8_t *)iov[i].p;
+        size_t i_size = iov[i].i_size;
+
+        while( i_size > 0 )
+        {
+            size_t i_copy = o->i_size - o->i_buffer;
+
+            if( i_copy > i_size )
+                i_copy = i_size;
+
+            memcpy( o->p_buffer + o->i_buffer, p, i_copy );
+            o->i_buffer += i_copy;
+            p           += i_copy;
+            i_size      -= i_copy;
+
+            if( o->i_buffer < o->i_size || output_grow( o ) == 0 )
+                continue;
+            if( output_drain( o, 0 ) < 0 )
+                return -1;
+        }
+    }
+
+    return o->b_error || (o->writer && writer_error( o->writer ) < 0) ? -1 : 0;
+}
+
+int output_write( output_t *o, const void *p, size_t i_size )
+{
+    output_iov_t iov;
+
+    iov.p      = p;
+    iov.i_size = i_size;
+
+    return output_writev( o, &iov, 1 );
+}
+
+int output_flush( output_t *o )
+{
+    return output_drain( o, 0 );
+}
+
+int output_sync( writer_t *w )
+{
+    output_t *o;
+
+    for( o = w->outputs; o; o = o->p_next )
+        output_drain( o, 0 );
+
+    for( o = w->outputs; o; o = o->p_next )
+        writer_wait( w, &o->i_pending );
+
+    return writer_error( w );
+}
+
+void output_close( output_t *o )
+{
+    if( o == NULL )
+        return;
+
+    if( o->writer )
+    {
+        output_t **pp;
+
+        for( pp = &o->writer->outputs; *pp != o; pp = &(*pp)->p_next )
+            ;
+        *pp = o->p_next;
+
+        /* what is left is written here, after the writes in flight */
+        output_drain( o, 0 );
+        writer_wait( o->writer, &o->i_pending );
+        if( writer_error( o->writer ) < 0 )
+            o->b_error = 1;
+    }
+
+    if( output_acquire( o, 0 ) < 0 )
+    {
+        o->b_error = 1;
+        goto end_output_close;
+    }
+
+    /* positioned writes leave the offset behind */
+    if( o->writer )
+    {
+#ifdef _WIN32
+        _lseeki64( o->fd, o->i_written, SEEK_SET );
+#else
+        lseek( o->fd, (off_t)o->i_written, SEEK_SET );
+#endif
+    }
+
+#ifdef __linux__
+    /* the unaligned tail */
+    if( (o->i_flags & OUTPUT_DIRECT) && o->i_buffer % OUTPUT_ALIGN )
+    {
+        fcntl( o->fd, F_SETFL, fcntl( o->fd, F_GETFL ) & ~O_DIRECT );
+        o->i_flags &= ~OUTPUT_DIRECT;
+    }
+#endif
+    output_drain( o, 1 );
+
+#ifdef __linux__
+    /* gives back what was reserved past the end */
+    if( o->i_allocated > o->i_written && ftruncate( o->fd, o->i_written ) < 0 )
+        xrtp_printf( XRTP_DBG, "output_close> can't release the preallocation.\n" );
+#endif
+
+    xrtp_mutex_lock( &files.lock );
+    output_lru_remove( o );
+    output_fd_close( o );
+    files.i_open--;
+    xrtp_mutex_unlock( &files.lock );
+
+end_output_close:
+
+    xrtp_mutex_lock( &files.lock );
+    files.i_memory -= o->i_size;
+    xrtp_mutex_unlock( &files.lock );
+
+    output_free( o->p_buffer );
+    free( o->psz_file );
+    free( o );
+}
@@ -0,0 +1,107 @@
+#ifndef _OUTPUT_H_
+#define _OUTPUT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Buffered output file of an extracted stream.
+ *
+ * Replaces the stdio FILE of the payload handlers: writes are gathered
+ * in an aligned buffer owned by the output (no stdio locking), and a
+ * write that does not fit is sent together with the buffer in one
+ * writev(). The buffer starts at OUTPUT_BUFFER_MINIMUM bytes and doubles
+ * each time it is full, up to OUTPUT_BUFFER, while the buffers of all
+ * the outputs take less than OUTPUT_MEMORY: the busy streams get large
+ * writes, thousands of sources do not take a large buffer each. Options:
+ *  - direct:   O_DIRECT, only whole aligned blocks are written until the
+ *              end, when the tail goes through the page cache,
+ *  - prealloc: fallocate() the file OUTPUT_PREALLOC bytes ahead, so the
+ *              file system allocates large extents.
+ * Both are Linux only and silently ignored elsewhere.
+ *
+ * With a writer (writer.h) the full buffers are written asynchronously,
+ * at their offset: "async" for a writer thread, "uring" for io_uring.
+ *
+ * The descriptors are shared by all the outputs: at most "files=<n>" are
+ * open (by default what RLIMIT_NOFILE allows), the least recently written
+ * one is closed when another output needs one, and reopened at its end
+ * when it is written again. Data is only buffered, so an output only
+ * needs its descriptor every OUTPUT_BUFFER bytes.
+ */
+
+#define OUTPUT_DIRECT       0x01
+#define OUTPUT_PREALLOCATE  0x02
+#define OUTPUT_ASYNC        0x04    /* per session options, see writer_create() */
+#define OUTPUT_URING        0x08
+#define OUTPUT_SMALL        0x10    /* keeps OUTPUT_BUFFER_MINIMUM, not an option */
+
+#define OUTPUT_BUFFER       (1 << 20)
+#define OUTPUT_BUFFER_MINIMUM (32 << 10)
+#define OUTPUT_MEMORY       (512 << 20)     /* all the output buffers */
+#define OUTPUT_ALIGN        4096
+#define OUTPUT_PREALLOC     (64 << 20)
+#define OUTPUT_FD_RESERVE   64      /* descriptors left to the rest */
+
+typedef struct _writer_t writer_t;
+typedef struct _output_t output_t;
+
+struct _output_t
+{
+    int       fd;               /* -1 while evicted */
+    uint32_t  i_flags;
+    char     *psz_file;
+
+    uint8_t  *p_buffer;         /* OUTPUT_ALIGN aligned */
+    size_t    i_buffer;
+    size_t    i_size;           /* allocated, OUTPUT_BUFFER_MINIMUM to OUTPUT_BUFFER */
+
+    int64_t   i_written;        /* bytes in the file */
+    int64_t   i_allocated;      /* preallocated up to */
+    int       b_error;          /* a write failed, the next ones are dropped */
+
+    writer_t *writer;           /* NULL: synchronous writes */
+    output_t *p_next;           /* outputs of the writer */
+    volatile uint32_t i_pending;    /* buffers handed to the writer */
+
+    output_t *p_lru_prev, *p_lru_next;  /* open descriptors, most recent first */
+    unsigned  i_busy;           /* its descriptor is in use */
+
+};
+
+typedef struct _output_iov_t
+{
+    const void *p;
+    size_t      i_size;
+
+}output_iov_t;
+
+/* "direct,prealloc,async|uring,files=<n>" to OUTPUT_* flags and the
+ * descriptor limit, -1 on error */
+int      output_parse( const char *psz, uint32_t *pi_flags, unsigned *pi_files );
+
+/* before any output, i_files: descriptor limit, 0 for the default.
+ * return: the limit */
+unsigned output_init( unsigned i_files );
+
+/* writer: NULL for synchronous writes */
+output_t *output_open( const char *psz_file, uint32_t i_flags, writer_t *writer );
+/* flushes and closes */
+void     output_close( output_t *o );
+
+/* return: 0, -1 after a write error */
+int      output_write( output_t *o, const void *p, size_t i_size );
+/* gathers i_count pieces */
+int      output_writev( output_t *o, const output_iov_t *iov, int i_count );
+int      output_flush( output_t *o );
+
+/* flushes every output of the writer and waits for their writes */
+int      output_sync( writer_t *w );
+
+/* offset of the next byte written */
+static inline int64_t output_tell( const output_t *o )
+{
+    return o->i_written + (int64_t)o->i_buffer;
+}
+
+#endif //_OUTPUT_H_
@@ -7,12 +7,29 @@
 
 #include "payload.h"
 #include "bitstream.h"
+#include "frame.h"
+#include "h264.h"
+#include "h265.h"
+#include "output.h"
+#include "mp4.h"
 
 #define SEI_NAL_MAXIMUM     1024
 
 // whether write SEI NAL
 uint8_t b_write_sei = 0;
 
+// whether write the .es.idx of the .es files
+uint8_t b_write_index = 0;
+
+// OUTPUT_* options of the .es files
+uint32_t i_output_flags = 0;
+unsigned i_output_files = 0;
+
+archive_t *p_archive = NULL;
+
+// frames per fragment of the .mp4 of H.264/H.265, 0: .es
+unsigned i_mp4_fragment = 0;
+
 char algorithm_available[][100] = {
     "h264",
     "h265",
@@ -23,7 +40,17 @@ char algorithm_available[][100] = {
 
 typedef struct _payload_t
 {
-    FILE *fp;
+    output_t *out;              /* NULL: to p_archive */
+    output_t *idx;              /* a record per frame of out, NULL if not */
+    mp4_t    *mp4;              /* fragmented MP4 instead of out, NULL if not */
+    uint32_t  ssrc;
+    uint8_t   i_pt;
+
+    /* h.264/h.265: one write per access unit */
+    frame_asm_t *fa;
+
+    h264_parser_t *h264;
+    h265_parser_t *h265;
 
     /* write SEI NAL */
     bs_t     bs;
@@ -32,11 +59,215 @@ typedef struct _payload_t
 }payload_t;
 
 static int write_sei_timestamp( payload_t *h, mtime_t pts );
+/* the index record of a frame, in the sidecar or the archive */
+static void frame_entry( const payload_t *h, const frame_t *f, archive_entry_t *e )
+{
+    e->i_offset        = h->out ? output_tell( h->out ) : 0;
+    e->i_arrival       = f->first_arrival;
+    e->ssrc            = h->ssrc;
+    e->i_rtp_timestamp = f->i_rtp_timestamp;
+    e->i_size          = (uint32_t)f->i_buffer;
+    e->i_pt            = h->i_pt;
+
+    if( f->i_block_flags & BLOCK_FLAG_TYPE_B )
+        e->i_type = ARCHIVE_TYPE_B;
+    else if( f->i_block_flags & BLOCK_FLAG_TYPE_P )
+        e->i_type = ARCHIVE_TYPE_P;
+    else if( f->i_block_flags & BLOCK_FLAG_TYPE_I )
+        e->i_type = ARCHIVE_TYPE_I;
+    else
+        e->i_type = ARCHIVE_TYPE_UNKNOWN;
+
+    e->i_flags = (FRAME_IS_KEY( f ) ? ARCHIVE_FLAG_KEY : 0)
+               | (f->i_flags & FRAME_FLAG_DAMAGED ? ARCHIVE_FLAG_DAMAGED : 0);
+}
+
+/* the formats without frames: one payload */
+static void block_entry( const payload_t *h, const block_t *block, archive_entry_t *e )
+{
+    e->i_offset        = h->out ? output_tell( h->out ) : 0;
+    e->i_arrival       = block->i_pts;
+    e->ssrc            = h->ssrc;
+    e->i_rtp_timestamp = (uint32_t)block->i_rtp_timestamp;
+    e->i_size          = block->i_buffer;
+    e->i_pt            = h->i_pt;
+    e->i_type          = ARCHIVE_TYPE_UNKNOWN;
+    e->i_flags         = 0;
+}
+
+/* the .es.idx next to the .es */
+static int open_index( payload_t *h, const payload_args *args )
+{
+    char file_name[1024 + 4];
+
+    snprintf( file_name, sizeof(file_name), "%s.idx", args->file_name );
+    /* 32 bytes a frame: the smallest buffer holds a thousand of them */
+    h->idx = output_open( file_name, i_output_flags | OUTPUT_SMALL, args->writer );
+
+    return h->idx ? 0 : -1;
+}
+
+/* the .mp4 in place of the .es */
+static int open_mp4( payload_t *h, const payload_args *args, int i_codec )
+{
+    char file_name[1024 + 4];
+    size_t i_len = strlen( args->file_name );
+
+    if( i_len > 3 && !strcmp( args->file_name + i_len - 3, ".es" ) )
+        i_len -= 3;
+    snprintf( file_name, sizeof(file_name), "%.*s.mp4", (int)i_len, args->file_name );
+    h->mp4 = mp4_open( file_name, i_codec, args->i_frequency, i_mp4_fragment,
+                       i_output_flags, args->writer );
+
+    return h->mp4 ? 0 : -1;
+}
+
+static void write_index( payload_t *h, const archive_entry_t *e )
+{
+    uint8_t record[ARCHIVE_ENTRY_SIZE];
+
+    archive_entry_pack( record, e );
+    output_write( h->idx, record, sizeof(record) );
+}
+
+static void write_frame( void *opaque, const frame_t *f )
+{
+    payload_t *h = (payload_t *)opaque;
+    archive_entry_t e;
+
+    if( h->mp4 )
+    {
+        mp4_frame( h->mp4, f );
+        return;
+    }
+
+    frame_entry( h, f, &e );
+
+    if( h->out == NULL )
+    {
+        archive_write( p_archive, &e, f->p_buffer );
+        return;
+    }
+
+    if( h->idx )
+        write_index( h, &e );
+    output_write( h->out, f->p_buffer, f->i_buffer );
+}
+
+/* a payload of the formats without frames, to the archive */
+static void write_block( payload_t *h, const block_t *block )
+{
+    archive_entry_t e;
+
+    block_entry( h, block, &e );
+    archive_write( p_archive, &e, block->p_buffer );
+}
 static int nal_unit_type( uint8_t *nal )
 {
     return nal[0] & 0x1F;
 }
 
+/* tags the block and its frame from the first bytes of a NAL unit */
+static void h264_tag( payload_t *h, block_t *block, uint8_t nal_header,
+                      const uint8_t *p, int i_size )
+{
+    frame_t *f = h->fa->cur;
+    h264_slice_t slice;
+    uint32_t flags;
+    int i_type = h264_parse_nal( h->h264, nal_header, p, i_size, &slice );
+
+    if( i_type == H264_NAL_SPS || i_type == H264_NAL_PPS )
+        block->i_flags |= BLOCK_FLAG_HEADER;
+
+    if( slice.i_nal_type == 0 )
+        return;
+
+    switch( slice.i_slice_type )
+    {
+        case 0: case 3: flags = BLOCK_FLAG_TYPE_P; break;   /* P, SP */
+        case 1:         flags = BLOCK_FLAG_TYPE_B; break;
+        default:        flags = BLOCK_FLAG_TYPE_I; break;   /* I, SI */
+    }
+    if( !slice.b_idr )
+        flags |= BLOCK_FLAG_NO_KEYFRAME;
+
+    block->i_flags |= flags;
+    if( slice.b_idr )
+        block->i_key = FRAME_KEY_IDR;
+    if( (slice.i_nal_ref_idc != 0) > block->i_reference )
+        block->i_reference = slice.i_nal_ref_idc != 0;
+
+    if( f == NULL )
+        return;
+
+    f->i_block_flags |= flags;
+    if( block->i_key )
+        f->i_key = block->i_key;
+    if( block->i_reference > f->i_reference )
+        f->i_reference = block->i_reference;
+    if( slice.i_first_mb == 0 && f->i_poc < 0 )
+    {
+        f->i_frame_num = slice.i_frame_num;
+        f->i_poc       = slice.i_poc;
+        f->i_width     = slice.i_width;
+        f->i_height    = slice.i_height;
+    }
+}
+
+/* tags the block and its frame from the first bytes of a NAL unit,
+ * nal: the 2 bytes NAL unit header */
+static void h265_tag( payload_t *h, block_t *block, const uint8_t nal[2],
+                      const uint8_t *p, int i_size )
+{
+    frame_t *f = h->fa->cur;
+    h265_slice_t slice;
+    uint32_t flags;
+    int i_type = h265_parse_nal( h->h265, nal, p, i_size, &slice );
+
+    if( i_type >= H265_NAL_VPS && i_type <= H265_NAL_PPS )
+        block->i_flags |= BLOCK_FLAG_HEADER;
+
+    if( slice.i_nal_type == 0xFF )
+        return;
+
+    switch( slice.i_slice_type )
+    {
+        case 0:  flags = BLOCK_FLAG_TYPE_B; break;
+        case 1:  flags = BLOCK_FLAG_TYPE_P; break;
+        default: flags = BLOCK_FLAG_TYPE_I; break;
+    }
+    if( !H265_IS_IRAP( slice.i_nal_type ) )
+        flags |= BLOCK_FLAG_NO_KEYFRAME;
+
+    block->i_flags |= flags;
+    block->i_temporal_id = (int8_t)slice.i_temporal_id;
+    if( slice.b_reference > block->i_reference )
+        block->i_reference = slice.b_reference;
+    if( H265_IS_IDR( slice.i_nal_type ) )
+        block->i_key = FRAME_KEY_IDR;
+    else if( slice.i_nal_type == H265_NAL_CRA )
+        block->i_key = FRAME_KEY_CRA;
+    else if( H265_IS_IRAP( slice.i_nal_type ) )
+        block->i_key = FRAME_KEY_BLA;
+
+    if( f == NULL )
+        return;
+
+    f->i_block_flags |= flags;
+    if( block->i_key )
+        f->i_key = block->i_key;
+    if( block->i_reference > f->i_reference )
+        f->i_reference = block->i_reference;
+
+    if( slice.b_first && f->i_poc < 0 )
+    {
+        f->i_poc         = slice.i_poc;
+        f->i_temporal_id = slice.i_temporal_id;
+        f->i_width       = slice.i_width;
+        f->i_height      = slice.i_height;
+    }
+}
+
 intptr_t no_init( void *a )
 {
     // this handle should not be used
@@ -67,19 +298,57 @@ intptr_t h264payload_int( void *a )
         goto err_h264payload_int;
     }
 
-    h->fp = fopen( args->file_name, "wb" );
-    if( h->fp == NULL )
+    h->fa   = NULL;
+    h->h264 = NULL;
+    h->ssrc = args->ssrc;
+    h->i_pt = args->i_pt;
+    h->out  = NULL;
+    h->idx  = NULL;
+    h->mp4  = NULL;
+    if( p_archive == NULL && i_mp4_fragment > 0 && open_mp4( h, args, MP4_CODEC_H264 ) < 0 )
+    {
+        xrtp_printf( XRTP_ERR, "h264payload_int> can't open mp4 file.\n" );
+        goto err_h264payload_int;
+    }
+    if( p_archive == NULL && h->mp4 == NULL )
+        h->out = output_open( args->file_name, i_output_flags, args->writer );
+    if( h->out == NULL && p_archive == NULL && h->mp4 == NULL )
     {
         xrtp_printf( XRTP_ERR, "h264payload_int> can't open file.\n" );
         goto err_h264payload_int;
     }
 
+    if( h->out && b_write_index && open_index( h, args ) < 0 )
+    {
+        xrtp_printf( XRTP_ERR, "h264payload_int> can't open index.\n" );
+        goto err_h264payload_int;
+    }
+
+    h->fa = frame_asm_create( write_frame, h );
+    if( h->fa == NULL )
+    {
+        xrtp_printf( XRTP_ERR, "h264payload_int> can't create frame assembler.\n" );
+        goto err_h264payload_int;
+    }
+
+    h->h264 = h264_parser_create();
+    if( h->h264 == NULL )
+    {
+        xrtp_printf( XRTP_ERR, "h264payload_int> can't create parser.\n" );
+        goto err_h264payload_int;
+    }
+
     return (intptr_t)h;
 
 err_h264payload_int:
 
-    if( h->fp )
-        fclose( h->fp );
+    frame_asm_destroy( h->fa );
+    mp4_close( h->mp4 );
+
+    if( h->out )
+        output_close( h->out );
+    if( h->idx )
+        output_close( h->idx );
 
     if( h )
         free( h );
@@ -93,8 +362,15 @@ void h264payload_destory( intptr_t handle )
 
     assert( h );
 
-    if( h->fp )
-        fclose( h->fp );
+    /* pending access unit */
+    frame_asm_destroy( h->fa );
+    h264_parser_destroy( h->h264 );
+    mp4_close( h->mp4 );
+
+    if( h->out )
+        output_close( h->out );
+    if( h->idx )
+        output_close( h->idx );
 
     if( h )
         free( h );
@@ -106,8 +382,6 @@ const static
     uint8_t prefix[4] = { 0x00, 0x00, 0x00, 0x01 };
 
     payload_t *h = (payload_t *)handle;
-    FILE *fp = h->fp;
-    
     uint8_t  nal_type, nal_head_flag = 0;
     
     uint8_t *payload, *head;
@@ -117,18 +391,21 @@ const static
 
     assert( h );
     assert( block );
-    assert( h->fp );
+    assert( h->out || p_archive || h->mp4 );
     
     assert( block->i_buffer > 0 );
 
     payload       = block->p_buffer;
     i_payload_len = block->i_buffer;
 
+    if( frame_asm_packet( h->fa, block ) < 0 )
+        return -1;
+
 #define SEI_TIMESTAMP(type) \
     if( b_write_sei && ((type) >= 1 && (type) <= 5) ) \
     { \
         i_sei_len = write_sei_timestamp( h, block->i_rtp_timestamp ); \
-        fwrite( h->nal, 1, i_sei_len, fp ); \
+        frame_asm_write( h->fa, h->nal, i_sei_len ); \
     }
 
     /**************************************************************
@@ -156,10 +433,11 @@ const static
                 head  += 2;
                 i_payload_len -= (2 + i_nal_len);
 
+                h264_tag( h, block, head[0], head + 1, i_nal_len - 1 );
                 SEI_TIMESTAMP( nal_unit_type(head) );
                 
-                fwrite(prefix, 1, 4, fp);
-                fwrite(head, 1, i_nal_len, fp);
+                frame_asm_write( h->fa, prefix, 4 );
+                frame_asm_write( h->fa, head, i_nal_len );
 
                 head  += i_nal_len;
             }
@@ -174,10 +452,11 @@ const static
                 head += 2;
                 i_payload_len -= (2 + i_nal_len);
 
+                h264_tag( h, block, head[0], head + 1, i_nal_len - 1 );
                 SEI_TIMESTAMP( nal_unit_type(head) );
                 
-                fwrite(prefix, 1, 4, fp);
-                fwrite(head, 1, i_nal_len, fp);
+                frame_asm_write( h->fa, prefix, 4 );
+                frame_asm_write( h->fa, head, i_nal_len );
 
                 head += i_nal_len;
             }    
@@ -191,10 +470,11 @@ const static
                 head += 5;                     /* skip DOND & TS offset */
                 i_payload_len -= (5 + i_nal_len);
 
+                h264_tag( h, block, head[0], head + 1, i_nal_len - 1 );
                 SEI_TIMESTAMP( nal_unit_type(head) );
                 
-                fwrite(prefix, 1, 4, fp);
-                fwrite(head, 1, i_nal_len, fp);
+                frame_asm_write( h->fa, prefix, 4 );
+                frame_asm_write( h->fa, head, i_nal_len );
             }
             break;        
         case 27:    /* MTAP24 */
@@ -206,10 +486,11 @@ const static
                 head += 6;                     /* skip DOND & TS offset */
                 i_payload_len -= (6 + i_nal_len);
 
+                h264_tag( h, block, head[0], head + 1, i_nal_len - 1 );
                 SEI_TIMESTAMP( nal_unit_type(head) );
                 
-                fwrite(prefix, 1, 4, fp);
-                fwrite(head, 1, i_nal_len, fp);
+                frame_asm_write( h->fa, prefix, 4 );
+                frame_asm_write( h->fa, head, i_nal_len );
             }   
             break;
         case 28:    /* FU-A */
@@ -229,13 +510,14 @@ const static
        
             if(nal_head_flag)
             {
+                h264_tag( h, block, nal_type, head, i_payload_len );
                 SEI_TIMESTAMP( nal_type&0x1F );
             
-                fwrite( prefix, 1, 4, fp );
-                fwrite( &nal_type, 1, 1, fp );
+                frame_asm_write( h->fa, prefix, 4 );
+                frame_asm_write( h->fa, &nal_type, 1 );
             }
             
-            fwrite(head, 1, i_payload_len, fp);
+            frame_asm_write( h->fa, head, i_payload_len );
             
             break;
         case 29:
@@ -253,25 +535,29 @@ const static
             head = payload + 4;              /* skip FU Indicator & FU Header & DON */
             i_payload_len -= 4;
 
+            h264_tag( h, block, nal_type, head, i_payload_len );
             SEI_TIMESTAMP( nal_type&0x1F );
        
-            fwrite(prefix, 1, 4, fp);
-            fwrite(&nal_type, 1, 1, fp);
-            fwrite(head, 1, i_payload_len, fp);
+            frame_asm_write( h->fa, prefix, 4 );
+            frame_asm_write( h->fa, &nal_type, 1 );
+            frame_asm_write( h->fa, head, i_payload_len );
         
             break;
         default:
             head = payload;
 
+            h264_tag( h, block, head[0], head + 1, i_payload_len - 1 );
             SEI_TIMESTAMP( nal_unit_type(head) );
 
-            fwrite(prefix, 1, 4, fp);
-            fwrite(head, 1, i_payload_len, fp);
+            frame_asm_write( h->fa, prefix, 4 );
+            frame_asm_write( h->fa, head, i_payload_len );
             break;
     }
 
 #undef SEI_TIMESTAMP
 
+    frame_asm_packet_end( h->fa, block );
+
     return 0;
     
 }
@@ -290,19 +576,57 @@ intptr_t h265payload_int( void *a )
         goto err_h265payload_int;
     }
 
-    h->fp = fopen( args->file_name, "wb" );
-    if( h->fp == NULL )
+    h->fa   = NULL;
+    h->h265 = NULL;
+    h->ssrc = args->ssrc;
+    h->i_pt = args->i_pt;
+    h->out  = NULL;
+    h->idx  = NULL;
+    h->mp4  = NULL;
+    if( p_archive == NULL && i_mp4_fragment > 0 && open_mp4( h, args, MP4_CODEC_H265 ) < 0 )
+    {
+        xrtp_printf( XRTP_ERR, "h265payload_int> can't open mp4 file.\n" );
+        goto err_h265payload_int;
+    }
+    if( p_archive == NULL && h->mp4 == NULL )
+        h->out = output_open( args->file_name, i_output_flags, args->writer );
+    if( h->out == NULL && p_archive == NULL && h->mp4 == NULL )
     {
         xrtp_printf( XRTP_ERR, "h265payload_int> can't open file.\n" );
         goto err_h265payload_int;
     }
 
+    if( h->out && b_write_index && open_index( h, args ) < 0 )
+    {
+        xrtp_printf( XRTP_ERR, "h265payload_int> can't open index.\n" );
+        goto err_h265payload_int;
+    }
+
+    h->fa = frame_asm_create( write_frame, h );
+    if( h->fa == NULL )
+    {
+        xrtp_printf( XRTP_ERR, "h265payload_int> can't create frame assembler.\n" );
+        goto err_h265payload_int;
+    }
+
+    h->h265 = h265_parser_create();
+    if( h->h265 == NULL )
+    {
+        xrtp_printf( XRTP_ERR, "h265payload_int> can't create parser.\n" );
+        goto err_h265payload_int;
+    }
+
     return (intptr_t)h;
 
 err_h265payload_int:
 
-    if( h->fp )
-        fclose( h->fp );
+    frame_asm_destroy( h->fa );
+    mp4_close( h->mp4 );
+
+    if( h->out )
+        output_close( h->out );
+    if( h->idx )
+        output_close( h->idx );
 
     if( h )
         free( h );
@@ -316,8 +640,15 @@ void h265payload_destory( intptr_t handle )
 
     assert( h );
 
-    if( h->fp )
-        fclose( h->fp );
+    /* pending access unit */
+    frame_asm_destroy( h->fa );
+    h265_parser_destroy( h->h265 );
+    mp4_close( h->mp4 );
+
+    if( h->out )
+        output_close( h->out );
+    if( h->idx )
+        output_close( h->idx );
 
     if( h )
         free( h );
@@ -329,8 +660,6 @@ const static
     uint8_t prefix[4] = { 0x00, 0x00, 0x00, 0x01 };
 
     payload_t *h = (payload_t *)handle;
-    FILE *fp = h->fp;
-    
     uint8_t  nal_header[2], nal_head_flag = 0;
     
     uint8_t *payload, *head;
@@ -338,13 +667,16 @@ const static
 
     assert( h );
     assert( block );
-    assert( h->fp );
+    assert( h->out || p_archive || h->mp4 );
     
     assert( block->i_buffer > 0 );
 
     payload       = block->p_buffer;
     i_payload_len = block->i_buffer;
 
+    if( frame_asm_packet( h->fa, block ) < 0 )
+        return -1;
+
     /**************************************************************
     * NAL HEADER                                                  *
     * 0-123456-701234 -567                                        *
@@ -364,8 +696,10 @@ const static
                 head += 2;
                 i_payload_len -= (2 + i_nal_len);
 
-                fwrite(prefix, 1, 4, fp);
-                fwrite(head, 1, i_nal_len, fp);
+                h265_tag( h, block, head, head + 2, i_nal_len - 2 );
+
+                frame_asm_write( h->fa, prefix, 4 );
+                frame_asm_write( h->fa, head, i_nal_len );
 
                 head += i_nal_len;
             }   
@@ -391,22 +725,28 @@ const static
        
             if(nal_head_flag)
             {
-                fwrite( prefix, 1, 4, fp );
-                fwrite( &nal_header[0], 1, 1, fp );
-                fwrite( &nal_header[1], 1, 1, fp );
+                h265_tag( h, block, nal_header, head, i_payload_len );
+
+                frame_asm_write( h->fa, prefix, 4 );
+                frame_asm_write( h->fa, &nal_header[0], 1 );
+                frame_asm_write( h->fa, &nal_header[1], 1 );
             }
             
-            fwrite(head, 1, i_payload_len, fp);
+            frame_asm_write( h->fa, head, i_payload_len );
             
             break;
         default:
             head = payload;
 
-            fwrite(prefix, 1, 4, fp);
-            fwrite(head, 1, i_payload_len, fp);
+            h265_tag( h, block, head, head + 2, i_payload_len - 2 );
+
+            frame_asm_write( h->fa, prefix, 4 );
+            frame_asm_write( h->fa, head, i_payload_len );
             break;
     }
 
+    frame_asm_packet_end( h->fa, block );
+
     return 0;
 }
 
@@ -424,19 +764,32 @@ intptr_t defpayload_int( void *a )
         goto err_defpayload_int;
     }
 
-    h->fp = fopen( args->file_name, "wb" );
-    if( h->fp == NULL )
+    h->ssrc = args->ssrc;
+    h->i_pt = args->i_pt;
+    h->out  = NULL;
+    h->idx  = NULL;
+    if( p_archive == NULL )
+        h->out = output_open( args->file_name, i_output_flags, args->writer );
+    if( h->out == NULL && p_archive == NULL )
     {
         xrtp_printf( XRTP_ERR, "defpayload_int> can't open file.\n" );
         goto err_defpayload_int;
     }
 
+    if( h->out && b_write_index && open_index( h, args ) < 0 )
+    {
+        xrtp_printf( XRTP_ERR, "defpayload_int> can't open index.\n" );
+        goto err_defpayload_int;
+    }
+
     return (intptr_t)h;
 
 err_defpayload_int:
 
-    if( h->fp )
-        fclose( h->fp );
+    if( h->out )
+        output_close( h->out );
+    if( h->idx )
+        output_close( h->idx );
 
     if( h )
         free( h );
@@ -450,8 +803,10 @@ void defpayload_destory( intptr_t handle )
 
     assert( h );
 
-    if( h->fp )
-        fclose( h->fp );
+    if( h->out )
+        output_close( h->out );
+    if( h->idx )
+        output_close( h->idx );
 
     if( h )
         free( h );
@@ -460,21 +815,34 @@ void defpayload_destory( intptr_t handle )
 int defpayload_decode( intptr_t handle, block_t *block )
 {
     payload_t *h = (payload_t *)handle;
-    FILE *fp = h->fp;
     
     uint8_t *payload;
     int i_payload_len;
 
     assert( h );
     assert( block );
-    assert( h->fp );
+    assert( h->out || p_archive );
     
     assert( block->i_buffer > 0 );
 
     payload       = block->p_buffer;
     i_payload_len = block->i_buffer;
 
-    fwrite( payload, 1, i_payload_len, fp );
+    if( h->out == NULL )
+    {
+        write_block( h, block );
+        return 0;
+    }
+
+    if( h->idx )
+    {
+        archive_entry_t e;
+
+        block_entry( h, block, &e );
+        write_index( h, &e );
+    }
+
+    output_write( h->out, payload, i_payload_len );
 
     return 0;
     
@@ -494,19 +862,32 @@ intptr_t hpvcpayload_int( void *a )
         goto err_hpvcpayload_int;
     }
 
-    h->fp = fopen( args->file_name, "wb" );
-    if( h->fp == NULL )
+    h->ssrc = args->ssrc;
+    h->i_pt = args->i_pt;
+    h->out  = NULL;
+    h->idx  = NULL;
+    if( p_archive == NULL )
+        h->out = output_open( args->file_name, i_output_flags, args->writer );
+    if( h->out == NULL && p_archive == NULL )
     {
         xrtp_printf( XRTP_ERR, "hpvcpayload_int> can't open file.\n" );
         goto err_hpvcpayload_int;
     }
 
+    if( h->out && b_write_index && open_index( h, args ) < 0 )
+    {
+        xrtp_printf( XRTP_ERR, "hpvcpayload_int> can't open index.\n" );
+        goto err_hpvcpayload_int;
+    }
+
     return (intptr_t)h;
 
 err_hpvcpayload_int:
 
-    if( h->fp )
-        fclose( h->fp );
+    if( h->out )
+        output_close( h->out );
+    if( h->idx )
+        output_close( h->idx );
 
     if( h )
         free( h );
@@ -520,8 +901,10 @@ void hpvcpayload_destory( intptr_t handle )
 
     assert( h );
 
-    if( h->fp )
-        fclose( h->fp );
+    if( h->out )
+        output_close( h->out );
+    if( h->idx )
+        output_close( h->idx );
 
     if( h )
         free( h );
@@ -530,23 +913,43 @@ void hpvcpayload_destory( intptr_t handle )
 int hpvcpayload_decode( intptr_t handle, block_t *block )
 {
     payload_t *h = (payload_t *)handle;
-    FILE *fp = h->fp;
+    output_iov_t iov[2];
     
     uint8_t *payload;
     int i_payload_len;
 
     assert( h );
     assert( block );
-    assert( h->fp );
+    assert( h->out || p_archive );
     
     assert( block->i_buffer > 0 );
 
     payload       = block->p_buffer;
     i_payload_len = block->i_buffer;
 
-    fwrite( &i_payload_len, 1, 4, fp );
+    /* the record has the length already */
+    if( h->out == NULL )
+    {
+        write_block( h, block );
+        return 0;
+    }
+
+    /* length prefix, then the payload */
+    iov[0].p      = &i_payload_len;
+    iov[0].i_size = 4;
+    iov[1].p      = payload;
+    iov[1].i_size = i_payload_len;
+
+    if( h->idx )
+    {
+        archive_entry_t e;
+
+        block_entry( h, block, &e );
+        e.i_size += 4;
+        write_index( h, &e );
+    }
 
-    fwrite( payload, 1, i_payload_len, fp );
+    output_writev( h->out, iov, 2 );
 
     return 0;
     
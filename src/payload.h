@@ -4,10 +4,15 @@
 #include <datatype.h>
 
 #include "xrtp.h"
+#include "archive.h"
 
 typedef struct _payload_args
 {
     char file_name[1024];
+    struct _writer_t *writer;   /* of the session, NULL: synchronous output */
+    uint32_t ssrc;
+    uint8_t  i_pt;
+    uint32_t i_frequency;       /* RTP clock */
 
 }payload_args;
 
@@ -15,6 +20,18 @@ extern char algorithm_available[][100];
 
 extern uint8_t b_write_sei;
 
+extern uint8_t b_write_index;
+
+extern uint32_t i_output_flags;
+extern unsigned i_output_files;
+
+/* all the frames to one archive instead of the .es files, NULL if not */
+extern archive_t *p_archive;
+
+/* H.264/H.265 to a fragmented .mp4 instead of the .es, frames per
+ * fragment, 0 if not */
+extern unsigned i_mp4_fragment;
+
 /* nothing */
 intptr_t no_init( void *a );
 void no_destroy( intptr_t handle );
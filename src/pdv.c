@@ -0,0 +1,114 @@
+/**
+ * @file pdv.c
+ * @brief Packet delay variation (RFC 5481)
+ */
+
+#include <stdlib.h>
+
+#include "pdv.h"
+#include "session.h"
+
+#define PDV_SLOT    (PDV_WINDOW / PDV_SLOTS)
+
+pdv_t *pdv_create( uint32_t freq )
+{
+    pdv_t *p = (pdv_t *)calloc( 1, sizeof(pdv_t) );
+    int i;
+
+    if( p == NULL )
+        return NULL;
+
+    p->freq = freq;
+    for( i = 0; i < PDV_REORDER; i++ )
+        p->i_seq[i] = -1;
+
+    return p;
+}
+
+void pdv_destroy( pdv_t *p )
+{
+    if( p )
+        free( p );
+}
+
+static void
+pdv_ipdv ( pdv_t *p, mtime_t ipdv )
+{
+    if( ipdv >= 0 )
+        hist_add( &p->ipdv, ipdv );
+    else
+        hist_add( &p->ipdv_neg, -ipdv );
+}
+
+void pdv_update( pdv_t *p, uint16_t seq, mtime_t send_time, int64_t ext_ts,
+                 mtime_t arrival )
+{
+    const uint16_t prev = seq - 1, next = seq + 1;
+    int64_t i_slot = arrival / PDV_SLOT;
+    mtime_t d, d_min;
+    int i;
+
+    if( send_time < 0 )
+        send_time = ext_ts * CLOCK_FREQ / p->freq;
+
+    d = arrival - send_time;
+
+    if( !p->b_started )
+    {
+        for( i = 0; i < PDV_SLOTS; i++ )
+            p->slot_min[i] = INT64_MAX;
+        p->i_slot    = i_slot;
+        p->b_started = 1;
+    }
+
+    /* IPDV with the neighbours in sequence order, once per pair: a
+     * reordered packet closes the pair with its successor too */
+    if( p->i_seq[seq % PDV_REORDER] != seq )
+    {
+        if( p->i_seq[prev % PDV_REORDER] == prev )
+            pdv_ipdv( p, d - p->d_seq[prev % PDV_REORDER] );
+        if( p->i_seq[next % PDV_REORDER] == next )
+            pdv_ipdv( p, p->d_seq[next % PDV_REORDER] - d );
+
+        p->i_seq[seq % PDV_REORDER] = seq;
+        p->d_seq[seq % PDV_REORDER] = d;
+    }
+
+    /* slide: the slots between the last packet and this one are empty */
+    for( ; p->i_slot < i_slot; )
+    {
+        p->i_slot++;
+        p->slot_min[p->i_slot % PDV_SLOTS] = INT64_MAX;
+
+        if( i_slot - p->i_slot >= PDV_SLOTS )
+            p->i_slot = i_slot - PDV_SLOTS;
+    }
+
+    if( d < p->slot_min[i_slot % PDV_SLOTS] )
+        p->slot_min[i_slot % PDV_SLOTS] = d;
+
+    d_min = d;
+    for( i = 0; i < PDV_SLOTS; i++ )
+    {
+        if( p->slot_min[i] < d_min )
+            d_min = p->slot_min[i];
+    }
+
+    hist_add( &p->pdv, d - d_min );
+}
+
+void pdv_report( const pdv_t *p, FILE *fp )
+{
+    if( p->pdv.i_total == 0 )
+        return;
+
+    fprintf( fp, "  ipdv:   p0.1 %lld, p50 %lld, p99 %lld, p99.9 %lld us\n",
+                 (long long)hist_quantile_signed( &p->ipdv_neg, &p->ipdv, .001 ),
+                 (long long)hist_quantile_signed( &p->ipdv_neg, &p->ipdv, .5 ),
+                 (long long)hist_quantile_signed( &p->ipdv_neg, &p->ipdv, .99 ),
+                 (long long)hist_quantile_signed( &p->ipdv_neg, &p->ipdv, .999 ) );
+
+    fprintf( fp, "  pdv:    p50 %u, p99 %u, p99.9 %u, max %u us (min delay over %d s)\n",
+                 hist_quantile( &p->pdv, .5 ), hist_quantile( &p->pdv, .99 ),
+                 hist_quantile( &p->pdv, .999 ), p->pdv.max, (int)(PDV_WINDOW / CLOCK_FREQ) );
+}
@@ -0,0 +1,53 @@
+#ifndef _PDV_H_
+#define _PDV_H_
+
+#include <stdio.h>
+
+#include "stats.h"
+
+/*
+ * Packet delay variation metrics of RFC 5481.
+ *
+ * The one-way delay D(i) = arrival - send time is only known up to the
+ * clock offset, which both metrics cancel out:
+ *  - IPDV: D(i) - D(i-1) between consecutive sequence numbers, in
+ *          whichever order they arrive (up to PDV_REORDER apart),
+ *  - PDV:  D(i) - min D over the last PDV_WINDOW.
+ * Send times are abs-send-time when it is mapped, RTP timestamps
+ * otherwise. The sliding minimum is kept per slot of PDV_WINDOW / PDV_SLOTS.
+ */
+
+#define PDV_WINDOW      10000000    /* us */
+#define PDV_SLOTS       16
+#define PDV_REORDER     64          /* packets kept for their successor */
+
+struct _pdv_t
+{
+    uint32_t freq;
+
+    int      b_started;
+
+    /* D of the latest packets, by sequence number */
+    mtime_t  d_seq[PDV_REORDER];
+    int32_t  i_seq[PDV_REORDER];    /* -1 if none */
+
+    /* sliding minimum of D */
+    mtime_t  slot_min[PDV_SLOTS];
+    int64_t  i_slot;            /* slot number of the newest packet */
+
+    hist_t   ipdv, ipdv_neg;    /* us */
+    hist_t   pdv;               /* us */
+
+};
+
+pdv_t *pdv_create( uint32_t freq );
+void   pdv_destroy( pdv_t *p );
+
+/* one packet in arrival order, send_time < 0 if unknown,
+ * ext_ts: unwrapped RTP timestamp */
+void   pdv_update( pdv_t *p, uint16_t seq, mtime_t send_time, int64_t ext_ts,
+                   mtime_t arrival );
+
+void   pdv_report( const pdv_t *p, FILE *fp );
+
+#endif //_PDV_H_
@@ -0,0 +1,368 @@
+/**
+ * @file rtcp.c
+ * @brief RTCP compound packet parsing (RFC 3550, RFC 3611)
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_printf.h>
+#include <xrtp_bytes.h>
+
+#include "rtcp.h"
+#include "rtcpfb.h"
+#include "avsync.h"
+#include "session.h"
+
+/* XR block types */
+#define RTCP_XR_RRTR    4
+
+/**
+ * Initializes a new RTCP source.
+ */
+rtcp_source_t *
+rtcp_source_create ( uint32_t ssrc )
+{
+    rtcp_source_t *control;
+
+    control = (rtcp_source_t *)calloc( 1, sizeof(rtcp_source_t) );
+    if( control == NULL )
+        return NULL;
+
+    control->ssrc   = ssrc;
+    control->jitter = 0;
+
+    control->ref_rtp = 0;
+    control->ref_ntp = 1 << 6;
+    control->ref_rx  = 0;
+
+    control->rb.rtt  = -1;
+
+    return control;
+}
+
+/**
+ * Destroys an RTCP source.
+ */
+void
+rtcp_source_destroy( rtcp_source_t *control )
+{
+    if( control )
+        free( control );
+}
+
+uint32_t rtcp_timestamp( const block_t *block )
+{
+    assert( block->i_buffer >= 20 );
+    return GetDWBE( block->p_buffer + 16 );
+}
+
+const rtcp_sr_t *rtcp_last_sr( const rtcp_source_t *control )
+{
+    if( control == NULL || control->i_sr == 0 )
+        return NULL;
+
+    return &control->sr[(control->i_sr - 1) % RTCP_SR_HISTORY];
+}
+
+/**
+ * Gets the RTCP state of a known RTP source, creating it on first use.
+ * Reports about sources we never received RTP from are ignored.
+ */
+static rtcp_source_t *
+rtcp_control ( rtp_session_t *session, uint32_t ssrc )
+{
+    rtp_source_t *src = rtp_source_find( session, ssrc );
+
+    if( src == NULL )
+        return NULL;
+
+    if( src->control == NULL )
+        src->control = rtcp_source_create( ssrc );
+
+    return src->control;
+}
+
+static void
+rtcp_sender_report ( rtcp_source_t *control, const uint8_t *p, mtime_t now )
+{
+    rtcp_sr_t *sr = &control->sr[control->i_sr++ % RTCP_SR_HISTORY];
+
+    sr->ntp     = GetQWBE( p + 8 );
+    sr->rtp     = GetDWBE( p + 16 );
+    sr->packets = GetDWBE( p + 20 );
+    sr->octets  = GetDWBE( p + 24 );
+    sr->rx      = now;
+
+    control->ref_ntp = (mtime_t)sr->ntp;
+    control->ref_rtp = sr->rtp;
+    control->ref_rx  = now;
+}
+
+static void
+rtcp_report_block ( rtp_session_t *session, uint32_t reporter,
+                    const uint8_t *p, mtime_t now )
+{
+    rtcp_source_t *control = rtcp_control( session, GetDWBE( p ) );
+    rtcp_rb_t *rb;
+    uint32_t lost;
+    unsigned i;
+
+    if( control == NULL )
+        return;
+
+    rb = &control->rb;
+
+    lost = GetDWBE( p + 4 ) & 0xFFFFFF;
+
+    rb->reporter    = reporter;
+    rb->fraction    = p[4];
+    rb->lost        = (int32_t)(lost << 8) >> 8;   /* 24-bit signed */
+    rb->ext_max_seq = GetDWBE( p + 8 );
+    rb->jitter      = GetDWBE( p + 12 );
+    rb->lsr         = GetDWBE( p + 16 );
+    rb->dlsr        = GetDWBE( p + 20 );
+    rb->rx          = now;
+    rb->rtt         = -1;
+
+    /* RTT = arrival of this report - departure of the SR it echoes - DLSR,
+     * both instants measured at the capture point. */
+    for( i = 0; rb->lsr && i < RTCP_SR_HISTORY && i < control->i_sr; i++ )
+    {
+        const rtcp_sr_t *sr = &control->sr[i];
+
+        if( (uint32_t)(sr->ntp >> 16) == rb->lsr )
+        {
+            rb->rtt = now - sr->rx - (mtime_t)rb->dlsr * CLOCK_FREQ / 65536;
+            break;
+        }
+    }
+
+    control->i_rb++;
+}
+
+static void
+rtcp_sdes ( rtp_session_t *session, const uint8_t *p, int i_len )
+{
+    const uint8_t *start = p;
+    const uint8_t *end   = p + i_len;
+    int i_chunks = p[0] & 0x1F;
+
+    p += 4;
+
+    while( i_chunks-- > 0 && p + 4 <= end )
+    {
+        uint32_t ssrc = GetDWBE( p );
+        rtcp_source_t *control = rtcp_control( session, ssrc );
+
+        p += 4;
+
+        /* items, up to the null item */
+        while( p < end && p[0] != 0 )
+        {
+            if( p + 2 > end || p + 2 + p[1] > end )
+                return;
+
+            if( control && p[0] == 1 ) /* CNAME */
+            {
+                int b_new = strlen( control->cname ) != p[1]
+                         || memcmp( control->cname, p + 2, p[1] );
+
+                memcpy( control->cname, p + 2, p[1] );
+                control->cname[p[1]] = '\0';
+
+                /* pair on the SDES, not on every packet */
+                if( b_new && session->avsync )
+                    avsync_cname( session->avsync, session,
+                                  rtp_source_find( session, ssrc ) );
+            }
+
+            p += 2 + p[1];
+        }
+
+        if( control )
+            control->i_sdes++;
+
+        /* null item and padding to the next 32-bit boundary */
+        p += 4 - ((p - start) & 3);
+    }
+}
+
+static void
+rtcp_xr ( rtcp_source_t *control, const uint8_t *p, int i_len )
+{
+    const uint8_t *end = p + i_len;
+
+    control->i_xr++;
+
+    for( p += 8; p + 4 <= end; )
+    {
+        int i_block = 4 * (GetWBE( p + 2 ) + 1);
+
+        if( p + i_block > end )
+            break;
+
+        if( p[0] == RTCP_XR_RRTR && i_block >= 12 )
+            control->xr_rrtr = GetQWBE( p + 4 );
+
+        p += i_block;
+    }
+}
+
+/**
+ * Handles one packet of a compound RTCP packet.
+ */
+static int
+rtcp_packet ( rtp_session_t *session, const uint8_t *p, int i_len, mtime_t now )
+{
+    rtcp_source_t *control;
+    int i_count = p[0] & 0x1F;
+    int i;
+
+    switch( p[1] )
+    {
+        case RTCP_SR:
+            if( i_len < 28 + 24 * i_count )
+                return -1;
+
+            control = rtcp_control( session, GetDWBE( p + 4 ) );
+            if( control )
+                rtcp_sender_report( control, p, now );
+
+            for( i = 0; i < i_count; i++ )
+                rtcp_report_block( session, GetDWBE( p + 4 ), p + 28 + 24 * i, now );
+            break;
+
+        case RTCP_RR:
+            if( i_len < 8 + 24 * i_count )
+                return -1;
+
+            for( i = 0; i < i_count; i++ )
+                rtcp_report_block( session, GetDWBE( p + 4 ), p + 8 + 24 * i, now );
+            break;
+
+        case RTCP_SDES:
+            rtcp_sdes( session, p, i_len );
+            break;
+
+        case RTCP_BYE:
+            if( i_len < 4 + 4 * i_count )
+                return -1;
+
+            for( i = 0; i < i_count; i++ )
+            {
+                control = rtcp_control( session, GetDWBE( p + 4 + 4 * i ) );
+                if( control )
+                    control->i_bye++;
+            }
+            break;
+
+        case RTCP_APP:
+            if( i_len < 12 )
+                return -1;
+
+            control = rtcp_control( session, GetDWBE( p + 4 ) );
+            if( control )
+                control->i_app++;
+            break;
+
+        case RTCP_RTPFB:
+        case RTCP_PSFB:
+            return rtcp_fb_packet( session, p, i_len, now );
+
+        case RTCP_XR:
+            if( i_len < 8 )
+                return -1;
+
+            control = rtcp_control( session, GetDWBE( p + 4 ) );
+            if( control )
+                rtcp_xr( control, p, i_len );
+            break;
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+int
+rtcp_update ( rtp_session_t *session, block_t *block )
+{
+    const uint8_t *p   = block->p_buffer;
+    const uint8_t *end = block->p_buffer + block->i_buffer;
+
+    /* compound packet sanity checks (see RFC 3550 A.2):
+     * version 2 everywhere, lengths adding up to the datagram size */
+    if( block->i_buffer < 8 )
+        goto drop;
+
+    for( p = block->p_buffer; end - p >= 4; p += 4 * (GetWBE( p + 2 ) + 1) )
+    {
+        if( (p[0] >> 6) != 2 )
+            goto drop;
+    }
+
+    if( p != end )
+        goto drop;
+
+    for( p = block->p_buffer; p < end; )
+    {
+        int i_len = 4 * (GetWBE( p + 2 ) + 1);
+        int i_size = i_len;
+
+        /* only the last packet may be padded */
+        if( (p[0] & 0x20) && p + i_len == end )
+        {
+            if( p[i_len - 1] > i_len - 4 )
+                goto drop;
+
+            i_size -= p[i_len - 1];
+        }
+
+        if( rtcp_packet( session, p, i_size, block->i_sample_time ) < 0 )
+            xrtp_printf( XRTP_ERR, "rtcp_update> malformed packet (type %d).\n", p[1] );
+
+        p += i_len;
+    }
+
+    return 0;
+
+drop:
+
+    return -1;
+}
+
+void rtcp_source_report( const rtcp_source_t *control, uint32_t freq, FILE *fp )
+{
+    const rtcp_sr_t *sr = rtcp_last_sr( control );
+    const rtcp_rb_t *rb = &control->rb;
+
+    fprintf( fp, "  rtcp:   sr %u, rr %u, sdes %u, bye %u, app %u, xr %u\n",
+                 control->i_sr, control->i_rb, control->i_sdes,
+                 control->i_bye, control->i_app, control->i_xr );
+
+    if( control->cname[0] )
+        fprintf( fp, "  cname:  %s\n", control->cname );
+
+    if( sr )
+        fprintf( fp, "  sr:     ntp %u.%06u, rtp %u, packets %u, octets %u\n",
+                     (uint32_t)(sr->ntp >> 32),
+                     (uint32_t)(((sr->ntp & 0xFFFFFFFF) * 1000000) >> 32),
+                     sr->rtp, sr->packets, sr->octets );
+
+    if( control->i_rb )
+    {
+        fprintf( fp, "  rr:     from 0x%x, lost %.2f%% (cumulative %d), "
+                     "highest seq %u, jitter %u us",
+                     rb->reporter, rb->fraction * 100. / 256, rb->lost,
+                     rb->ext_max_seq,
+                     freq ? (uint32_t)((uint64_t)rb->jitter * CLOCK_FREQ / freq) : 0 );
+
+        if( rb->rtt >= 0 )
+            fprintf( fp, ", rtt %d us", (int)rb->rtt );
+
+        fprintf( fp, "\n" );
+    }
+}
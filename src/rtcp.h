@@ -0,0 +1,31 @@
+#ifndef _RTCP_H_
+#define _RTCP_H_
+
+#include <stdio.h>
+
+#include "xrtp.h"
+
+/* RTCP packet types */
+#define RTCP_SR         200
+#define RTCP_RR         201
+#define RTCP_SDES       202
+#define RTCP_BYE        203
+#define RTCP_APP        204
+#define RTCP_RTPFB      205
+#define RTCP_PSFB       206
+#define RTCP_XR         207
+
+uint32_t rtcp_timestamp( const block_t *block );
+
+/* parse every packet of a compound RTCP packet */
+int  rtcp_update ( rtp_session_t *session, block_t *block );
+
+rtcp_source_t *rtcp_source_create ( uint32_t ssrc );
+void rtcp_source_destroy( rtcp_source_t *control );
+
+/* latest sender report, NULL if none */
+const rtcp_sr_t *rtcp_last_sr( const rtcp_source_t *control );
+
+void rtcp_source_report( const rtcp_source_t *control, uint32_t freq, FILE *fp );
+
+#endif //_RTCP_H_
@@ -0,0 +1,427 @@
+/**
+ * @file rtcpfb.c
+ * @brief RTCP feedback decoding (RFC 4585, RFC 5104, RFC 8888,
+ *        draft-holmer-rmcat-transport-wide-cc-extensions, REMB)
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_printf.h>
+#include <xrtp_bytes.h>
+
+#include "rtcp.h"
+#include "rtcpfb.h"
+#include "session.h"
+
+/* transport layer feedback formats */
+#define RTPFB_NACK      1
+#define RTPFB_CCFB      11
+#define RTPFB_TWCC      15
+
+/* payload specific feedback formats */
+#define PSFB_PLI        1
+#define PSFB_FIR        4
+#define PSFB_AFB        15
+
+/* correlation slot flags */
+#define FB_SLOT_LOST        0x01
+#define FB_SLOT_NACKED      0x02
+#define FB_SLOT_REPAIRED    0x04
+
+static rtcp_fb_t *rtcp_fb_get ( rtp_source_t *src )
+{
+    if( src->fb == NULL )
+    {
+        src->fb = (rtcp_fb_t *)calloc( 1, sizeof(rtcp_fb_t) );
+        if( src->fb == NULL )
+            xrtp_printf( XRTP_ERR, "rtcp_fb_get> can't alloc feedback log.\n" );
+    }
+
+    return src->fb;
+}
+
+static rtcp_fb_t *rtcp_fb_find ( rtp_session_t *session, uint32_t ssrc )
+{
+    rtp_source_t *src = rtp_source_find( session, ssrc );
+
+    return src ? rtcp_fb_get( src ) : NULL;
+}
+
+static void rtcp_fb_log ( rtcp_fb_t *fb, uint8_t type, mtime_t now,
+                          uint16_t seq, uint16_t count, uint32_t value )
+{
+    rtcp_fb_event_t *ev = &fb->log[fb->i_log++ % RTCP_FB_LOG];
+
+    ev->rx    = now;
+    ev->type  = type;
+    ev->seq   = seq;
+    ev->count = count;
+    ev->value = value;
+}
+
+static void rtcp_fb_nack_seq ( rtcp_fb_t *fb, uint16_t seq, mtime_t now )
+{
+    rtcp_fb_slot_t *slot = &fb->slot[seq % RTCP_FB_SLOTS];
+
+    fb->i_nacked++;
+
+    if( slot->seq != seq || slot->flags == 0 )
+    {
+        slot->seq   = seq;
+        slot->flags = 0;
+    }
+
+    if( slot->flags & FB_SLOT_NACKED )
+    {
+        fb->i_renacked++;
+        return;
+    }
+
+    slot->flags |= FB_SLOT_NACKED;
+    slot->nack   = now;
+
+    if( slot->flags & FB_SLOT_LOST )
+        fb->i_lost_nacked++;
+}
+
+static void rtcp_fb_keyframe ( rtcp_fb_t *fb, mtime_t now )
+{
+    /* the (RTCP_FB_STORM - 1)th previous request */
+    mtime_t oldest = fb->kf[(fb->i_kf + 1) % RTCP_FB_STORM];
+
+    /* storm: RTCP_FB_STORM requests within one second, this one included */
+    if( fb->i_kf >= RTCP_FB_STORM - 1 && now - oldest < CLOCK_FREQ )
+    {
+        if( !fb->b_storm )
+            fb->i_storms++;
+        fb->b_storm = 1;
+    }
+    else
+        fb->b_storm = 0;
+
+    fb->kf[fb->i_kf++ % RTCP_FB_STORM] = now;
+}
+
+/* transport-wide CC: count the packets reported as received */
+static void rtcp_fb_twcc ( rtcp_fb_t *fb, const uint8_t *p, const uint8_t *end,
+                           mtime_t now )
+{
+    uint16_t base, i_status;
+    unsigned i_seen = 0, i_received = 0;
+
+    if( end - p < 8 )
+        return;
+
+    base     = GetWBE( p );
+    i_status = GetWBE( p + 2 );
+
+    for( p += 8; p + 2 <= end && i_seen < i_status; p += 2 )
+    {
+        uint16_t chunk = GetWBE( p );
+
+        if( !(chunk & 0x8000) )
+        {
+            /* run length chunk */
+            unsigned i_run = chunk & 0x1FFF;
+
+            if( i_run > (unsigned)(i_status - i_seen) )
+                i_run = i_status - i_seen;
+
+            if( (chunk >> 13) & 0x3 )
+                i_received += i_run;
+            i_seen += i_run;
+        }
+        else if( !(chunk & 0x4000) )
+        {
+            /* status vector, 14 one-bit symbols */
+            for( int i = 13; i >= 0 && i_seen < i_status; i--, i_seen++ )
+                i_received += (chunk >> i) & 1;
+        }
+        else
+        {
+            /* status vector, 7 two-bit symbols */
+            for( int i = 12; i >= 0 && i_seen < i_status; i -= 2, i_seen++ )
+                i_received += ((chunk >> i) & 3) != 0;
+        }
+    }
+
+    fb->i_twcc++;
+    fb->i_cc_reported += i_seen;
+    fb->i_cc_received += i_received;
+
+    rtcp_fb_log( fb, RTCP_FB_TWCC, now, base, i_status, i_received );
+}
+
+/* RFC 8888: one report block per media SSRC */
+static void rtcp_fb_ccfb ( rtp_session_t *session, const uint8_t *p,
+                           const uint8_t *end, mtime_t now )
+{
+    /* the report timestamp closes the packet */
+    end -= 4;
+
+    while( end - p >= 8 )
+    {
+        rtcp_fb_t *fb = rtcp_fb_find( session, GetDWBE( p ) );
+        uint16_t begin = GetWBE( p + 4 );
+        uint16_t i_reports = GetWBE( p + 6 );
+        unsigned i_received = 0;
+        int i;
+
+        p += 8;
+
+        if( end - p < 2 * i_reports )
+            return;
+
+        for( i = 0; i < i_reports; i++ )
+            i_received += p[2 * i] >> 7;   /* R bit */
+
+        if( fb )
+        {
+            fb->i_ccfb++;
+            fb->i_cc_reported += i_reports;
+            fb->i_cc_received += i_received;
+
+            rtcp_fb_log( fb, RTCP_FB_CCFB, now, begin, i_reports, i_received );
+        }
+
+        /* metric blocks are padded to 32 bits */
+        p += 2 * i_reports + 2 * (i_reports & 1);
+    }
+}
+
+int
+rtcp_fb_packet ( rtp_session_t *session, const uint8_t *p, int i_len, mtime_t now )
+{
+    const uint8_t *end = p + i_len;
+    const uint8_t *fci = p + 12;
+    uint8_t fmt = p[0] & 0x1F;
+    rtcp_fb_t *fb;
+
+    if( i_len < 8 )
+        return -1;
+
+    /* RFC 8888 has no media source field */
+    if( p[1] == RTCP_RTPFB && fmt == RTPFB_CCFB )
+    {
+        rtcp_fb_ccfb( session, p + 8, end, now );
+        return 0;
+    }
+
+    if( i_len < 12 )
+        return -1;
+
+    if( p[1] == RTCP_RTPFB )
+    {
+        fb = rtcp_fb_find( session, GetDWBE( p + 8 ) );
+        if( fb == NULL )
+            return 0;
+
+        switch( fmt )
+        {
+            case RTPFB_NACK:
+                for( ; end - fci >= 4; fci += 4 )
+                {
+                    uint16_t pid = GetWBE( fci );
+                    uint16_t blp = GetWBE( fci + 2 );
+                    uint16_t i_count = 1;
+
+                    rtcp_fb_nack_seq( fb, pid, now );
+                    for( int i = 0; i < 16; i++ )
+                    {
+                        if( blp & (1 << i) )
+                        {
+                            rtcp_fb_nack_seq( fb, (uint16_t)(pid + i + 1), now );
+                            i_count++;
+                        }
+                    }
+
+                    rtcp_fb_log( fb, RTCP_FB_NACK, now, pid, i_count, blp );
+                }
+                fb->i_nack++;
+                break;
+
+            case RTPFB_TWCC:
+                rtcp_fb_twcc( fb, fci, end, now );
+                break;
+
+            default:
+                break;
+        }
+    }
+    else if( p[1] == RTCP_PSFB )
+    {
+        switch( fmt )
+        {
+            case PSFB_PLI:
+                fb = rtcp_fb_find( session, GetDWBE( p + 8 ) );
+                if( fb == NULL )
+                    break;
+
+                fb->i_pli++;
+                rtcp_fb_keyframe( fb, now );
+                rtcp_fb_log( fb, RTCP_FB_PLI, now, 0, 0, 0 );
+                break;
+
+            case PSFB_FIR:
+                /* the target SSRCs are in the FCI entries */
+                for( ; end - fci >= 8; fci += 8 )
+                {
+                    fb = rtcp_fb_find( session, GetDWBE( fci ) );
+                    if( fb == NULL )
+                        continue;
+
+                    fb->i_fir++;
+                    rtcp_fb_keyframe( fb, now );
+                    rtcp_fb_log( fb, RTCP_FB_FIR, now, fci[4], 0, 0 );
+                }
+                break;
+
+            case PSFB_AFB:
+                if( end - fci >= 8 && !memcmp( fci, "REMB", 4 ) )
+                {
+                    int i_ssrc = fci[4];
+                    uint32_t mantissa = ((fci[5] & 0x3) << 16) | GetWBE( fci + 6 );
+                    uint8_t  exponent = fci[5] >> 2;
+                    uint64_t br = exponent > 46 ? UINT64_MAX : (uint64_t)mantissa << exponent;
+                    uint32_t bitrate = br > UINT32_MAX ? UINT32_MAX : (uint32_t)br;
+
+                    for( fci += 8; i_ssrc-- > 0 && end - fci >= 4; fci += 4 )
+                    {
+                        fb = rtcp_fb_find( session, GetDWBE( fci ) );
+                        if( fb == NULL )
+                            continue;
+
+                        if( fb->i_remb == 0 || bitrate < fb->remb_min )
+                            fb->remb_min = bitrate;
+                        if( bitrate > fb->remb_max )
+                            fb->remb_max = bitrate;
+                        fb->remb_last = bitrate;
+                        fb->i_remb++;
+
+                        rtcp_fb_log( fb, RTCP_FB_REMB, now, 0, 0, bitrate );
+                    }
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Marks i_count packets starting at first as lost, called by rtp_decode().
+ */
+void rtcp_fb_lost ( rtp_source_t *src, uint16_t first, int i_count )
+{
+    rtcp_fb_t *fb = rtcp_fb_get( src );
+
+    if( fb == NULL )
+        return;
+
+    /* only the last RTCP_FB_SLOTS can still be correlated */
+    if( i_count > RTCP_FB_SLOTS )
+    {
+        fb->i_lost += i_count - RTCP_FB_SLOTS;
+        first += (uint16_t)(i_count - RTCP_FB_SLOTS);
+        i_count = RTCP_FB_SLOTS;
+    }
+
+    for( ; i_count > 0; i_count--, first++ )
+    {
+        rtcp_fb_slot_t *slot = &fb->slot[first % RTCP_FB_SLOTS];
+
+        fb->i_lost++;
+
+        if( slot->seq != first )
+        {
+            slot->seq   = first;
+            slot->flags = 0;
+        }
+
+        if( (slot->flags & (FB_SLOT_NACKED | FB_SLOT_LOST)) == FB_SLOT_NACKED )
+            fb->i_lost_nacked++;
+
+        slot->flags |= FB_SLOT_LOST;
+    }
+}
+
+/**
+ * Notes the arrival of a packet, called by rtp_queue().
+ */
+void rtcp_fb_received ( rtp_source_t *src, uint16_t seq, mtime_t now )
+{
+    rtcp_fb_t *fb = src->fb;
+    rtcp_fb_slot_t *slot;
+    mtime_t rtt;
+
+    if( fb == NULL )
+        return;
+
+    slot = &fb->slot[seq % RTCP_FB_SLOTS];
+    if( slot->seq != seq || (slot->flags & (FB_SLOT_NACKED | FB_SLOT_REPAIRED))
+                            != FB_SLOT_NACKED )
+        return;
+
+    slot->flags |= FB_SLOT_REPAIRED;
+
+    rtt = now - slot->nack;
+    if( fb->i_repaired == 0 || rtt < fb->repair_min )
+        fb->repair_min = rtt;
+    if( rtt > fb->repair_max )
+        fb->repair_max = rtt;
+    fb->repair_sum += rtt;
+    fb->i_repaired++;
+}
+
+void rtcp_fb_destroy ( rtcp_fb_t *fb )
+{
+    if( fb )
+        free( fb );
+}
+
+void rtcp_fb_report ( const rtcp_fb_t *fb, FILE *fp )
+{
+    static const char *name[] = { "?", "nack", "pli", "fir", "remb", "twcc", "ccfb" };
+    unsigned i, i_first;
+
+    fprintf( fp, "  fb:     nack %u, pli %u, fir %u, remb %u, twcc %u, ccfb %u\n",
+                 fb->i_nack, fb->i_pli, fb->i_fir, fb->i_remb, fb->i_twcc, fb->i_ccfb );
+
+    fprintf( fp, "  nack:   lost %u, requested %u (%u again), lost and requested %u, "
+                 "repaired %u",
+                 fb->i_lost, fb->i_nacked, fb->i_renacked, fb->i_lost_nacked,
+                 fb->i_repaired );
+    if( fb->i_repaired )
+        fprintf( fp, ", repair rtt min/avg/max %d/%d/%d us",
+                     (int)fb->repair_min, (int)(fb->repair_sum / fb->i_repaired),
+                     (int)fb->repair_max );
+    fprintf( fp, "\n" );
+
+    if( fb->i_pli + fb->i_fir )
+        fprintf( fp, "  kf:     requests %u, storms %u (%d+ within 1 s)\n",
+                     fb->i_pli + fb->i_fir, fb->i_storms, RTCP_FB_STORM );
+
+    if( fb->i_remb )
+        fprintf( fp, "  remb:   last %u, min %u, max %u bit/s\n",
+                     fb->remb_last, fb->remb_min, fb->remb_max );
+
+    if( fb->i_cc_reported )
+        fprintf( fp, "  cc:     reported %llu, received %llu\n",
+                     (unsigned long long)fb->i_cc_reported,
+                     (unsigned long long)fb->i_cc_received );
+
+    /* tail of the event log */
+    i_first = fb->i_log > 8 ? fb->i_log - 8 : 0;
+    for( i = i_first; i < fb->i_log; i++ )
+    {
+        const rtcp_fb_event_t *ev = &fb->log[i % RTCP_FB_LOG];
+
+        fprintf( fp, "    %12lld us %-4s seq %5u count %5u value %u\n",
+                     (long long)ev->rx, name[ev->type], ev->seq, ev->count, ev->value );
+    }
+}
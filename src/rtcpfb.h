@@ -0,0 +1,88 @@
+#ifndef _RTCPFB_H_
+#define _RTCPFB_H_
+
+#include <stdio.h>
+
+#include "xrtp.h"
+
+/*
+ * RTCP feedback (RFC 4585 and friends): generic NACK, PLI, FIR, REMB,
+ * transport-wide CC and RFC 8888 congestion control feedback.
+ *
+ * Messages are logged per media SSRC and correlated with the losses seen
+ * by rtp_decode(): NACK coverage, repair round trip time and keyframe
+ * request storms. All the state is fixed size.
+ */
+
+#define RTCP_FB_NACK        1
+#define RTCP_FB_PLI         2
+#define RTCP_FB_FIR         3
+#define RTCP_FB_REMB        4
+#define RTCP_FB_TWCC        5
+#define RTCP_FB_CCFB        6
+
+#define RTCP_FB_LOG         64      /* events kept per source */
+#define RTCP_FB_SLOTS       512     /* loss/NACK correlation window, packets */
+#define RTCP_FB_STORM       3       /* keyframe requests within 1 s making a storm */
+
+typedef struct _rtcp_fb_event_t
+{
+    mtime_t  rx;        /* capture time of the feedback */
+    uint32_t value;     /* REMB: bit/s, TWCC/CCFB: packets received */
+    uint16_t seq;       /* NACK/TWCC/CCFB: first sequence, FIR: command seq */
+    uint16_t count;     /* NACK/TWCC/CCFB: packets covered */
+    uint8_t  type;      /* RTCP_FB_* */
+
+}rtcp_fb_event_t;
+
+typedef struct _rtcp_fb_slot_t
+{
+    mtime_t  nack;      /* time of the first NACK */
+    uint16_t seq;
+    uint8_t  flags;
+
+}rtcp_fb_slot_t;
+
+struct _rtcp_fb_t
+{
+    rtcp_fb_event_t log[RTCP_FB_LOG];
+    unsigned        i_log;
+
+    rtcp_fb_slot_t  slot[RTCP_FB_SLOTS];
+
+    /* messages */
+    unsigned i_nack, i_pli, i_fir, i_remb, i_twcc, i_ccfb;
+
+    /* NACK correlation */
+    unsigned i_nacked;          /* packets requested */
+    unsigned i_renacked;        /* repeated requests */
+    unsigned i_lost;            /* gaps seen by rtp_decode() */
+    unsigned i_lost_nacked;     /* ... that were requested */
+    unsigned i_repaired;        /* requested packets received afterwards */
+    mtime_t  repair_min, repair_max, repair_sum;
+
+    /* keyframe requests */
+    mtime_t  kf[RTCP_FB_STORM];
+    unsigned i_kf;
+    unsigned i_storms;
+    uint8_t  b_storm;
+
+    /* REMB */
+    uint32_t remb_last, remb_min, remb_max;
+
+    /* TWCC / CCFB */
+    uint64_t i_cc_reported, i_cc_received;
+
+};
+
+/* one RTPFB or PSFB packet */
+int  rtcp_fb_packet ( rtp_session_t *session, const uint8_t *p, int i_len, mtime_t now );
+
+/* hooks from the RTP path */
+void rtcp_fb_lost ( rtp_source_t *src, uint16_t first, int i_count );
+void rtcp_fb_received ( rtp_source_t *src, uint16_t seq, mtime_t now );
+
+void rtcp_fb_destroy ( rtcp_fb_t *fb );
+void rtcp_fb_report ( const rtcp_fb_t *fb, FILE *fp );
+
+#endif //_RTCPFB_H_
@@ -1,39 +1,68 @@
 #include <assert.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <xrtp_printf.h>
+#include <xrtp_bytes.h>
 
 #include "rtp.h"
 #include "payload.h"
 #include "session.h"
+#include "rtcp.h"
+#include "worker.h"
+#include "avsync.h"
+#include "writer.h"
 
-xrtp *xrtp_create( payload_des *des, uint8_t b_mux, uint8_t b_print )
+xrtp *xrtp_create( payload_des *des, const xrtp_param_t *param )
 {
     xrtp *h;
     payload_des *p;
 
-    h = (xrtp *)malloc( sizeof(xrtp) );
+    h = (xrtp *)calloc( 1, sizeof(xrtp) );
     if( h == NULL )
     {
         xrtp_printf( XRTP_ERR, "xrtp_create> can't alloc struct xrtp.\n" );
         goto err_xrtp_create;
     }
 
-    h->session = rtp_session_create();
+    /* initialization */
+    h->descript     = NULL;
+    h->max_dropout  = 
+    h->max_misorder = 1000;
+    h->param        = *param;
+    h->pool         = NULL;
+    h->i_last_time  = 0;
+    h->b_first_line = 1;
+
+    if( h->param.i_threads > 1 && h->param.b_print_out )
+    {
+        /* per-packet printing relies on the capture order */
+        xrtp_printf( XRTP_ERR, "xrtp_create> -r needs a single thread, threads ignored.\n" );
+        h->param.i_threads = 1;
+    }
+
+    if( ( h->param.b_avsync_cname || h->param.i_avsync ) && h->param.i_threads > 1 )
+    {
+        /* pairs of sources are analysed together */
+        xrtp_printf( XRTP_ERR, "xrtp_create> -l needs a single thread, threads ignored.\n" );
+        h->param.i_threads = 1;
+    }
+
+    /* with workers the sources live in the worker sessions, which have
+     * their own writers */
+    h->session = rtp_session_create( h->param.i_threads <= 1 );
     if( h->session == NULL )
     {
         xrtp_printf( XRTP_ERR, "xrtp_create> can't create session.\n" );
         goto err_xrtp_create;
     }
 
-    /* initialization */
-    h->descript     = NULL;
-    h->max_dropout  = 
-    h->max_misorder = 1000;
-    h->b_mux        = b_mux;
-    h->b_print_out  = b_print;  
-    h->b_first_line = 1;
+    if( h->param.b_avsync_cname || h->param.i_avsync )
+    {
+        h->session->avsync = avsync_create( h->param.avsync, h->param.i_avsync,
+                                            h->param.b_avsync_cname );
+    }
 
     /* copy descript list */
     while( des )
@@ -58,11 +87,24 @@ xrtp *xrtp_create( payload_des *des, uint8_t b_mux, uint8_t b_print )
 
         des = des->next;
     }    
+
+    if( h->param.i_threads > 1 )
+    {
+        h->pool = worker_pool_create( h, h->param.i_threads );
+        if( h->pool == NULL )
+        {
+            xrtp_printf( XRTP_ERR, "xrtp_create> can't create worker pool.\n" );
+            goto err_xrtp_create;
+        }
+    }
     
     return h;
 
 err_xrtp_create:
 
+    if( h == NULL )
+        return (xrtp *)NULL;
+
     for( p = h->descript; p;  )
     {
         payload_des *temp = p;
@@ -91,6 +133,9 @@ void xrtp_free( xrtp *handle )
         free( temp );
     }    
 
+    if( h->pool )
+        worker_pool_destroy( h->pool );
+
     if( h->session )
         rtp_session_destroy( h->session );
 
@@ -117,7 +162,7 @@ int xrtp_process( xrtp *handle, uint64_t l_number, mtime_t time,
         goto err_xrtp_process;
     }
 
-    uint8_t mux_offset = 0 + 4 * !!handle->b_mux;
+    uint8_t mux_offset = 0 + 4 * !!handle->param.b_mux;
     if( block_init( block, buf + mux_offset, i_len - mux_offset, time ) < 0 )
     {
         xrtp_printf( XRTP_ERR, "xrtp_process> init block failed.\n" );
@@ -125,18 +170,30 @@ int xrtp_process( xrtp *handle, uint64_t l_number, mtime_t time,
         goto err_xrtp_process;
     }
 
+    if( rtp_type == 0 && rtp_ptype( block ) >= 72 && rtp_ptype( block ) <= 76 )
+    {
+        xrtp_printf( XRTP_ERR, "xrtp_process> not rtp.\n" );
+        ret = XRTP_ERR_NOTRTP;
+        goto err_xrtp_process;
+    }
+
+    /* sharded mode: the owning worker does the rest */
+    if( h->pool )
+    {
+        mtime_t prev = h->i_last_time;
+
+        h->i_last_time = time;
+
+        if( worker_pool_push( h->pool, block, rtp_type, prev ) < 0 )
+            return XRTP_ERR_RTP_ERROR;
+
+        return XRTP_ERR_OK;
+    }
+
     /* queue */
     if( rtp_type == 0 ) // rtp
     {
-        uint8_t b_payload_type = rtp_ptype( block );
-        if( b_payload_type >= 72 && b_payload_type <= 76 )
-        {
-            xrtp_printf( XRTP_ERR, "xrtp_process> not rtp.\n" );
-            ret = XRTP_ERR_NOTRTP;
-            goto err_xrtp_process;
-        }
-
-        if( rtp_queue( h, block ) < 0 )
+        if( rtp_queue( h, h->session, block ) < 0 )
         {
             xrtp_printf( XRTP_ERR, "xrtp_process> queue failed.\n" );
             ret = XRTP_ERR_RTP_ERROR;
@@ -154,7 +211,7 @@ int xrtp_process( xrtp *handle, uint64_t l_number, mtime_t time,
     }
 
     /* print out every block */
-    if( h->b_print_out )
+    if( h->param.b_print_out )
     {
         uint8_t b_payload_type = rtp_ptype( block );
         char rtcp[64]      = { '\0' };
@@ -172,9 +229,16 @@ int xrtp_process( xrtp *handle, uint64_t l_number, mtime_t time,
         else if( rtp_type == 1 )
         {
             sprintf( rtcp,      "+" );
-            sprintf( ntp,       "%I64u", h->session->control->ref_ntp );
-            sprintf( timestamp, "%u",    rtcp_timestamp( block ) );
+            sprintf( ntp,       "-" );
+            sprintf( timestamp, "-" );
             sprintf( pts_pcr,   "-" );
+
+            /* compound packets start with a SR or a RR */
+            if( block->p_buffer[1] == RTCP_SR && block->i_buffer >= 28 )
+            {
+                sprintf( ntp,       "%" PRIu64, GetQWBE( block->p_buffer + 8 ) );
+                sprintf( timestamp, "%u",    rtcp_timestamp( block ) );
+            }
         }
 
         if( h->b_first_line )
@@ -194,17 +258,21 @@ int xrtp_process( xrtp *handle, uint64_t l_number, mtime_t time,
     }
 
     /* dequeue rtp */
-    if( rtp_dequeue( h->session, time ) < 0 )
+    if( rtp_dequeue( h, h->session, time ) < 0 )
     {
         xrtp_printf( XRTP_ERR, "xrtp_process> dequeue failed.\n" );
         goto err_xrtp_process;        
     }
 
+    /* rtcp blocks are not queued */
+    if( rtp_type == 1 )
+        block_free( block );
+
     return XRTP_ERR_OK;
 
 err_xrtp_process:
 
-    if( h->b_print_out )
+    if( h->param.b_print_out )
     {
         fprintf( stdout, "%5I64d, ----\n", l_number );
     }
@@ -216,13 +284,71 @@ err_xrtp_process:
 int xrtp_flush( xrtp *handle )
 {
     xrtp *h = handle;
+
+    if( h->pool )
+        return worker_pool_flush( h->pool );
     
-    if( rtp_dequeue( h->session, _I64_MAX ) < 0 )
+    if( rtp_dequeue( h, h->session, _I64_MAX ) < 0 )
     {
         xrtp_printf( XRTP_ERR, "xrtp_process> dequeue failed.\n" );
         return -1;  
     }
 
+    /* what the writer has is on disk on return */
+    if( h->session->writer && output_sync( h->session->writer ) < 0 )
+        return -1;
+
     return 0;
 }
 
+static int source_cmp( const void *a, const void *b )
+{
+    const rtp_source_t *x = *(const rtp_source_t **)a;
+    const rtp_source_t *y = *(const rtp_source_t **)b;
+
+    return x->ssrc < y->ssrc ? -1 : x->ssrc > y->ssrc;
+}
+
+int xrtp_report( xrtp *handle, FILE *fp )
+{
+    xrtp *h = handle;
+    rtp_source_t **srcv;
+    unsigned srcc = 0, i;
+    int i_sessions = h->pool ? worker_pool_count( h->pool ) : 1;
+    int k;
+
+    for( k = 0; k < i_sessions; k++ )
+        srcc += h->pool ? worker_pool_session( h->pool, k )->srcc : h->session->srcc;
+
+    if( srcc == 0 )
+        return 0;
+
+    srcv = (rtp_source_t **)malloc( sizeof(rtp_source_t *) * srcc );
+    if( srcv == NULL )
+    {
+        xrtp_printf( XRTP_ERR, "xrtp_report> can't alloc sources.\n" );
+        return -1;
+    }
+
+    /* sources of all the shards, ordered by ssrc */
+    for( srcc = 0, k = 0; k < i_sessions; k++ )
+    {
+        rtp_session_t *session = h->pool ? worker_pool_session( h->pool, k )
+                                         : h->session;
+
+        for( i = 0; i < session->srcc; i++ )
+            srcv[srcc++] = session->srcv[i];
+    }
+
+    qsort( srcv, srcc, sizeof(rtp_source_t *), source_cmp );
+
+    for( i = 0; i < srcc; i++ )
+        rtp_source_report( srcv[i], fp );
+
+    if( h->session->avsync )
+        avsync_report( h->session->avsync, fp );
+
+    free( srcv );
+
+    return 0;
+}
@@ -1,6 +1,8 @@
 #ifndef _RTP_H_
 #define _RTP_H_
 
+#include <stdio.h>
+
 #include <datatype.h>
 
 #include "sdp.h"
@@ -15,11 +17,13 @@
 #define XRTP_ERR_RTCP_ERROR     -101
 
 /* xrtp */
-xrtp *xrtp_create( payload_des *des, uint8_t b_mux, uint8_t b_print );
+xrtp *xrtp_create( payload_des *des, const xrtp_param_t *param );
 int xrtp_process( xrtp *handle, uint64_t l_number, mtime_t time,
                               uint8_t *buf, int i_len, 
                               uint8_t rtp_type );
 int xrtp_flush( xrtp *handle );
+/* end of run summary, per source */
+int xrtp_report( xrtp *handle, FILE *fp );
 void xrtp_free( xrtp *handle );
 
 #endif _RTP_H_
\ No newline at end of file
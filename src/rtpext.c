@@ -0,0 +1,298 @@
+/**
+ * @file rtpext.c
+ * @brief RTP header extensions (RFC 8285)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_printf.h>
+#include <xrtp_bytes.h>
+
+#include "rtpext.h"
+#include "session.h"
+
+#define RTP_EXT_PROFILE_ONE_BYTE    0xBEDE
+#define RTP_EXT_PROFILE_TWO_BYTE    0x1000  /* 0x100 + 4-bit appbits */
+
+static const struct
+{
+    const char *name;
+    const char *uri;
+} ext_table[RTP_EXT_MAX] =
+{
+    { "none",               "" },
+    { "abs-send-time",      "http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time" },
+    { "transport-cc",       "http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01" },
+    { "audio-level",        "urn:ietf:params:rtp-hdrext:ssrc-audio-level" },
+    { "video-orientation",  "urn:3gpp:video-orientation" },
+    { "mid",                "urn:ietf:params:rtp-hdrext:sdes:mid" },
+    { "toffset",            "urn:ietf:params:rtp-hdrext:toffset" },
+};
+
+const char *rtp_ext_name( int type )
+{
+    if( type <= RTP_EXT_NONE || type >= RTP_EXT_MAX )
+        return "unknown";
+
+    return ext_table[type].name;
+}
+
+int rtp_ext_map( uint8_t *extmap, const char *psz )
+{
+    char *end;
+    long id = strtol( psz, &end, 10 );
+    int  i;
+
+    /* one-byte IDs are 1..14, two-byte IDs 1..255 */
+    if( end == psz || *end != ':' || id < 1 || id > 255 )
+        return -1;
+
+    for( i = RTP_EXT_NONE + 1; i < RTP_EXT_MAX; i++ )
+    {
+        if( !strcmp( end + 1, ext_table[i].name ) || !strcmp( end + 1, ext_table[i].uri ) )
+        {
+            extmap[id] = (uint8_t)i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Decodes one element of a known type.
+ */
+static void
+rtp_ext_element ( rtp_ext_t *ext, int type, const uint8_t *p, int i_len )
+{
+    switch( type )
+    {
+        case RTP_EXT_ABS_SEND_TIME:
+            if( i_len < 3 )
+                return;
+            ext->abs_send_time = (p[0] << 16) | (p[1] << 8) | p[2];
+            break;
+
+        case RTP_EXT_TRANSPORT_CC:
+            if( i_len < 2 )
+                return;
+            ext->transport_seq = GetWBE( p );
+            break;
+
+        case RTP_EXT_AUDIO_LEVEL:
+            ext->b_voice     = p[0] >> 7;
+            ext->audio_level = p[0] & 0x7F;
+            break;
+
+        case RTP_EXT_VIDEO_ORIENT:
+            /* C F R1 R0, rotation counter clockwise */
+            ext->b_flip   = (p[0] >> 2) & 1;
+            ext->rotation = (p[0] & 3) * 90;
+            break;
+
+        case RTP_EXT_MID:
+            if( i_len > RTP_EXT_MID_MAXIMUM )
+                i_len = RTP_EXT_MID_MAXIMUM;
+            memcpy( ext->mid, p, i_len );
+            ext->mid[i_len] = '\0';
+            break;
+
+        case RTP_EXT_TOFFSET:
+            if( i_len < 3 )
+                return;
+            ext->toffset = (int32_t)(((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8)) >> 8;
+            break;
+
+        default:
+            return;
+    }
+
+    ext->flags |= 1u << type;
+}
+
+int rtp_ext_parse( const uint8_t *pkt, int i_offset, int i_len,
+                   const uint8_t *extmap, rtp_ext_t *ext )
+{
+    const uint8_t *p, *end;
+    uint16_t profile;
+    int i_size;
+    int b_two_byte;
+
+    ext->i_count = 0;
+    ext->flags   = 0;
+
+    if( i_len < i_offset + 4 )
+        return -1;
+
+    profile = GetWBE( pkt + i_offset );
+    i_size  = 4 + 4 * GetWBE( pkt + i_offset + 2 );
+
+    if( i_len < i_offset + i_size )
+        return -1;
+
+    if( profile == RTP_EXT_PROFILE_ONE_BYTE )
+        b_two_byte = 0;
+    else if( (profile & 0xFFF0) == RTP_EXT_PROFILE_TWO_BYTE )
+        b_two_byte = 1;
+    else
+        return i_size; /* not RFC 8285, opaque */
+
+    p   = pkt + i_offset + 4;
+    end = pkt + i_offset + i_size;
+
+    while( p < end )
+    {
+        int id, len;
+
+        if( p[0] == 0 )
+        {   /* padding */
+            p++;
+            continue;
+        }
+
+        if( b_two_byte )
+        {
+            if( p + 2 > end )
+                break;
+            id  = p[0];
+            len = p[1];
+            p  += 2;
+        }
+        else
+        {
+            id  = p[0] >> 4;
+            len = (p[0] & 0x0F) + 1;
+            p  += 1;
+
+            if( id == 15 ) /* reserved, stop parsing */
+                break;
+        }
+
+        if( p + len > end )
+            break;          /* truncated element, keep what we have */
+
+        if( ext->i_count < RTP_EXT_ENTRY_MAXIMUM )
+        {
+            ext->entry[ext->i_count].id     = (uint8_t)id;
+            ext->entry[ext->i_count].len    = (uint8_t)len;
+            ext->entry[ext->i_count].offset = (uint16_t)(p - pkt);
+            ext->i_count++;
+        }
+
+        if( extmap && extmap[id] && len > 0 )
+            rtp_ext_element( ext, extmap[id], p, len );
+
+        p += len;
+    }
+
+    return i_size;
+}
+
+rtp_ext_source_t *rtp_ext_source_create( void )
+{
+    return (rtp_ext_source_t *)calloc( 1, sizeof(rtp_ext_source_t) );
+}
+
+void rtp_ext_source_destroy( rtp_ext_source_t *es )
+{
+    if( es )
+        free( es );
+}
+
+void rtp_ext_update( rtp_ext_source_t *es, rtp_ext_t *ext, mtime_t now )
+{
+    int i;
+
+    ext->send_time = -1;
+    es->i_total++;
+
+    for( i = RTP_EXT_NONE + 1; i < RTP_EXT_MAX; i++ )
+    {
+        if( ext->flags & (1u << i) )
+            es->i_packets[i]++;
+    }
+
+    if( ext->flags & (1u << RTP_EXT_ABS_SEND_TIME) )
+    {
+        mtime_t owd;
+
+        /* 24-bit, 6.18 fixed point seconds: wraps every 64 s */
+        if( es->i_packets[RTP_EXT_ABS_SEND_TIME] == 1 )
+            es->send_ext = ext->abs_send_time;
+        else
+            es->send_ext += (int32_t)((ext->abs_send_time - es->send_last) << 8) >> 8;
+        es->send_last = ext->abs_send_time;
+
+        ext->send_time = (es->send_ext * CLOCK_FREQ) >> 18;
+
+        /* one-way delay up to the unknown clock offset */
+        owd = now - ext->send_time;
+        if( es->i_packets[RTP_EXT_ABS_SEND_TIME] == 1 )
+        {
+            es->owd_min = es->owd_max = owd;
+        }
+        else
+        {
+            mtime_t d = owd - es->owd_last;
+
+            if( d < 0 ) d = -d;
+            es->owd_jitter += (uint32_t)(((d - es->owd_jitter) + 8) >> 4);
+
+            if( owd < es->owd_min ) es->owd_min = owd;
+            if( owd > es->owd_max ) es->owd_max = owd;
+        }
+        es->owd_last = owd;
+    }
+
+    if( ext->flags & (1u << RTP_EXT_TRANSPORT_CC) )
+    {
+        if( es->i_packets[RTP_EXT_TRANSPORT_CC] == 1 )
+            es->twcc_first = ext->transport_seq;
+        es->twcc_last = ext->transport_seq;
+    }
+
+    if( ext->flags & (1u << RTP_EXT_AUDIO_LEVEL) )
+    {
+        es->level_sum += ext->audio_level;
+        es->i_voice   += ext->b_voice;
+    }
+
+    if( ext->flags & (1u << RTP_EXT_VIDEO_ORIENT) )
+        es->rotation = ext->rotation;
+
+    if( ext->flags & (1u << RTP_EXT_MID) )
+        memcpy( es->mid, ext->mid, sizeof(es->mid) );
+}
+
+void rtp_ext_report( const rtp_ext_source_t *es, FILE *fp )
+{
+    const uint32_t *n = es->i_packets;
+    int i;
+
+    fprintf( fp, "  ext:    packets %u", es->i_total );
+    for( i = RTP_EXT_NONE + 1; i < RTP_EXT_MAX; i++ )
+    {
+        if( n[i] )
+            fprintf( fp, ", %s %u", ext_table[i].name, n[i] );
+    }
+    fprintf( fp, "\n" );
+
+    if( n[RTP_EXT_ABS_SEND_TIME] > 1 )
+        fprintf( fp, "  owd:    variation %d us (max - min), jitter %u us\n",
+                     (int)(es->owd_max - es->owd_min), es->owd_jitter );
+
+    if( n[RTP_EXT_TRANSPORT_CC] )
+        fprintf( fp, "  twcc:   seq %u..%u\n", es->twcc_first, es->twcc_last );
+
+    if( n[RTP_EXT_AUDIO_LEVEL] )
+        fprintf( fp, "  level:  avg -%u dBov, voice %.1f%%\n",
+                     (unsigned)(es->level_sum / n[RTP_EXT_AUDIO_LEVEL]),
+                     es->i_voice * 100. / n[RTP_EXT_AUDIO_LEVEL] );
+
+    if( n[RTP_EXT_VIDEO_ORIENT] )
+        fprintf( fp, "  cvo:    rotation %u\n", es->rotation );
+
+    if( n[RTP_EXT_MID] )
+        fprintf( fp, "  mid:    %s\n", es->mid );
+}
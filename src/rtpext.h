@@ -0,0 +1,94 @@
+#ifndef _RTPEXT_H_
+#define _RTPEXT_H_
+
+#include <stdio.h>
+
+#include <datatype.h>
+
+/*
+ * RTP header extensions (RFC 8285), one-byte and two-byte forms.
+ *
+ * The extension IDs are negotiated in SDP (a=extmap), so the ID to URI
+ * map has to be given by the user. Every element is listed in the
+ * per-block table, the known ones are decoded as well.
+ */
+
+#define RTP_EXT_NONE            0
+#define RTP_EXT_ABS_SEND_TIME   1
+#define RTP_EXT_TRANSPORT_CC    2
+#define RTP_EXT_AUDIO_LEVEL     3
+#define RTP_EXT_VIDEO_ORIENT    4
+#define RTP_EXT_MID             5
+#define RTP_EXT_TOFFSET         6
+#define RTP_EXT_MAX             7
+
+#define RTP_EXT_ENTRY_MAXIMUM   16
+#define RTP_EXT_MID_MAXIMUM     16
+
+/** Extensions of one packet */
+typedef struct _rtp_ext_t
+{
+    uint8_t  i_count;
+    struct
+    {
+        uint8_t  id;
+        uint8_t  len;
+        uint16_t offset;            /* from the start of the RTP packet */
+    } entry[RTP_EXT_ENTRY_MAXIMUM];
+
+    uint32_t flags;                 /* (1 << RTP_EXT_*) of decoded elements */
+
+    uint32_t abs_send_time;         /* 6.18 fixed point seconds */
+    uint16_t transport_seq;
+    uint8_t  audio_level;           /* -dBov */
+    uint8_t  b_voice;
+    uint16_t rotation;              /* degrees */
+    uint8_t  b_flip;
+    int32_t  toffset;               /* transmission offset, RTP clock */
+    char     mid[RTP_EXT_MID_MAXIMUM + 1];
+
+    mtime_t  send_time;             /* unwrapped abs-send-time (us), -1 if unknown */
+
+}rtp_ext_t;
+
+/** Per source extension state */
+typedef struct _rtp_ext_source_t
+{
+    uint32_t i_total;               /* packets with an extension header */
+    uint32_t i_packets[RTP_EXT_MAX];
+
+    /* abs-send-time, unwrapped */
+    uint32_t send_last;
+    int64_t  send_ext;              /* 1/2^18 s */
+    mtime_t  owd_min, owd_max;      /* arrival - send time, arbitrary origin */
+    mtime_t  owd_last;
+    uint32_t owd_jitter;            /* smoothed |delta owd| (RFC 3550 A.8 filter) */
+
+    uint16_t twcc_first, twcc_last;
+
+    uint64_t level_sum;
+    uint32_t i_voice;
+
+    uint16_t rotation;
+    char     mid[RTP_EXT_MID_MAXIMUM + 1];
+
+}rtp_ext_source_t;
+
+/* "<id>:<uri or name>" to extmap[id] */
+int  rtp_ext_map( uint8_t *extmap, const char *psz );
+const char *rtp_ext_name( int type );
+
+/* parse the extension header starting at pkt + i_offset (profile word),
+ * i_len bytes of packet available
+ * return: header size including the profile word, -1 if malformed */
+int  rtp_ext_parse( const uint8_t *pkt, int i_offset, int i_len,
+                    const uint8_t *extmap, rtp_ext_t *ext );
+
+/* accounts the packet extensions to its source, sets ext->send_time */
+void rtp_ext_update( rtp_ext_source_t *es, rtp_ext_t *ext, mtime_t now );
+
+rtp_ext_source_t *rtp_ext_source_create( void );
+void rtp_ext_source_destroy( rtp_ext_source_t *es );
+void rtp_ext_report( const rtp_ext_source_t *es, FILE *fp );
+
+#endif //_RTPEXT_H_
@@ -30,9 +30,25 @@
 #include <string.h>
 
 #include <xrtp_printf.h>
+#include <xrtp_bytes.h>
 
 #include "session.h"
 #include "payload.h"
+#include "rtcp.h"
+#include "rtcpfb.h"
+#include "rtpext.h"
+#include "gcc.h"
+#include "stats.h"
+#include "timeline.h"
+#include "lossmap.h"
+#include "pdv.h"
+#include "drift.h"
+#include "avsync.h"
+#include "jbsim.h"
+#include "frame.h"
+#include "impact.h"
+#include "output.h"
+#include "writer.h"
 
 #define XRTP_TS_INVALID (0)
 
@@ -40,38 +56,40 @@ static rtp_source_t *
 rtp_source_create ( const rtp_session_t *session,
                     uint32_t ssrc, uint16_t init_seq, 
                     uint8_t ptype, payload_des *des );
-static rtp_source_t *
-rtp_source_find ( const rtp_session_t *session, uint32_t ssrc );
 static void
 rtp_source_destroy ( const rtp_session_t *session,
                      rtp_source_t *source );
 
-static rtcp_source_t *
-rtcp_source_create ( const rtp_session_t *session, uint32_t ssrc );
-static void
-rtcp_source_destroy( rtcp_source_t *control );
-
 static int rtp_autodetect( rtp_source_t *src, uint8_t ptype, payload_des *des );
 
 static void rtp_decode ( const rtp_session_t *session, rtp_source_t *src );
 
-static uint64_t GetQWBE( const void * _p );
-static uint32_t GetDWBE( const void * _p );
-static uint16_t GetWBE( const void * _p );
-
 /**
- * Creates a new RTP session.
+ * Creates a new RTP session. With b_writer and -o async/uring it gets a
+ * writer for the outputs of its sources.
  */
 rtp_session_t *
-rtp_session_create ( )
+rtp_session_create ( int b_writer )
 {
     rtp_session_t *session = malloc (sizeof (*session));
     if (session == NULL)
         return NULL;
 
-    session->srcc = 0;
+    session->srcv   = NULL;
+    session->srcc   = 0;
+    session->i_srcv = 0;
+    session->srch   = NULL;
+    session->avsync = NULL;
+    session->writer = NULL;
 
-    session->control = NULL;
+    if( b_writer && (i_output_flags & (OUTPUT_ASYNC | OUTPUT_URING)) )
+    {
+        /* one per session: the analysis thread is its only producer */
+        session->writer = writer_create( i_output_flags & OUTPUT_URING ? WRITER_URING
+                                                                       : WRITER_THREAD );
+        if( session->writer == NULL )
+            xrtp_printf( XRTP_ERR, "rtp_session_create> can't create writer, writes are synchronous.\n" );
+    }
 
     return session;
 }
@@ -88,9 +106,13 @@ void rtp_session_destroy ( rtp_session_t *session )
         rtp_source_destroy ( session, session->srcv[i] );
     }
 
-    if( session->control )
-        rtcp_source_destroy( session->control );
+    avsync_destroy( session->avsync );
+
+    /* after the sources: their outputs are closed */
+    writer_destroy( session->writer );
 
+    free( session->srcv );
+    free( session->srch );
     free (session);
 }
 
@@ -149,6 +171,20 @@ rtp_source_create ( const rtp_session_t *session,
     source->max_seq  = source->bad_seq = init_seq;
     source->last_seq = init_seq - 1;
     source->blocks   = NULL;
+    source->i_queued = source->i_queued_max = 0;
+    source->i_reordered = source->i_lost = source->i_late = 0;
+    source->control  = NULL;
+    source->fb       = NULL;
+    source->ext      = NULL;
+    source->gcc      = NULL;
+    source->stats    = NULL;
+    source->tl       = NULL;
+    source->lm       = NULL;
+    source->pdv      = NULL;
+    source->drift    = NULL;
+    source->jb       = NULL;
+    source->fa       = NULL;
+    source->impact   = NULL;
 
     source->op       = (intptr_t)NULL;
     source->pt.init  = NULL;
@@ -159,6 +195,10 @@ rtp_source_create ( const rtp_session_t *session,
 
     // FIXME: user specified filename
     sprintf( arg.file_name, "pt%d_0x%x.es", ptype, ssrc );
+    arg.writer = session->writer;
+    arg.ssrc   = ssrc;
+    arg.i_pt   = ptype;
+    arg.i_frequency = source->pt.frequency;
     source->op = source->pt.init( &arg );
     if( source->op == (intptr_t)NULL )
     {
@@ -179,23 +219,69 @@ err_rtp_source_create:
     return NULL;
 }
 
-static rtp_source_t *
+#define SSRC_HASH(ssrc, mask) (((ssrc) * 0x9E3779B1u >> 7) & (mask))
+
+rtp_source_t *
 rtp_source_find ( const rtp_session_t *session, uint32_t ssrc )
 {
-    rtp_source_t *src = NULL;
+    unsigned mask = 2 * session->i_srcv - 1;
     unsigned i;
-    for (i = 0; i < session->srcc; i++)
+
+    if( session->srch == NULL )
+        return NULL;
+
+    for( i = SSRC_HASH( ssrc, mask ); session->srch[i]; i = (i + 1) & mask )
+    {
+        if( session->srch[i]->ssrc == ssrc )
+            return session->srch[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * Adds a source to the session, growing the arrays when full.
+ */
+static int
+rtp_session_add ( rtp_session_t *session, rtp_source_t *src )
+{
+    unsigned mask, i;
+
+    if( session->srcc == session->i_srcv )
     {
-        src = session->srcv[i];
+        unsigned i_srcv = session->i_srcv ? 2 * session->i_srcv : 32;
+        rtp_source_t **srcv = realloc( session->srcv, i_srcv * sizeof(*srcv) );
+        rtp_source_t **srch;
 
-        if( src->ssrc == ssrc )
-            break;
+        if( srcv == NULL )
+            return -1;
+        session->srcv = srcv;
+
+        srch = calloc( 2 * i_srcv, sizeof(*srch) );
+        if( srch == NULL )
+            return -1;
+
+        /* rehash */
+        mask = 2 * i_srcv - 1;
+        for( unsigned k = 0; k < session->srcc; k++ )
+        {
+            for( i = SSRC_HASH( srcv[k]->ssrc, mask ); srch[i]; i = (i + 1) & mask )
+                ;
+            srch[i] = srcv[k];
+        }
+
+        free( session->srch );
+        session->srch   = srch;
+        session->i_srcv = i_srcv;
     }
 
-    /* too much ssrc */
-    assert(i <= session->srcc);
+    mask = 2 * session->i_srcv - 1;
+    for( i = SSRC_HASH( src->ssrc, mask ); session->srch[i]; i = (i + 1) & mask )
+        ;
+    session->srch[i] = src;
+    session->srcv[session->srcc++] = src;
 
-    return src;
+    return 0;
 }
 
 /**
@@ -211,9 +297,137 @@ rtp_source_destroy ( const rtp_session_t *session,
     if( source->blocks )
         block_chainrelease( source->blocks );
 
+    rtcp_source_destroy( source->control );
+    rtcp_fb_destroy( source->fb );
+    rtp_ext_source_destroy( source->ext );
+    gcc_destroy( source->gcc );
+    frame_asm_destroy( source->fa );    /* before the statistics it feeds */
+    stats_destroy( source->stats );
+    impact_destroy( source->impact );
+    timeline_destroy( source->tl );
+    lossmap_destroy( source->lm );
+    pdv_destroy( source->pdv );
+    drift_destroy( source->drift );
+    jbsim_destroy( source->jb );
+
     free (source);
 }
 
+static void
+rtp_source_frame ( void *opaque, const frame_t *f )
+{
+    rtp_source_t *src = (rtp_source_t *)opaque;
+
+    stats_frame( src->stats, f, src->pt.frequency );
+
+    if( src->impact )
+        impact_frame( src->impact, f );
+}
+
+/**
+ * Whether a source is video: audio hardly ever sets the marker bit, so
+ * its frames would all close without it.
+ */
+int
+rtp_source_is_video ( const rtp_source_t *src )
+{
+    return src->pt.decode == h264payload_decode
+        || src->pt.decode == h265payload_decode
+        || src->pt.decode == hpvcpayload_decode;
+}
+
+/**
+ * Creates the per source analysis state enabled by the user.
+ */
+static void
+rtp_source_analysis ( const xrtp *h, rtp_source_t *src, uint8_t ptype )
+{
+    char psz_file[64];
+
+    if( h->param.b_gcc )
+    {
+        sprintf( psz_file, "pt%d_0x%x.gcc", ptype, src->ssrc );
+        src->gcc = gcc_create( psz_file, src->pt.frequency );
+    }
+
+    if( h->param.b_stats )
+    {
+        src->stats  = stats_create();
+        src->pdv    = pdv_create( src->pt.frequency );
+
+        if( src->stats && rtp_source_is_video( src ) )
+            src->fa = frame_asm_create( rtp_source_frame, src );
+
+        /* the loss impact needs the parser tags: key, reference */
+        if( src->fa && (src->pt.decode == h264payload_decode
+                     || src->pt.decode == h265payload_decode) )
+            src->impact = impact_create( src->pt.frequency );
+    }
+
+    if( h->param.i_window > 0 )
+    {
+        sprintf( psz_file, "pt%d_0x%x.tl", ptype, src->ssrc );
+        src->tl = timeline_create( psz_file, h->param.i_window );
+    }
+
+    if( h->param.b_xr || h->param.b_stats )
+    {
+        sprintf( psz_file, "pt%d_0x%x.xr", ptype, src->ssrc );
+        src->lm = lossmap_create( h->param.b_xr ? psz_file : NULL );
+    }
+
+    if( h->param.b_stats || h->param.b_deskew )
+        src->drift = drift_create( src->pt.frequency );
+
+    if( h->param.i_jb )
+        src->jb = jbsim_create( h->param.jb, h->param.i_jb, src->pt.frequency );
+}
+
+/**
+ * Prints the end of run summary of a source.
+ */
+void
+rtp_source_report ( const rtp_source_t *src, FILE *fp )
+{
+    fprintf( fp, "ssrc 0x%08x: pt %d, %u Hz\n",
+                 src->ssrc, src->pt.number, src->pt.frequency );
+
+    if( src->control )
+        rtcp_source_report( src->control, src->pt.frequency, fp );
+
+    fprintf( fp, "  order:  reordered %llu, queued max %u, lost %llu, late %llu\n",
+                 (unsigned long long)src->i_reordered, src->i_queued_max,
+                 (unsigned long long)(src->i_lost > src->i_late ? src->i_lost - src->i_late : 0),
+                 (unsigned long long)src->i_late );
+
+    if( src->fb )
+        rtcp_fb_report( src->fb, fp );
+
+    if( src->ext )
+        rtp_ext_report( src->ext, fp );
+
+    if( src->stats )
+        stats_report( src->stats, fp );
+
+    if( src->impact )
+        impact_report( src->impact, fp );
+
+    if( src->pdv )
+        pdv_report( src->pdv, fp );
+
+    if( src->lm )
+        lossmap_report( src->lm, fp );
+
+    if( src->drift )
+        drift_report( src->drift, fp );
+
+    if( src->jb )
+        jbsim_report( src->jb, fp );
+
+    if( src->gcc )
+        gcc_report( src->gcc, fp );
+}
+
 /* Not using SDP, we need to guess the payload format used */
 /* see http://www.iana.org/assignments/rtp-parameters */
 static int rtp_autodetect( rtp_source_t *src, uint8_t ptype, payload_des *des )
@@ -378,13 +592,15 @@ rtp_find_ptype (const rtp_session_t *session, rtp_source_t *source,
 }
 
 int
-rtp_queue ( xrtp *h, block_t *block )
+rtp_queue ( const xrtp *h, rtp_session_t *session, block_t *block )
 {
-    rtp_session_t *session = h->session;
-    rtcp_source_t *control = session->control;
+    rtcp_source_t *control;
     rtp_source_t  *src;
 
     int16_t       delta_seq;
+    uint8_t       b_new = 0;
+    uint8_t       b_frame;
+    double        skew = 0.;    /* RTP clock error, when de-skewing */
 
     uint32_t timestamp;
     uint32_t ref_rtp;
@@ -412,19 +628,37 @@ rtp_queue ( xrtp *h, block_t *block )
     const uint16_t seq  = rtp_seq (block);
     const uint32_t ssrc = GetDWBE (block->p_buffer + 8);
 
+    /* Header extensions, parsed in arrival order for the send times */
+    if (block->p_buffer[0] & 0x10)
+    {
+        int skip = 12u + (block->p_buffer[0] & 0x0F) * 4;
+
+        if( rtp_ext_parse( block->p_buffer, skip, block->i_buffer,
+                           h->param.extmap, &block->ext ) < 0 )
+            goto drop;
+    }
+
     src = rtp_source_find( session, ssrc );
     if( src == NULL )
     {
         uint8_t ptype = rtp_ptype (block);
-    
+
         /* New source */
         src = rtp_source_create ( session, ssrc, seq, ptype, h->descript );
         if (src == NULL)
             goto drop;
 
-        session->srcv[session->srcc++] = src;
+        if( rtp_session_add( session, src ) < 0 )
+        {
+            xrtp_printf( XRTP_ERR, "rtp_queue> can't add source, ssrc 0x%x ignored.\n", ssrc );
+            rtp_source_destroy( session, src );
+            goto drop;
+        }
 
         pt = &src->pt;
+        b_new = 1;
+
+        rtp_source_analysis( h, src, ptype );
         
         /* Cannot compute jitter yet */
     }
@@ -439,6 +673,9 @@ rtp_queue ( xrtp *h, block_t *block )
             xrtp_printf( XRTP_ERR, "rtp_queue> another ssrc received.\n" );
             goto drop;
         }        
+
+        if( h->param.b_deskew && src->drift )
+            skew = drift_skew( src->drift );
     
         if (pt != NULL)
         {
@@ -449,6 +686,12 @@ rtp_queue ( xrtp *h, block_t *block )
             int64_t ts = rtp_timestamp (block);
             int64_t d = ((now - src->last_rx) * freq) / CLOCK_FREQ;
 
+            if( skew != 0. )
+                d = (int64_t)((now - src->last_rx) * freq * (1. + skew) / CLOCK_FREQ);
+
+            if( src->stats && now >= src->last_rx )
+                hist_add( &src->stats->iat, now - src->last_rx );
+
             if( ts != src->last_ts )
             {
                 d -= ts - src->last_ts;
@@ -456,6 +699,9 @@ rtp_queue ( xrtp *h, block_t *block )
                 
                 if (d < 0) d = -d;
                 src->avg_jitter += (uint32_t)(((d - src->avg_jitter) + 8) >> 4);
+
+                if( src->stats )
+                    hist_add( &src->stats->jitter, d * CLOCK_FREQ / freq );
             }
             else
             {
@@ -464,8 +710,64 @@ rtp_queue ( xrtp *h, block_t *block )
             }
         }
     }
+
+    /* first packet of a frame, in arrival order */
+    b_frame = b_new || rtp_timestamp (block) != src->last_ts;
+
+    if( src->tl )
+    {
+        timeline_window_t *win = timeline_get( src->tl, now );
+        uint32_t jitter = (uint32_t)(CLOCK_FREQ * (block->i_jitter < 0 ? -(int64_t)block->i_jitter
+                                                                       : block->i_jitter) / pt->frequency);
+
+        win->i_packets++;
+        win->i_bytes += block->i_buffer;
+        if( jitter > win->jitter_max )
+            win->jitter_max = jitter;
+        if( b_frame )
+            win->i_frames++;
+    }
+
+    if( b_new )
+        src->ext_ts = rtp_timestamp (block);
+    else
+        src->ext_ts += (int32_t)(rtp_timestamp (block) - src->last_ts);
+
     src->last_rx = now;
     block->i_pts = now; 
+    control = src->control;
+
+    /* NACKed packets arriving: repair round trip */
+    rtcp_fb_received( src, seq, now );
+
+    if( block->ext.i_count )
+    {
+        if( src->ext == NULL )
+            src->ext = rtp_ext_source_create();
+
+        if( src->ext )
+            rtp_ext_update( src->ext, &block->ext, now );
+    }
+
+    if( src->stats )
+        hist_add( &src->stats->size, block->i_buffer );
+
+    if( src->pdv )
+        pdv_update( src->pdv, seq, block->ext.send_time, src->ext_ts, now );
+
+    if( src->drift )
+        drift_update( src->drift, src->ext_ts, now );
+
+    if( src->jb )
+        jbsim_update( src->jb, src->ext_ts, now,
+                      (mtime_t)src->avg_jitter * CLOCK_FREQ / src->pt.frequency );
+
+    if( session->avsync )
+        avsync_update( session->avsync, src, rtp_timestamp (block), b_frame, now );
+
+    if( src->gcc )
+        gcc_update( src->gcc, block->ext.send_time, src->ext_ts,
+                    now, block->i_buffer );
     
     block->i_rtp_timestamp = src->last_ts = rtp_timestamp (block);
 
@@ -477,6 +779,10 @@ rtp_queue ( xrtp *h, block_t *block )
             ref_ntp = control->ref_ntp;
             ref_rtp = control->ref_rtp 
                     + (uint32_t)(((now - control->ref_rx)*pt->frequency)/CLOCK_FREQ);
+
+            if( skew != 0. )
+                ref_rtp = control->ref_rtp
+                        + (uint32_t)((now - control->ref_rx) * pt->frequency * (1. + skew) / CLOCK_FREQ);
         }
         else
         {
@@ -493,6 +799,14 @@ rtp_queue ( xrtp *h, block_t *block )
         timestamp = rtp_timestamp (block);
         
         block->i_pts_pcr = (CLOCK_FREQ * ((mtime_t)timestamp - (mtime_t)ref_rtp) / pt->frequency);
+
+        if( src->stats && ref_rtp != 0 ) /* no reference yet for the first packet */
+        {
+            if( block->i_pts_pcr >= 0 )
+                hist_add( &src->stats->pts_pcr, block->i_pts_pcr );
+            else
+                hist_add( &src->stats->pts_pcr_neg, -block->i_pts_pcr );
+        }
         //block->i_pts     = ref_ntp + block->i_pts_pcr;
 
         if( control == NULL || control->ref_rtp == 0 )
@@ -519,6 +833,7 @@ rtp_queue ( xrtp *h, block_t *block )
             xrtp_printf( XRTP_OUT, "rtp_queue> sequence resynchronized.\n");
             block_chainrelease (src->blocks);
             src->blocks = NULL;
+            src->i_queued = 0;
         }
         else
         {
@@ -541,13 +856,28 @@ rtp_queue ( xrtp *h, block_t *block )
         if (delta_seq == 0)
         {
             xrtp_printf( XRTP_OUT, "rtp_queue> duplicate packet (sequence: %d)\n", seq);
+            if( src->tl )
+                timeline_get( src->tl, now )->i_duplicated++;
+            if( src->lm )
+                lossmap_duplicate( src->lm, seq );
             goto drop; /* duplicate */
         }
         pp = &prev->p_next;
     }
+
+    if( delta_seq < 0 )
+    {
+        src->i_reordered++;
+        if( src->tl )
+            timeline_get( src->tl, now )->i_reordered++;
+    }
+
     block->p_next = *pp;
     *pp = block;
 
+    if( ++src->i_queued > src->i_queued_max )
+        src->i_queued_max = src->i_queued;
+
     return 0;
 
 drop:
@@ -558,7 +888,6 @@ drop:
 static void
 rtp_decode ( const rtp_session_t *session, rtp_source_t *src )
 {
-    rtcp_source_t *control = session->control;
     block_t  *block = src->blocks;
     const rtp_pt_t *pt = &src->pt;
 
@@ -568,6 +897,7 @@ rtp_decode ( const rtp_session_t *session, rtp_source_t *src )
     assert (block);
     src->blocks = block->p_next;
     block->p_next = NULL;
+    src->i_queued--;
 
     /* Discontinuity detection */
     delta_seq = rtp_seq (block) - (src->last_seq + 1);
@@ -577,14 +907,25 @@ rtp_decode ( const rtp_session_t *session, rtp_source_t *src )
         {   /* Trash too late packets (and PIM Assert duplicates) */
             xrtp_printf( XRTP_ERR, "rtp_decode> ignoring late packet (sequence: %d).\n",
                                    rtp_seq (block) );
+            if( src->lm == NULL || lossmap_late( src->lm, rtp_seq (block) ) )
+                src->i_late++;
             goto drop;
         }
         xrtp_printf( XRTP_ERR, "rtp_decode> %d packet(s) lost, before %d.\n", 
                                 delta_seq, src->last_seq );
         block->i_flags |= BLOCK_FLAG_DISCONTINUITY;
+        src->i_lost += delta_seq;
+
+        rtcp_fb_lost( src, src->last_seq + 1, delta_seq );
+
+        if( src->tl )
+            timeline_get( src->tl, block->i_pts )->i_lost += delta_seq;
     }
     src->last_seq = rtp_seq (block);
 
+    if( src->lm )
+        lossmap_decoded( src->lm, src->last_seq, delta_seq, block->i_pts );
+
     if (pt == NULL)
     {
         xrtp_printf( XRTP_ERR, "rtp_decode> unknown payload (%d)\n",
@@ -592,10 +933,13 @@ rtp_decode ( const rtp_session_t *session, rtp_source_t *src )
         goto drop;
     }
 
+    if( block->p_buffer[1] & 0x80 )
+        block->i_flags |= BLOCK_FLAG_END_OF_FRAME;   /* marker bit */
+
     /* CSRC count */
     skip = 12u + (block->p_buffer[0] & 0x0F) * 4;
 
-    /* Extension header (ignored for now) */
+    /* Extension header (already parsed by rtp_queue) */
     if (block->p_buffer[0] & 0x10)
     {
         skip += 4;
@@ -613,13 +957,17 @@ rtp_decode ( const rtp_session_t *session, rtp_source_t *src )
 
     pt->decode ( src->op, block );
 
+    /* after the depacketizer, which may tag the slice types */
+    if( src->fa && frame_asm_packet( src->fa, block ) == 0 )
+        frame_asm_packet_end( src->fa, block );
+
 drop:
     block_free( block );
     return;
 }
 
 
-int rtp_dequeue ( const rtp_session_t *session, mtime_t now )
+int rtp_dequeue ( const xrtp *h, const rtp_session_t *session, mtime_t now )
 {
     for (unsigned i = 0; i < session->srcc; i++) {
 
@@ -647,6 +995,29 @@ int rtp_dequeue ( const rtp_session_t *session, mtime_t now )
                 continue;
             }
 
+            /* Offline lookahead: the missing packets are given up once
+             * the window is full, whatever the jitter. The queue never
+             * holds more than the window. */
+            if( h->param.i_lookahead )
+            {
+                if( src->i_queued > h->param.i_lookahead || now == _I64_MAX )
+                {
+                    rtp_decode(session, src);
+                    continue;
+                }
+                break;
+            }
+
+            if( h->param.i_lookahead_time )
+            {
+                if( now - block->i_pts >= h->param.i_lookahead_time )
+                {
+                    rtp_decode(session, src);
+                    continue;
+                }
+                break;
+            }
+
             /* Wait for 3 times the inter-arrival delay variance (about 99.7%
              * match for random gaussian jitter).
              */
@@ -684,110 +1055,6 @@ int rtp_dequeue ( const rtp_session_t *session, mtime_t now )
     return 0;
 }
 
-/**
- * Initializes a new RTCP within an RTP session.
- */
-static rtcp_source_t *
-rtcp_source_create ( const rtp_session_t *session, uint32_t ssrc )
-{
-    rtcp_source_t *control;
-
-    control = (rtcp_source_t *)malloc( sizeof(rtcp_source_t) );
-    if( control == NULL )
-        return NULL;
-
-    control->ssrc   = ssrc;
-    control->jitter = 0;
-
-    control->ref_rtp = 0;
-    control->ref_ntp = 1 << 6;
-    control->ref_rx  = 0;
-
-    return control;
-}
-
-/**
- * Destroys an RTCP source.
- */
-static void
-rtcp_source_destroy( rtcp_source_t *control )
-{
-    if( control )
-        free( control );
-}
-
-uint32_t rtcp_timestamp( const block_t *block )
-{
-    assert( block->i_buffer >= 20 );
-    return GetDWBE( block->p_buffer + 16 );
-}
-
-int
-rtcp_update ( rtp_session_t *session, block_t *block )
-{
-    rtp_source_t  *src;
-    rtcp_source_t *control;
-    uint32_t ssrc;
-
-    mtime_t  ntp_time;
-    uint32_t timestamp;
-
-    uint8_t  *p_header;
-    int i_rtcp_length;
-
-    p_header      = block->p_buffer;
-    i_rtcp_length = (uint16_t)block->i_buffer;
-    while( i_rtcp_length > 0 )
-    {
-        uint16_t s_header_len = 4 * ( GetWBE(p_header + 2)+ 1 );
-    
-        i_rtcp_length -= s_header_len;
-        p_header      += s_header_len;
-    }
-
-    if( i_rtcp_length < 0 )
-        goto drop;
-
-    if ((block->p_buffer[0] >> 6 ) != 2) /* RTCP version number */
-        goto drop;
-
-    if( (block->p_buffer[1]) != 200 ) /* not start with SR */
-        goto drop;
-
-    ssrc = GetDWBE( block->p_buffer + 4 );
-
-    if( !(src = rtp_source_find(session, ssrc))) 
-        goto drop;
-
-    // FIXME: read all compounds of RTCP packet
-    if( session->control == NULL )
-    {
-        session->control = rtcp_source_create( session, ssrc );
-
-        if( session->control == NULL )
-            goto drop;
-    }
-    else
-    {
-        // FIXME: rtcp jitter
-    }
-    
-    ntp_time  = (mtime_t)GetQWBE( block->p_buffer + 8 );
-    timestamp = rtcp_timestamp( block );
-
-    control = session->control;
-
-    control->ref_ntp = ntp_time;
-    control->ref_rtp = timestamp;
-    control->ref_rx  = block->i_sample_time;
-
-    return 0;
-
-drop:
-
-    return -1;
-}
-
 /* Memory alignment (must be a multiple of sizeof(void*) and a power of two) */
 #define BLOCK_ALIGN        16
 /* Initial reserved header and footer size (must be multiple of alignment) */
@@ -816,6 +1083,9 @@ static inline void __block_Init( block_t *b, void *buf, size_t size )
     b->p_buffer = buf;
     b->i_buffer = (int)size;
     b->i_flags = 0;
+    b->i_temporal_id = -1;
+    b->i_reference = -1;
+    b->i_key = 0;
     b->i_nb_samples = 0;
     b->i_pts = 0;
     b->i_length = 0;
@@ -881,6 +1151,14 @@ int block_init( block_t *b, uint8_t *buf, int i_len, mtime_t time )
     b->i_sample_time = time;
 
     b->i_jitter = 0;
+
+    b->i_temporal_id = -1;
+    b->i_reference   = -1;
+    b->i_key         = 0;
+
+    b->ext.i_count   = 0;
+    b->ext.flags     = 0;
+    b->ext.send_time = -1;
     
     b->i_length = 0;
     b->i_rate   = 0;
@@ -904,25 +1182,3 @@ void block_chainrelease( block_t *b )
         b = p_next;
     }
 }
-
-static uint64_t GetQWBE( const void * _p )
-{
-    const uint8_t * p = (const uint8_t *)_p;
-    return ( ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48)
-              | ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32)
-              | ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16)
-              | ((uint64_t)p[6] << 8) | p[7] );
-}
-
-static uint32_t GetDWBE( const void * _p )
-{
-    const uint8_t * p = (const uint8_t *)_p;
-    return ( ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
-              | ((uint32_t)p[2] << 8) | p[3] );
-}
-
-static uint16_t GetWBE( const void * _p )
-{
-    const uint8_t * p = (const uint8_t *)_p;
-    return ( ((uint16_t)p[0] << 8) | p[1] );
-}
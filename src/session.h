@@ -1,6 +1,8 @@
 #ifndef _SESSION_H_
 #define _SESSION_H_
 
+#include <stdio.h>
+
 #include "xrtp.h"
 
 #define CLOCK_FREQ 1000000L
@@ -59,13 +61,16 @@
 
 uint8_t  rtp_ptype (const block_t *block);
 uint32_t rtp_timestamp (const block_t *block);
-uint32_t rtcp_timestamp( const block_t *block );
 
-int rtp_queue ( xrtp *h, block_t *block );
-int rtp_dequeue ( const rtp_session_t *session, mtime_t );
-int rtcp_update ( rtp_session_t *session, block_t *block );
+int rtp_queue ( const xrtp *h, rtp_session_t *session, block_t *block );
+int rtp_dequeue ( const xrtp *h, const rtp_session_t *session, mtime_t );
+
+rtp_source_t * rtp_source_find ( const rtp_session_t *session, uint32_t ssrc );
+void rtp_source_report ( const rtp_source_t *src, FILE *fp );
+/* h264, h265 or hpvc payload */
+int  rtp_source_is_video ( const rtp_source_t *src );
 
-rtp_session_t * rtp_session_create ( );
+rtp_session_t * rtp_session_create ( int b_writer );
 void rtp_session_destroy ( rtp_session_t *session );
 
 /* block_t */
@@ -0,0 +1,88 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_thread.h>
+
+#include "spsc.h"
+
+#define SPSC_CACHE_LINE     64
+
+struct _spsc_t
+{
+    /* written by the consumer only */
+    volatile uint32_t i_head;
+    uint8_t           pad0[SPSC_CACHE_LINE - sizeof(uint32_t)];
+
+    /* written by the producer only */
+    volatile uint32_t i_tail;
+    uint8_t           pad1[SPSC_CACHE_LINE - sizeof(uint32_t)];
+
+    uint32_t i_mask;
+    uint32_t i_item;
+
+    uint8_t  *p_items;
+};
+
+spsc_t *spsc_create( unsigned i_count, unsigned i_item )
+{
+    spsc_t *q;
+    unsigned i_size = 1;
+
+    assert( i_count > 0 && i_item > 0 );
+
+    /* round up to a power of two so indexes wrap with a mask */
+    while( i_size < i_count )
+        i_size <<= 1;
+
+    q = (spsc_t *)calloc( 1, sizeof(spsc_t) );
+    if( q == NULL )
+        return NULL;
+
+    q->p_items = (uint8_t *)malloc( (size_t)i_size * i_item );
+    if( q->p_items == NULL )
+    {
+        free( q );
+        return NULL;
+    }
+
+    q->i_mask = i_size - 1;
+    q->i_item = i_item;
+
+    return q;
+}
+
+void spsc_destroy( spsc_t *q )
+{
+    if( q == NULL )
+        return;
+
+    free( q->p_items );
+    free( q );
+}
+
+int spsc_push( spsc_t *q, const void *item )
+{
+    uint32_t tail = q->i_tail;
+
+    if( tail - xrtp_atomic_load( &q->i_head ) > q->i_mask )
+        return -1;
+
+    memcpy( q->p_items + (size_t)(tail & q->i_mask) * q->i_item, item, q->i_item );
+    xrtp_atomic_store( &q->i_tail, tail + 1 );
+
+    return 0;
+}
+
+int spsc_pop( spsc_t *q, void *item )
+{
+    uint32_t head = q->i_head;
+
+    if( head == xrtp_atomic_load( &q->i_tail ) )
+        return -1;
+
+    memcpy( item, q->p_items + (size_t)(head & q->i_mask) * q->i_item, q->i_item );
+    xrtp_atomic_store( &q->i_head, head + 1 );
+
+    return 0;
+}
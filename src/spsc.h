@@ -0,0 +1,21 @@
+#ifndef _SPSC_H_
+#define _SPSC_H_
+
+#include <datatype.h>
+
+/*
+ * Bounded lock-free single-producer / single-consumer ring.
+ *
+ * Items are fixed-size and copied in and out, so no allocation happens
+ * per push. Only one thread may push and only one thread may pop.
+ */
+typedef struct _spsc_t spsc_t;
+
+spsc_t *spsc_create( unsigned i_count, unsigned i_item );
+void    spsc_destroy( spsc_t *q );
+
+/* return: 0 on success, -1 if the ring is full (push) or empty (pop) */
+int     spsc_push( spsc_t *q, const void *item );
+int     spsc_pop( spsc_t *q, void *item );
+
+#endif //_SPSC_H_
@@ -0,0 +1,270 @@
+/**
+ * @file stats.c
+ * @brief Per source statistics, log-linear histograms
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_bytes.h>
+
+#include "stats.h"
+
+static inline unsigned
+hist_index ( uint32_t v )
+{
+    unsigned e;
+
+    if( v < HIST_LINEAR )
+        return v;
+
+    /* msb >= HIST_SUB_BITS + 1, keep the HIST_SUB_BITS bits after it */
+    e = 31 - xrtp_clz32( v );
+
+    return HIST_LINEAR + ((e - HIST_SUB_BITS - 1) << HIST_SUB_BITS)
+         + (v >> (e - HIST_SUB_BITS)) - (1 << HIST_SUB_BITS);
+}
+
+void hist_add( hist_t *h, uint64_t v64 )
+{
+    uint32_t v = v64 > UINT32_MAX ? UINT32_MAX : (uint32_t)v64;
+
+    h->count[hist_index( v )]++;
+
+    if( h->i_total == 0 || v < h->min )
+        h->min = v;
+    if( v > h->max )
+        h->max = v;
+
+    h->i_total++;
+    h->sum += v;
+}
+
+uint32_t hist_quantile( const hist_t *h, double q )
+{
+    uint64_t i_rank, i_seen = 0;
+    unsigned i;
+
+    if( h->i_total == 0 )
+        return 0;
+
+    if( q >= 1. )
+        return h->max;
+
+    i_rank = (uint64_t)(q * h->i_total);
+
+    for( i = 0; i < HIST_BUCKETS; i++ )
+    {
+        i_seen += h->count[i];
+        if( i_seen > i_rank )
+            break;
+    }
+
+    if( i < HIST_LINEAR )
+        return i;
+    else
+    {
+        unsigned k     = i - HIST_LINEAR;
+        unsigned shift = (k >> HIST_SUB_BITS) + 1;
+        uint64_t low   = (uint64_t)((1 << HIST_SUB_BITS) + (k & ((1 << HIST_SUB_BITS) - 1))) << shift;
+        uint64_t v     = low + ((uint64_t)1 << shift) / 2;
+
+        /* middle of the bucket, within what was actually seen */
+        if( v < h->min ) v = h->min;
+        if( v > h->max ) v = h->max;
+
+        return (uint32_t)v;
+    }
+}
+
+stats_t *stats_create( void )
+{
+    return (stats_t *)calloc( 1, sizeof(stats_t) );
+}
+
+void stats_destroy( stats_t *s )
+{
+    if( s )
+        free( s );
+}
+
+int64_t hist_quantile_signed( const hist_t *neg, const hist_t *pos, double q )
+{
+    uint64_t n = neg->i_total;
+    uint64_t p = pos->i_total;
+    double   r = q * (n + p);
+
+    if( r < n )
+        return -(int64_t)hist_quantile( neg, 1. - r / n );
+
+    return hist_quantile( pos, p ? (r - n) / p : 0 );
+}
+
+/**
+ * Keyframe intervals and the picture types of the GOP, from the slice
+ * headers tagged by the depacketizer.
+ */
+static void
+stats_gop ( stats_t *s, const frame_t *f, uint32_t freq )
+{
+    char c;
+
+    if( f->i_temporal_id >= 0 && f->i_temporal_id < STATS_TID_MAXIMUM )
+        s->i_frames_tid[f->i_temporal_id]++;
+
+    switch( f->i_key )
+    {
+        case FRAME_KEY_IDR: s->i_frames_idr++; break;
+        case FRAME_KEY_CRA: s->i_frames_cra++; break;
+        case FRAME_KEY_BLA: s->i_frames_bla++; break;
+    }
+
+    if( FRAME_IS_KEY( f ) )
+    {
+        if( s->i_gop > 0 )
+        {
+            hist_add( &s->gop_frames, s->i_gop );
+            if( freq > 0 )
+                hist_add( &s->gop_time, (uint64_t)(uint32_t)(f->i_rtp_timestamp - s->gop_ts) * 1000 / freq );
+            strcpy( s->gop_last, s->gop_pattern );
+        }
+        s->i_gop  = 0;
+        s->gop_ts = f->i_rtp_timestamp;
+        c = 'I';
+    }
+    else if( s->i_gop == 0 )
+        return;     /* no keyframe yet */
+    else if( f->i_block_flags & BLOCK_FLAG_TYPE_B )
+        c = 'B';
+    else if( f->i_block_flags & BLOCK_FLAG_TYPE_P )
+        c = 'P';
+    else if( f->i_block_flags & BLOCK_FLAG_TYPE_I )
+        c = 'i';    /* intra, not a random access point */
+    else
+        c = '?';
+
+    if( s->i_gop < STATS_GOP_PATTERN )
+    {
+        s->gop_pattern[s->i_gop]     = c;
+        s->gop_pattern[s->i_gop + 1] = '\0';
+    }
+    else if( s->i_gop == STATS_GOP_PATTERN )
+    {
+        s->gop_pattern[s->i_gop]     = '+';
+        s->gop_pattern[s->i_gop + 1] = '\0';
+    }
+    s->i_gop++;
+}
+
+void stats_frame( stats_t *s, const frame_t *f, uint32_t freq )
+{
+    hist_add( &s->frame_assembly, f->last_arrival - f->first_arrival );
+    hist_add( &s->frame_size, f->i_bytes );
+
+    if( f->i_flags & FRAME_FLAG_LOSS )
+        s->i_frames_loss++;
+    if( f->i_flags & FRAME_FLAG_NO_MARKER )
+        s->i_frames_no_marker++;
+
+    if( FRAME_IS_KEY( f ) )
+        s->i_frames_key++;
+    if( f->i_block_flags & BLOCK_FLAG_TYPE_B )
+        s->i_frames_b++;
+    else if( f->i_block_flags & BLOCK_FLAG_TYPE_P )
+        s->i_frames_p++;
+    else if( f->i_block_flags & BLOCK_FLAG_TYPE_I )
+        s->i_frames_i++;
+
+    stats_gop( s, f, freq );
+
+    if( s->i_frames && f->first_arrival >= s->frame_first )
+        hist_add( &s->frame_iat, f->first_arrival - s->frame_first );
+
+    s->frame_ts[s->i_frames % STATS_FRAME_HISTORY] = f->i_rtp_timestamp;
+    s->i_frames++;
+    s->frame_first = f->first_arrival;
+
+    if( s->i_frames > 1 && freq > 0 )
+    {
+        unsigned i, j, n = s->i_frames < STATS_FRAME_HISTORY ? s->i_frames : STATS_FRAME_HISTORY;
+        int32_t  i_step = 0;
+
+        /* frames are in decoding order: the frame interval is the
+         * smallest timestamp distance among the last frames */
+        for( i = 0; i < n; i++ )
+        {
+            for( j = i + 1; j < n; j++ )
+            {
+                int32_t d = (int32_t)(s->frame_ts[i] - s->frame_ts[j]);
+
+                if( d < 0 )
+                    d = -d;
+                if( d > 0 && (i_step == 0 || d < i_step) )
+                    i_step = d;
+            }
+        }
+        if( i_step > 0 )
+            hist_add( &s->frame_rate, ((uint64_t)freq + i_step / 2) / i_step );
+    }
+}
+
+static void
+stats_line ( const char *psz_name, const hist_t *h, const char *psz_unit, FILE *fp )
+{
+    if( h->i_total == 0 )
+        return;
+
+    fprintf( fp, "  %-7s avg %llu, p50 %u, p99 %u, p99.9 %u, max %u %s\n",
+                 psz_name, (unsigned long long)(h->sum / h->i_total),
+                 hist_quantile( h, .5 ), hist_quantile( h, .99 ),
+                 hist_quantile( h, .999 ), h->max, psz_unit );
+}
+
+void stats_report( const stats_t *s, FILE *fp )
+{
+    stats_line( "iat:", &s->iat, "us", fp );
+    stats_line( "jitter:", &s->jitter, "us", fp );
+    stats_line( "size:", &s->size, "bytes", fp );
+
+    if( s->frame_size.i_total )
+    {
+        fprintf( fp, "  frames: %llu, with loss %u, without marker %u",
+                     (unsigned long long)s->frame_size.i_total,
+                     s->i_frames_loss, s->i_frames_no_marker );
+        if( s->i_frames_i + s->i_frames_p + s->i_frames_b )
+            fprintf( fp, ", key %u, I %u, P %u, B %u",
+                         s->i_frames_key, s->i_frames_i, s->i_frames_p, s->i_frames_b );
+        fprintf( fp, "\n" );
+        stats_line( "f.asm:", &s->frame_assembly, "us", fp );
+        stats_line( "f.iat:", &s->frame_iat, "us", fp );
+        stats_line( "f.size:", &s->frame_size, "bytes", fp );
+        stats_line( "f.rate:", &s->frame_rate, "fps", fp );
+    }
+
+    if( s->i_frames_idr + s->i_frames_cra + s->i_frames_bla )
+    {
+        unsigned i;
+
+        fprintf( fp, "  gop:    IDR %u, CRA %u, BLA %u",
+                     s->i_frames_idr, s->i_frames_cra, s->i_frames_bla );
+        for( i = 0; i < STATS_TID_MAXIMUM; i++ )
+        {
+            if( s->i_frames_tid[i] )
+                fprintf( fp, ", TID%u %u", i, s->i_frames_tid[i] );
+        }
+        fprintf( fp, "\n" );
+        stats_line( "g.len:", &s->gop_frames, "frames", fp );
+        stats_line( "g.time:", &s->gop_time, "ms", fp );
+        if( s->gop_last[0] )
+            fprintf( fp, "  g.last: %s\n", s->gop_last );
+    }
+
+    if( s->pts_pcr.i_total + s->pts_pcr_neg.i_total )
+    {
+        fprintf( fp, "  pcr:    pts - pcr p0.1 %lld, p50 %lld, p99 %lld, p99.9 %lld us\n",
+                     (long long)hist_quantile_signed( &s->pts_pcr_neg, &s->pts_pcr, .001 ),
+                     (long long)hist_quantile_signed( &s->pts_pcr_neg, &s->pts_pcr, .5 ),
+                     (long long)hist_quantile_signed( &s->pts_pcr_neg, &s->pts_pcr, .99 ),
+                     (long long)hist_quantile_signed( &s->pts_pcr_neg, &s->pts_pcr, .999 ) );
+    }
+}
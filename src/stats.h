@@ -0,0 +1,82 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdio.h>
+
+#include "xrtp.h"
+#include "frame.h"
+
+/*
+ * Constant memory per source statistics.
+ *
+ * Log-linear histograms: values below 32 have their own bucket, above
+ * that every power of two is split in 16 buckets, so a quantile is known
+ * within about 3% whatever the range (up to 2^32). Updates are O(1),
+ * quantiles are only walked for the end of run summary.
+ */
+
+#define HIST_SUB_BITS   4
+#define HIST_LINEAR     (2 << HIST_SUB_BITS)                    /* 32 */
+#define STATS_FRAME_HISTORY  8     /* frames, to step over B frames */
+#define STATS_GOP_PATTERN    64    /* picture types kept per GOP */
+#define STATS_TID_MAXIMUM    7
+
+#define HIST_BUCKETS    (HIST_LINEAR + (32 - HIST_SUB_BITS - 1) * (1 << HIST_SUB_BITS))
+
+typedef struct _hist_t
+{
+    uint32_t count[HIST_BUCKETS];
+    uint64_t i_total;
+    uint64_t sum;
+    uint32_t min, max;
+
+}hist_t;
+
+/* values above 2^32 - 1 are saturated */
+void     hist_add( hist_t *h, uint64_t v );
+/* q in [0, 1], 0 if empty */
+uint32_t hist_quantile( const hist_t *h, double q );
+/* quantile of a signed value kept as its negative and positive parts */
+int64_t  hist_quantile_signed( const hist_t *neg, const hist_t *pos, double q );
+
+struct _stats_t
+{
+    hist_t   iat;           /* inter-arrival time, us */
+    hist_t   jitter;        /* |transit difference| (RFC 3550 D), us */
+    hist_t   size;          /* RTP packet size, bytes */
+    hist_t   pts_pcr;       /* PTS - PCR >= 0, us */
+    hist_t   pts_pcr_neg;   /* -(PTS - PCR) for the negative ones */
+
+    /* frames (RTP timestamps) in sequence order */
+    hist_t   frame_assembly;    /* first to last packet arrival, us */
+    hist_t   frame_iat;         /* first packet arrivals of consecutive frames, us */
+    hist_t   frame_size;        /* RTP payload, bytes */
+    hist_t   frame_rate;        /* inferred from the RTP timestamp step, fps */
+    uint32_t i_frames_loss;
+    uint32_t i_frames_no_marker;
+    uint32_t i_frames_key, i_frames_i, i_frames_p, i_frames_b;
+    uint32_t frame_ts[STATS_FRAME_HISTORY];  /* last timestamps, ring */
+    unsigned i_frames;
+    mtime_t  frame_first;
+
+    /* GOP: keyframe to keyframe, in decoding order */
+    hist_t   gop_frames;        /* keyframe interval, frames */
+    hist_t   gop_time;          /* keyframe interval from the RTP timestamps, ms */
+    uint32_t i_frames_idr, i_frames_cra, i_frames_bla;
+    uint32_t i_frames_tid[STATS_TID_MAXIMUM];
+    unsigned i_gop;             /* frames since the last keyframe, 0 before the first */
+    uint32_t gop_ts;            /* RTP timestamp of the last keyframe */
+    char     gop_pattern[STATS_GOP_PATTERN + 2];  /* current GOP, '+' if truncated */
+    char     gop_last[STATS_GOP_PATTERN + 2];     /* last complete GOP */
+
+};
+
+stats_t *stats_create( void );
+void     stats_destroy( stats_t *s );
+
+/* one assembled frame, freq: RTP clock */
+void     stats_frame( stats_t *s, const frame_t *f, uint32_t freq );
+
+void     stats_report( const stats_t *s, FILE *fp );
+
+#endif //_STATS_H_
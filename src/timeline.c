@@ -0,0 +1,101 @@
+/**
+ * @file timeline.c
+ * @brief Time-bucketed per source metrics
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_printf.h>
+
+#include "timeline.h"
+#include "session.h"
+
+timeline_t *timeline_create( const char *psz_file, mtime_t i_window )
+{
+    timeline_t *tl = (timeline_t *)calloc( 1, sizeof(timeline_t) );
+    if( tl == NULL )
+        return NULL;
+
+    tl->i_window = i_window;
+
+    tl->fp = fopen( psz_file, "w" );
+    if( tl->fp == NULL )
+    {
+        xrtp_printf( XRTP_ERR, "timeline_create> can't open %s.\n", psz_file );
+        free( tl );
+        return NULL;
+    }
+
+    fprintf( tl->fp, "# window %lld ms\n"
+                     "# time(ms) kbps pps lost reordered duplicated jitter_max(us) frames\n",
+                     (long long)(i_window / 1000) );
+
+    return tl;
+}
+
+static void
+timeline_write ( timeline_t *tl, int64_t w )
+{
+    timeline_window_t *win = &tl->ring[w % TIMELINE_RING];
+    double i_scale = (double)CLOCK_FREQ / tl->i_window;
+
+    if( win->i_packets || win->i_lost || win->i_reordered || win->i_duplicated )
+    {
+        fprintf( tl->fp, "%lld %.1f %.0f %u %u %u %u %u\n",
+                 (long long)((w * tl->i_window - tl->i_first) / 1000),
+                 win->i_bytes * 8 * i_scale / 1000, win->i_packets * i_scale,
+                 win->i_lost, win->i_reordered, win->i_duplicated,
+                 win->jitter_max, win->i_frames );
+    }
+
+    memset( win, 0, sizeof(*win) );
+}
+
+timeline_window_t *timeline_get( timeline_t *tl, mtime_t t )
+{
+    int64_t w = t / tl->i_window;
+
+    if( !tl->b_started )
+    {
+        tl->i_head    = tl->i_tail = w;
+        tl->i_first   = w * tl->i_window;
+        tl->b_started = 1;
+    }
+
+    if( w > tl->i_head )
+    {
+        /* close the windows falling out of the ring */
+        while( tl->i_tail <= w - TIMELINE_RING )
+        {
+            if( tl->i_tail <= tl->i_head )
+                timeline_write( tl, tl->i_tail );
+            else    /* nothing left to write, jump */
+                tl->i_tail = w - TIMELINE_RING;
+
+            tl->i_tail++;
+        }
+        tl->i_head = w;
+    }
+    else if( w < tl->i_tail )
+    {
+        w = tl->i_tail;
+    }
+
+    return &tl->ring[w % TIMELINE_RING];
+}
+
+void timeline_destroy( timeline_t *tl )
+{
+    if( tl == NULL )
+        return;
+
+    if( tl->b_started )
+    {
+        for( ; tl->i_tail <= tl->i_head; tl->i_tail++ )
+            timeline_write( tl, tl->i_tail );
+    }
+
+    fclose( tl->fp );
+    free( tl );
+}
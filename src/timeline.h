@@ -0,0 +1,52 @@
+#ifndef _TIMELINE_H_
+#define _TIMELINE_H_
+
+#include <stdio.h>
+
+#include "xrtp.h"
+
+/*
+ * Per source metrics aggregated in fixed windows of capture time.
+ *
+ * Losses are only known when rtp_decode() gives up waiting, after the
+ * packets around them were received, so the last TIMELINE_RING windows
+ * stay open and are written once they are that old. Windows without any
+ * packet or event are not written.
+ */
+
+#define TIMELINE_RING   64
+
+typedef struct _timeline_window_t
+{
+    uint64_t i_bytes;
+    uint32_t i_packets;
+    uint32_t i_lost;
+    uint32_t i_reordered;
+    uint32_t i_duplicated;
+    uint32_t i_frames;          /* RTP timestamp changes */
+    uint32_t jitter_max;        /* us */
+
+}timeline_window_t;
+
+struct _timeline_t
+{
+    FILE     *fp;
+    mtime_t   i_window;         /* us */
+    mtime_t   i_first;          /* start of the first window */
+
+    int64_t   i_head;           /* newest window number */
+    int64_t   i_tail;           /* oldest window not written yet */
+    int       b_started;
+
+    timeline_window_t ring[TIMELINE_RING];
+
+};
+
+timeline_t *timeline_create( const char *psz_file, mtime_t i_window );
+/* writes the windows still open */
+void timeline_destroy( timeline_t *tl );
+
+/* window of capture time t, windows already written map to the oldest open one */
+timeline_window_t *timeline_get( timeline_t *tl, mtime_t t );
+
+#endif //_TIMELINE_H_
@@ -0,0 +1,315 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_printf.h>
+#include <xrtp_thread.h>
+#include <xrtp_bytes.h>
+
+#include "worker.h"
+#include "session.h"
+#include "rtcp.h"
+#include "spsc.h"
+#include "writer.h"
+
+#define WORKER_QUEUE_SIZE       4096
+#define WORKER_SPIN_COUNT       64
+
+#define WORKER_MSG_RTP          0
+#define WORKER_MSG_RTCP         1
+#define WORKER_MSG_FLUSH        2
+#define WORKER_MSG_STOP         3
+
+typedef struct _worker_msg_t
+{
+    block_t  *block;
+    mtime_t  prev;          /* arrival time of the previous dispatched packet */
+    uint8_t  i_type;
+
+}worker_msg_t;
+
+typedef struct _worker_t
+{
+    worker_pool_t *pool;
+
+    rtp_session_t *session;
+    spsc_t        *queue;
+
+    xrtp_thread_t thread;
+    uint8_t       b_running;
+
+}worker_t;
+
+struct _worker_pool_t
+{
+    const xrtp *h;
+
+    worker_t   *workers;
+    int        i_workers;
+
+    volatile uint32_t i_flushed;
+};
+
+static void worker_send( worker_t *w, const worker_msg_t *msg )
+{
+    int i_spin = 0;
+
+    /* the ring is bounded: wait for the worker to catch up */
+    while( spsc_push( w->queue, msg ) < 0 )
+    {
+        if( ++i_spin < WORKER_SPIN_COUNT )
+            xrtp_thread_yield();
+        else
+            xrtp_thread_sleep( 1 );
+    }
+}
+
+static void worker_process( worker_t *w, worker_msg_t *msg )
+{
+    const xrtp *h = w->pool->h;
+    block_t *block = msg->block;
+    mtime_t now = block->i_sample_time;
+
+    /* Catch up with the dequeue calls made for packets of other shards;
+     * rtp_dequeue() only depends on the latest time it is given. */
+    rtp_dequeue( h, w->session, msg->prev );
+
+    if( msg->i_type == WORKER_MSG_RTP )
+    {
+        if( rtp_queue( h, w->session, block ) < 0 )
+        {
+            block_free( block );
+            return;
+        }
+    }
+    else
+    {
+        int ret = rtcp_update( w->session, block );
+
+        block_free( block );
+
+        if( ret < 0 )
+            return;
+    }
+
+    rtp_dequeue( h, w->session, msg->prev > now ? msg->prev : now );
+}
+
+static XRTP_THREAD_FUNC( worker_thread, arg )
+{
+    worker_t *w = (worker_t *)arg;
+    worker_msg_t msg;
+    int i_spin = 0;
+
+    for( ; ; )
+    {
+        if( spsc_pop( w->queue, &msg ) < 0 )
+        {
+            if( ++i_spin < WORKER_SPIN_COUNT )
+                xrtp_thread_yield();
+            else
+                xrtp_thread_sleep( 1 );
+            continue;
+        }
+        i_spin = 0;
+
+        if( msg.i_type == WORKER_MSG_STOP )
+            break;
+
+        if( msg.i_type == WORKER_MSG_FLUSH )
+        {
+            rtp_dequeue( w->pool->h, w->session, _I64_MAX );
+            if( w->session->writer )
+                output_sync( w->session->writer );
+            xrtp_atomic_add( &w->pool->i_flushed, 1 );
+            continue;
+        }
+
+        worker_process( w, &msg );
+    }
+
+    XRTP_THREAD_RETURN;
+}
+
+worker_pool_t *worker_pool_create( const xrtp *h, int i_threads )
+{
+    worker_pool_t *pool;
+    int i;
+
+    assert( h );
+    assert( i_threads > 1 );
+
+    pool = (worker_pool_t *)calloc( 1, sizeof(worker_pool_t) );
+    if( pool == NULL )
+    {
+        xrtp_printf( XRTP_ERR, "worker_pool_create> can't alloc pool.\n" );
+        return NULL;
+    }
+
+    pool->h = h;
+
+    pool->workers = (worker_t *)calloc( i_threads, sizeof(worker_t) );
+    if( pool->workers == NULL )
+    {
+        xrtp_printf( XRTP_ERR, "worker_pool_create> can't alloc workers.\n" );
+        goto err_worker_pool_create;
+    }
+
+    for( i = 0; i < i_threads; i++ )
+    {
+        worker_t *w = &pool->workers[i];
+
+        w->pool    = pool;
+        w->session = rtp_session_create( 1 );
+        w->queue   = spsc_create( WORKER_QUEUE_SIZE, sizeof(worker_msg_t) );
+
+        pool->i_workers++;
+
+        if( w->session == NULL || w->queue == NULL )
+        {
+            xrtp_printf( XRTP_ERR, "worker_pool_create> can't create worker %d.\n", i );
+            goto err_worker_pool_create;
+        }
+
+        if( xrtp_thread_create( &w->thread, worker_thread, w ) < 0 )
+        {
+            xrtp_printf( XRTP_ERR, "worker_pool_create> can't start worker %d.\n", i );
+            goto err_worker_pool_create;
+        }
+        w->b_running = 1;
+    }
+
+    xrtp_printf( XRTP_OUT, "worker_pool_create> %d worker threads.\n", i_threads );
+
+    return pool;
+
+err_worker_pool_create:
+
+    worker_pool_destroy( pool );
+
+    return NULL;
+}
+
+void worker_pool_destroy( worker_pool_t *pool )
+{
+    worker_msg_t stop = { NULL, 0, WORKER_MSG_STOP };
+    int i;
+
+    if( pool == NULL )
+        return;
+
+    for( i = 0; i < pool->i_workers; i++ )
+    {
+        worker_t *w = &pool->workers[i];
+
+        if( w->b_running )
+        {
+            worker_send( w, &stop );
+            xrtp_thread_join( w->thread );
+        }
+
+        /* blocks still queued would only be there after a failed flush */
+        if( w->queue )
+        {
+            worker_msg_t msg;
+
+            while( spsc_pop( w->queue, &msg ) == 0 )
+                block_free( msg.block );
+
+            spsc_destroy( w->queue );
+        }
+
+        if( w->session )
+            rtp_session_destroy( w->session );
+    }
+
+    free( pool->workers );
+    free( pool );
+}
+
+static int worker_pool_shard( const worker_pool_t *pool, uint32_t ssrc )
+{
+    /* Fibonacci hashing, SSRCs are random but may be allocated sequentially */
+    return (int)(((uint64_t)(ssrc * 0x9E3779B1u) * pool->i_workers) >> 32);
+}
+
+int worker_pool_push( worker_pool_t *pool, block_t *block,
+                      uint8_t rtp_type, mtime_t prev )
+{
+    worker_msg_t msg;
+    int i;
+
+    msg.block = block;
+    msg.prev  = prev;
+
+    if( rtp_type == 0 )
+    {
+        uint32_t ssrc;
+
+        if( block->i_buffer < 12 )
+        {
+            block_free( block );
+            return -1;
+        }
+
+        ssrc = GetDWBE( block->p_buffer + 8 );
+
+        msg.i_type = WORKER_MSG_RTP;
+        worker_send( &pool->workers[worker_pool_shard( pool, ssrc )], &msg );
+
+        return 0;
+    }
+
+    /* RTCP: every worker gets its own copy */
+    msg.i_type = WORKER_MSG_RTCP;
+    for( i = 0; i < pool->i_workers; i++ )
+    {
+        block_t *copy = block;
+
+        if( i < pool->i_workers - 1 )
+        {
+            copy = block_alloc( block->i_buffer );
+            if( copy == NULL )
+            {
+                xrtp_printf( XRTP_ERR, "worker_pool_push> alloc block failed.\n" );
+                continue;
+            }
+
+            block_init( copy, block->p_buffer, block->i_buffer, block->i_sample_time );
+        }
+
+        msg.block = copy;
+        worker_send( &pool->workers[i], &msg );
+    }
+
+    return 0;
+}
+
+int worker_pool_flush( worker_pool_t *pool )
+{
+    worker_msg_t flush = { NULL, 0, WORKER_MSG_FLUSH };
+    uint32_t target;
+    int i;
+
+    target = xrtp_atomic_load( &pool->i_flushed ) + pool->i_workers;
+
+    for( i = 0; i < pool->i_workers; i++ )
+        worker_send( &pool->workers[i], &flush );
+
+    while( xrtp_atomic_load( &pool->i_flushed ) != target )
+        xrtp_thread_sleep( 1 );
+
+    return 0;
+}
+
+int worker_pool_count( const worker_pool_t *pool )
+{
+    return pool->i_workers;
+}
+
+rtp_session_t *worker_pool_session( worker_pool_t *pool, int i )
+{
+    assert( i >= 0 && i < pool->i_workers );
+
+    return pool->workers[i].session;
+}
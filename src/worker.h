@@ -0,0 +1,31 @@
+#ifndef _WORKER_H_
+#define _WORKER_H_
+
+#include <datatype.h>
+
+#include "xrtp.h"
+
+/*
+ * Per-SSRC sharded processing.
+ *
+ * The ingest thread hashes every RTP packet by SSRC and hands it to the
+ * worker owning that SSRC over a SPSC ring, so a stream is always handled
+ * by the same thread and in capture order. Each worker owns a private
+ * rtp_session_t. RTCP packets are copied to every worker, as a compound
+ * packet may refer to sources on several shards.
+ */
+
+worker_pool_t *worker_pool_create( const xrtp *h, int i_threads );
+void worker_pool_destroy( worker_pool_t *pool );
+
+/* takes ownership of block */
+int  worker_pool_push( worker_pool_t *pool, block_t *block,
+                       uint8_t rtp_type, mtime_t prev );
+
+/* dequeue all pending blocks and wait for the workers to be idle */
+int  worker_pool_flush( worker_pool_t *pool );
+
+int  worker_pool_count( const worker_pool_t *pool );
+rtp_session_t *worker_pool_session( worker_pool_t *pool, int i );
+
+#endif //_WORKER_H_
@@ -0,0 +1,394 @@
+/**
+ * @file writer.c
+ * @brief Asynchronous writes of the outputs: writer thread or io_uring
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+# include <io.h>
+#else
+# include <unistd.h>
+#endif
+
+#include <xrtp_printf.h>
+#include <xrtp_thread.h>
+
+#include "writer.h"
+
+#define WRITER_QUEUE_SIZE   (2 * WRITER_BUFFERS)
+#define WRITER_SPIN_COUNT   64
+
+#ifdef HAVE_LIBURING
+typedef struct _writer_uring_req_t
+{
+    writer_req_t req;
+    size_t       i_done;        /* written so far */
+
+}writer_uring_req_t;
+#endif
+
+static void *
+writer_alloc ( void )
+{
+#ifdef _WIN32
+    return _aligned_malloc( OUTPUT_BUFFER, OUTPUT_ALIGN );
+#else
+    void *p;
+
+    return posix_memalign( &p, OUTPUT_ALIGN, OUTPUT_BUFFER ) ? NULL : p;
+#endif
+}
+
+static void
+writer_free ( void *p )
+{
+#ifdef _WIN32
+    _aligned_free( p );
+#else
+    free( p );
+#endif
+}
+
+/**
+ * Gives a written buffer back, or frees it when there are enough.
+ */
+static void
+writer_done ( writer_t *w, writer_req_t *req )
+{
+    if( spsc_push( w->done, &req->p_buffer ) < 0 )
+        writer_free( req->p_buffer );
+
+    xrtp_atomic_add( req->pi_pending, (uint32_t)-1 );
+}
+
+static int
+writer_pwrite ( int fd, const uint8_t *p, size_t i_size, int64_t i_offset )
+{
+    while( i_size > 0 )
+    {
+#ifdef _WIN32
+        int i_ret;
+
+        if( _lseeki64( fd, i_offset, SEEK_SET ) < 0 )
+            return -1;
+        i_ret = _write( fd, p, (unsigned)(i_size > INT32_MAX ? INT32_MAX : i_size) );
+#else
+        ssize_t i_ret = pwrite( fd, p, i_size, (off_t)i_offset );
+
+        if( i_ret < 0 && errno == EINTR )
+            continue;
+#endif
+        if( i_ret <= 0 )
+            return -1;
+
+        p        += i_ret;
+        i_size   -= i_ret;
+        i_offset += i_ret;
+    }
+
+    return 0;
+}
+
+static XRTP_THREAD_FUNC( writer_thread, arg )
+{
+    writer_t *w = (writer_t *)arg;
+    writer_req_t req;
+    int i_spin = 0;
+
+    for( ; ; )
+    {
+        if( spsc_pop( w->queue, &req ) < 0 )
+        {
+            if( xrtp_atomic_load( &w->b_stop ) )
+                break;
+
+            if( ++i_spin < WRITER_SPIN_COUNT )
+                xrtp_thread_yield();
+            else
+                xrtp_thread_sleep( 1 );
+            continue;
+        }
+        i_spin = 0;
+
+        if( writer_pwrite( req.fd, req.p_buffer, req.i_size, req.i_offset ) < 0 )
+        {
+            xrtp_printf( XRTP_ERR, "writer_thread> write failed (%s).\n", strerror( errno ) );
+            xrtp_atomic_store( &w->b_error, 1 );
+        }
+
+        writer_done( w, &req );
+    }
+
+    XRTP_THREAD_RETURN;
+}
+
+#ifdef HAVE_LIBURING
+static void
+writer_uring_prep ( writer_t *w, writer_uring_req_t *r )
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe( &w->ring );
+
+    if( sqe == NULL )
+    {
+        /* submission queue full: hand it over and take a slot */
+        io_uring_submit( &w->ring );
+        sqe = io_uring_get_sqe( &w->ring );
+    }
+
+    io_uring_prep_write( sqe, r->req.fd, r->req.p_buffer + r->i_done,
+                         (unsigned)(r->req.i_size - r->i_done),
+                         (uint64_t)(r->req.i_offset + r->i_done) );
+    io_uring_sqe_set_data( sqe, r );
+}
+
+/**
+ * Reaps the completions, waiting for one if b_wait.
+ */
+static void
+writer_uring_reap ( writer_t *w, int b_wait )
+{
+    struct io_uring_cqe *cqe;
+
+    while( w->i_inflight > 0 )
+    {
+        writer_uring_req_t *r;
+        int i_ret = b_wait ? io_uring_wait_cqe( &w->ring, &cqe )
+                           : io_uring_peek_cqe( &w->ring, &cqe );
+
+        if( i_ret == -EINTR )
+            continue;
+        if( i_ret < 0 )
+            break;
+        b_wait = 0;
+
+        r = (writer_uring_req_t *)io_uring_cqe_get_data( cqe );
+        i_ret = cqe->res;
+        io_uring_cqe_seen( &w->ring, cqe );
+
+        if( i_ret > 0 && r->i_done + i_ret < r->req.i_size )
+        {
+            /* short write: the rest */
+            r->i_done += i_ret;
+            writer_uring_prep( w, r );
+            io_uring_submit( &w->ring );
+            continue;
+        }
+        if( i_ret <= 0 )
+        {
+            xrtp_printf( XRTP_ERR, "writer_uring_reap> write failed (%s).\n",
+                                   strerror( i_ret < 0 ? -i_ret : EIO ) );
+            w->b_error = 1;
+        }
+
+        writer_done( w, &r->req );
+        free( r );
+        w->i_inflight--;
+    }
+}
+#endif
+
+writer_t *writer_create( int i_backend )
+{
+    writer_t *w = (writer_t *)calloc( 1, sizeof(writer_t) );
+    unsigned i;
+
+    if( w == NULL )
+        return NULL;
+
+    w->i_backend = i_backend;
+
+    w->done = spsc_create( WRITER_BUFFERS, sizeof(uint8_t *) );
+    if( w->done == NULL )
+        goto err_writer_create;
+
+    for( i = 0; i < WRITER_BUFFERS; i++ )
+    {
+        uint8_t *p = (uint8_t *)writer_alloc();
+
+        if( p == NULL || spsc_push( w->done, &p ) < 0 )
+        {
+            writer_free( p );
+            goto err_writer_create;
+        }
+    }
+
+#ifdef HAVE_LIBURING
+    if( i_backend == WRITER_URING )
+    {
+        int i_ret = io_uring_queue_init( WRITER_QUEUE_SIZE, &w->ring, 0 );
+
+        if( i_ret < 0 )
+        {
+            xrtp_printf( XRTP_ERR, "writer_create> io_uring unavailable (%s), using a thread.\n",
+                                   strerror( -i_ret ) );
+            w->i_backend = WRITER_THREAD;
+        }
+        else
+        {
+            w->b_ring = 1;
+            return w;
+        }
+    }
+#else
+    if( i_backend == WRITER_URING )
+    {
+        xrtp_printf( XRTP_ERR, "writer_create> built without io_uring, using a thread.\n" );
+        w->i_backend = WRITER_THREAD;
+    }
+#endif
+
+    w->queue = spsc_create( WRITER_QUEUE_SIZE, sizeof(writer_req_t) );
+    if( w->queue == NULL )
+        goto err_writer_create;
+
+    if( xrtp_thread_create( &w->thread, writer_thread, w ) < 0 )
+    {
+        xrtp_printf( XRTP_ERR, "writer_create> can't start the writer thread.\n" );
+        goto err_writer_create;
+    }
+    w->b_running = 1;
+
+    return w;
+
+err_writer_create:
+
+    writer_destroy( w );
+
+    return NULL;
+}
+
+void writer_destroy( writer_t *w )
+{
+    uint8_t *p;
+
+    if( w == NULL )
+        return;
+
+    /* the outputs are closed, so nothing is in flight but their last writes */
+    if( w->b_running )
+    {
+        xrtp_atomic_store( &w->b_stop, 1 );
+        xrtp_thread_join( w->thread );
+    }
+#ifdef HAVE_LIBURING
+    if( w->b_ring )
+    {
+        while( w->i_inflight > 0 )
+            writer_uring_reap( w, 1 );
+        io_uring_queue_exit( &w->ring );
+    }
+#endif
+
+    spsc_destroy( w->queue );
+
+    if( w->done )
+    {
+        while( spsc_pop( w->done, &p ) == 0 )
+            writer_free( p );
+        spsc_destroy( w->done );
+    }
+
+    free( w );
+}
+
+uint8_t *writer_buffer( writer_t *w )
+{
+    uint8_t *p;
+    int i_spin = 0;
+
+    while( spsc_pop( w->done, &p ) < 0 )
+    {
+#ifdef HAVE_LIBURING
+        if( w->b_ring )
+        {
+            writer_uring_reap( w, 1 );
+            continue;
+        }
+#endif
+        if( ++i_spin < WRITER_SPIN_COUNT )
+            xrtp_thread_yield();
+        else
+            xrtp_thread_sleep( 1 );
+    }
+
+    return p;
+}
+
+int writer_submit( writer_t *w, const writer_req_t *req )
+{
+    int i_spin = 0;
+
+    xrtp_atomic_add( req->pi_pending, 1 );
+
+#ifdef HAVE_LIBURING
+    if( w->b_ring )
+    {
+        writer_uring_req_t *r = (writer_uring_req_t *)malloc( sizeof(writer_uring_req_t) );
+
+        if( r == NULL )
+        {
+            /* no memory for the request: written here */
+            writer_req_t copy = *req;
+            int i_ret = writer_pwrite( req->fd, req->p_buffer, req->i_size, req->i_offset );
+
+            writer_done( w, &copy );
+            return i_ret;
+        }
+
+        r->req    = *req;
+        r->i_done = 0;
+        writer_uring_prep( w, r );
+        io_uring_submit( &w->ring );
+        w->i_inflight++;
+
+        writer_uring_reap( w, 0 );
+
+        return w->b_error ? -1 : 0;
+    }
+#endif
+
+    while( spsc_push( w->queue, req ) < 0 )
+    {
+        if( ++i_spin < WRITER_SPIN_COUNT )
+            xrtp_thread_yield();
+        else
+            xrtp_thread_sleep( 1 );
+    }
+
+    return xrtp_atomic_load( &w->b_error ) ? -1 : 0;
+}
+
+void writer_wait( writer_t *w, volatile uint32_t *pi_pending )
+{
+    int i_spin = 0;
+
+#ifndef HAVE_LIBURING
+    (void)w;
+#endif
+    while( xrtp_atomic_load( pi_pending ) > 0 )
+    {
+#ifdef HAVE_LIBURING
+        if( w->b_ring )
+        {
+            writer_uring_reap( w, 1 );
+            continue;
+        }
+#endif
+        if( ++i_spin < WRITER_SPIN_COUNT )
+            xrtp_thread_yield();
+        else
+            xrtp_thread_sleep( 1 );
+    }
+}
+
+int writer_error( writer_t *w )
+{
+    return xrtp_atomic_load( &w->b_error ) ? -1 : 0;
+}
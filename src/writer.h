@@ -0,0 +1,79 @@
+#ifndef _WRITER_H_
+#define _WRITER_H_
+
+#include <datatype.h>
+#include <xrtp_thread.h>
+
+#ifdef HAVE_LIBURING
+# include <liburing.h>
+#endif
+
+#include "output.h"
+#include "spsc.h"
+
+/*
+ * Asynchronous backend of the outputs: the analysis thread hands full
+ * output buffers over and goes on, the writes happen elsewhere.
+ *  - thread: a writer thread fed by a SPSC ring, the written buffers
+ *            come back on a second ring,
+ *  - uring:  io_uring (Linux, HAVE_LIBURING), submitted and reaped by
+ *            the analysis thread itself.
+ *
+ * There is one writer per session, so per analysis thread, hence single
+ * producer. In flight memory is bounded: WRITER_BUFFERS buffers of
+ * OUTPUT_BUFFER bytes circulate, an output swapping its full buffer
+ * for a written one, and waiting when there is none.
+ */
+
+#define WRITER_THREAD       1
+#define WRITER_URING        2
+
+#define WRITER_BUFFERS      32
+
+typedef struct _writer_req_t
+{
+    int       fd;
+    uint8_t  *p_buffer;
+    size_t    i_size;
+    int64_t   i_offset;
+    volatile uint32_t *pi_pending;  /* of the output, decremented when written */
+
+}writer_req_t;
+
+struct _writer_t
+{
+    int       i_backend;
+
+    spsc_t   *queue;            /* requests to the writer thread */
+    spsc_t   *done;             /* written buffers, WRITER_BUFFERS at most */
+
+    xrtp_thread_t thread;
+    uint8_t   b_running;
+    volatile uint32_t b_stop;
+    volatile uint32_t b_error;
+
+#ifdef HAVE_LIBURING
+    struct io_uring ring;
+    uint8_t   b_ring;
+    unsigned  i_inflight;
+#endif
+
+    output_t *outputs;          /* open outputs of the session, see output_sync() */
+
+};
+
+writer_t *writer_create( int i_backend );
+/* waits for the writes in flight */
+void      writer_destroy( writer_t *w );
+
+/* a written buffer to fill, waits if they are all in flight */
+uint8_t  *writer_buffer( writer_t *w );
+/* takes the buffer, req->pi_pending is incremented */
+int       writer_submit( writer_t *w, const writer_req_t *req );
+/* waits until *pi_pending is 0 */
+void      writer_wait( writer_t *w, volatile uint32_t *pi_pending );
+
+/* a write failed */
+int       writer_error( writer_t *w );
+
+#endif //_WRITER_H_
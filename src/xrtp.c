@@ -8,6 +8,13 @@
 #include "payload.h"
 #include "session.h"    /* CLOCK_FREQ */
 #include "rtp.h"
+#include "lossmap.h"    /* LOSSMAP_INTERVAL */
+#include "jbsim.h"
+#include "annexb.h"
+#include "output.h"
+#include "writer.h"
+#include "archive.h"
+#include "mp4.h"
 
 #include "pcap_interface.h"
 
@@ -29,6 +36,36 @@ typedef struct _main_arg
 
     uint8_t b_write_sei;
 
+    uint8_t b_write_index;
+
+    int threads;
+
+    uint8_t b_summary;
+
+    uint8_t extmap[256];
+
+    uint8_t b_gcc;
+
+    int window;
+
+    uint8_t b_xr;
+
+    uint8_t b_deskew;
+
+    uint8_t  b_avsync_cname;
+    uint32_t avsync[2 * XRTP_AVSYNC_MAXIMUM];
+    unsigned i_avsync;
+
+    xrtp_jb_t jb[XRTP_JB_MAXIMUM];
+    unsigned  i_jb;
+
+    int lookahead;
+    int lookahead_ms;
+
+    char archive[PCAP_FILE_NAME_MAXIMUN];
+
+    int fmp4;
+
     char filename[PCAP_FILE_NAME_MAXIMUN];
 
 }main_arg;
@@ -40,6 +77,19 @@ main_arg g_arg =
         .b_mux       = 0,
         .b_print     = 0,
         .b_write_sei = 0,
+        .b_write_index = 0,
+        .threads     = 1,
+        .b_summary   = 0,
+        .b_gcc       = 0,
+        .window      = 0,
+        .b_xr        = 0,
+        .b_deskew    = 0,
+        .b_avsync_cname = 0,
+        .i_avsync    = 0,
+        .i_jb        = 0,
+        .lookahead   = 0,
+        .lookahead_ms = 0,
+        .fmp4        = 0,
     };
 
 static void usage(void);
@@ -124,7 +174,7 @@ static payload_des *set_des( main_arg *argsp )
             prev = des;
         }
         else
-            start = des;
+            start = prev = des;
     }
 
     return start;
@@ -139,6 +189,8 @@ err_set_des:
 int main(int argc, char **argv)
 {
     payload_des *des;
+    const char  *psz_kernel;
+    unsigned     i_files;
 
     xrtp *h = (xrtp *)NULL;
 
@@ -152,6 +204,11 @@ int main(int argc, char **argv)
 
     des = set_des( &g_arg );
 
+    psz_kernel = annexb_init();
+    i_files    = output_init( i_output_files );
+    xrtp_printf( XRTP_DBG, "main> annex b kernel: %s\n", psz_kernel );
+    xrtp_printf( XRTP_DBG, "main> output files open at most: %u\n", i_files );
+
     pcap_file_args file_arg;
 
     strncpy( file_arg.filename, g_arg.filename, PCAP_FILE_NAME_MAXIMUN );
@@ -163,8 +220,34 @@ int main(int argc, char **argv)
         goto err_main;
     }
 
+    if( g_arg.archive[0] )
+    {
+        p_archive = archive_open( g_arg.archive, i_output_flags );
+        if( p_archive == NULL )
+            goto err_main;
+    }
+
     /* xrtp create */
-    h = xrtp_create( des, g_arg.b_mux, g_arg.b_print );
+    xrtp_param_t param = { 0 };
+
+    param.b_mux       = g_arg.b_mux;
+    param.b_print_out = g_arg.b_print;
+    param.i_threads   = g_arg.threads;
+    memcpy( param.extmap, g_arg.extmap, sizeof(param.extmap) );
+    param.b_gcc       = g_arg.b_gcc;
+    param.b_stats     = g_arg.b_summary;
+    param.i_window    = (mtime_t)g_arg.window * 1000;
+    param.b_xr        = g_arg.b_xr;
+    param.b_deskew    = g_arg.b_deskew;
+    param.b_avsync_cname = g_arg.b_avsync_cname;
+    param.i_avsync    = g_arg.i_avsync;
+    memcpy( param.avsync, g_arg.avsync, sizeof(param.avsync) );
+    param.i_jb        = g_arg.i_jb;
+    memcpy( param.jb, g_arg.jb, sizeof(param.jb) );
+    param.i_lookahead = g_arg.lookahead;
+    param.i_lookahead_time = (mtime_t)g_arg.lookahead_ms * 1000;
+
+    h = xrtp_create( des, &param );
     if( h == (xrtp *)NULL )
     {
         fprintf( stderr, "main> xrtp create failed.\n" );
@@ -198,10 +281,16 @@ int main(int argc, char **argv)
 
     xrtp_flush( h );
 
+    if( g_arg.b_summary )
+        xrtp_report( h, stdout );
+
 err_main:
 
     if( h )
         xrtp_free( h );
+
+    /* after the sources, which write their last frames */
+    archive_close( p_archive );
         
     if ( p ) {
         pcap_interface_destroy( p );
@@ -240,13 +329,58 @@ static void usage(void)
         "-r | --result                      print analyzing result [%d].\n", g_arg.b_print );
     fprintf( stderr,
         "-s | --sei                         write sei with rtp timestamp [%d].\n", g_arg.b_write_sei );
+    fprintf( stderr,
+        "-i | --index                       write a record per frame of the .es to .es.idx [%d].\n", g_arg.b_write_index );
+    fprintf( stderr,
+        "-S | --summary                     print per source summary at the end [%d].\n", g_arg.b_summary );
+    fprintf( stderr,
+        "-t | --threads <d>                 worker threads, sources are sharded by ssrc [%d].\n", g_arg.threads );
+    fprintf( stderr,
+        "-x | --extmap <id:uri>             rtp header extension id (rfc 8285), uri or short name\n"
+        "                                       (abs-send-time, transport-cc, audio-level,\n"
+        "                                        video-orientation, mid, toffset)\n" );
+    fprintf( stderr,
+        "-g | --gcc                         replay the gcc delay-based bandwidth estimator,\n"
+        "                                   timeline written to pt<pt>_<ssrc>.gcc [%d].\n", g_arg.b_gcc );
+    fprintf( stderr,
+        "-w | --window <ms>                 per source timeline of <ms> windows,\n"
+        "                                   written to pt<pt>_<ssrc>.tl [%d].\n", g_arg.window );
+    fprintf( stderr,
+        "-X | --xr                          write rfc 3611 loss/duplicate rle per %d packets\n"
+        "                                   to pt<pt>_<ssrc>.xr [%d].\n", LOSSMAP_INTERVAL, g_arg.b_xr );
+    fprintf( stderr,
+        "-D | --deskew                      correct jitter and pts - pcr for the estimated\n"
+        "                                   rtp clock drift [%d].\n", g_arg.b_deskew );
+    fprintf( stderr,
+        "-l | --lipsync <cname|a:v>         audio/video sync of the sources with the same cname,\n"
+        "                                   or of audio ssrc a and video ssrc v.\n" );
+    fprintf( stderr,
+        "-j | --jitterbuffer <type:k,...>   simulate jitter buffers for the summary, type is\n"
+        "                                   fixed:<ms>, jitter:<k> or ramjee:<k> (up to %d).\n", XRTP_JB_MAXIMUM );
+    fprintf( stderr,
+        "-R | --reorder <n|<n>ms>           offline reordering: wait for a missing packet until\n"
+        "                                   n packets are queued, or n ms after the next one,\n"
+        "                                   instead of 3 times the jitter.\n" );
+    fprintf( stderr,
+        "-o | --output <direct,prealloc,    .es files written with O_DIRECT and/or preallocated\n"
+        "                async|uring,       by %d MB (linux), by a writer thread or io_uring,\n"
+        "                files=<n>>         at most %d MB in flight per thread, with at most n\n"
+        "                                   files open (default: the descriptor limit).\n",
+        OUTPUT_PREALLOC >> 20, (WRITER_BUFFERS * OUTPUT_BUFFER) >> 20 );
+    fprintf( stderr,
+        "-a | --archive <file>              all the frames to one indexed archive instead of\n"
+        "                                   the .es files.\n" );
+    fprintf( stderr,
+        "-f | --fmp4 <n>                    h264/h265 to a fragmented pt<pt>_<ssrc>.mp4 instead\n"
+        "                                   of the .es, n frames per fragment (up to %d) [%d].\n",
+        MP4_FRAGMENT_MAXIMUM, g_arg.fmp4 );
     fprintf( stderr,
         "-h | --help                        print this message.\n\n");
 }
 
 static int parseArgs(int argc, char *argv[], main_arg *argsp)
 {
-    const char shortOptions[] = "mp:d:rsh";
+    const char shortOptions[] = "mp:d:rsiSt:x:gw:XDl:j:R:o:a:f:h";
 
     const struct option longOptions[] = {
         { "mux",       no_argument,       NULL, 'm' },  
@@ -254,6 +388,20 @@ static int parseArgs(int argc, char *argv[], main_arg *argsp)
         { "descript",  required_argument, NULL, 'd' },
         { "result",    no_argument,       NULL, 'r' },
         { "sei",       no_argument,       NULL, 's' },
+        { "index",     no_argument,       NULL, 'i' },
+        { "summary",   no_argument,       NULL, 'S' },
+        { "threads",   required_argument, NULL, 't' },
+        { "extmap",    required_argument, NULL, 'x' },
+        { "gcc",       no_argument,       NULL, 'g' },
+        { "window",    required_argument, NULL, 'w' },
+        { "xr",        no_argument,       NULL, 'X' },
+        { "deskew",    no_argument,       NULL, 'D' },
+        { "lipsync",   required_argument, NULL, 'l' },
+        { "jitterbuffer", required_argument, NULL, 'j' },
+        { "reorder",   required_argument, NULL, 'R' },
+        { "output",    required_argument, NULL, 'o' },
+        { "archive",   required_argument, NULL, 'a' },
+        { "fmp4",      required_argument, NULL, 'f' },
         { "help",      no_argument,       NULL, 'h' },
         {0, 0, 0, 0}
     };
@@ -312,6 +460,142 @@ static int parseArgs(int argc, char *argv[], main_arg *argsp)
                 b_write_sei = true;
                 break;
 
+            case 'i':
+                argsp->b_write_index = true;
+                b_write_index = true;
+                break;
+
+            case 'S':
+                argsp->b_summary = true;
+                break;
+
+            case 't':
+                if( sscanf( optarg, "%d", &argsp->threads ) != 1 || argsp->threads < 1 )
+                {
+                    fprintf( stderr, "parseArgs> threads format error.\n" );
+                    return -1;
+                }
+
+                break;
+
+            case 'x':
+                if( rtp_ext_map( argsp->extmap, optarg ) < 0 )
+                {
+                    fprintf( stderr, "parseArgs> extmap format error (%s).\n", optarg );
+                    return -1;
+                }
+
+                break;
+
+            case 'g':
+                argsp->b_gcc = true;
+                break;
+
+            case 'X':
+                argsp->b_xr = true;
+                break;
+
+            case 'D':
+                argsp->b_deskew = true;
+                break;
+
+            case 'l':
+            {
+                unsigned long a, v = 0;
+                char *psz_end;
+
+                if( strcmp( optarg, "cname" ) == 0 )
+                {
+                    argsp->b_avsync_cname = true;
+                    break;
+                }
+
+                /* ssrcs are 32 bits unsigned, decimal or 0x */
+                a = strtoul( optarg, &psz_end, 0 );
+                if( psz_end == optarg || *psz_end != ':' )
+                    psz_end = NULL;
+                else
+                {
+                    const char *psz_v = psz_end + 1;
+
+                    v = strtoul( psz_v, &psz_end, 0 );
+                    if( psz_end == psz_v || *psz_end )
+                        psz_end = NULL;
+                }
+
+                if( argsp->i_avsync >= XRTP_AVSYNC_MAXIMUM || psz_end == NULL
+                 || a > 0xFFFFFFFFUL || v > 0xFFFFFFFFUL )
+                {
+                    fprintf( stderr, "parseArgs> lipsync format error.\n" );
+                    return -1;
+                }
+
+                argsp->avsync[2 * argsp->i_avsync]     = (uint32_t)a;
+                argsp->avsync[2 * argsp->i_avsync + 1] = (uint32_t)v;
+                argsp->i_avsync++;
+                break;
+            }
+
+            case 'j':
+                if( jbsim_parse( optarg, argsp->jb, &argsp->i_jb ) < 0 )
+                {
+                    fprintf( stderr, "parseArgs> jitterbuffer format error (%s).\n", optarg );
+                    return -1;
+                }
+
+                break;
+
+            case 'R':
+            {
+                char psz_unit[3] = "";
+                int  n;
+
+                if( sscanf( optarg, "%d%2s", &n, psz_unit ) < 1 || n < 1
+                 || ( psz_unit[0] && strcmp( psz_unit, "ms" ) ) )
+                {
+                    fprintf( stderr, "parseArgs> reorder format error (%s).\n", optarg );
+                    return -1;
+                }
+
+                argsp->lookahead    = psz_unit[0] ? 0 : n;
+                argsp->lookahead_ms = psz_unit[0] ? n : 0;
+                break;
+            }
+
+            case 'o':
+                if( output_parse( optarg, &i_output_flags, &i_output_files ) < 0 )
+                {
+                    fprintf( stderr, "parseArgs> output format error (%s).\n", optarg );
+                    return -1;
+                }
+
+                break;
+
+            case 'a':
+                strncpy( argsp->archive, optarg, PCAP_FILE_NAME_MAXIMUN - 1 );
+
+                break;
+
+            case 'f':
+                if( sscanf( optarg, "%d", &argsp->fmp4 ) != 1
+                 || argsp->fmp4 < 1 || argsp->fmp4 > MP4_FRAGMENT_MAXIMUM )
+                {
+                    fprintf( stderr, "parseArgs> fmp4 format error.\n" );
+                    return -1;
+                }
+
+                i_mp4_fragment = argsp->fmp4;
+                break;
+
+            case 'w':
+                if( sscanf( optarg, "%d", &argsp->window ) != 1 || argsp->window < 1 )
+                {
+                    fprintf( stderr, "parseArgs> window format error.\n" );
+                    return -1;
+                }
+
+                break;
+
             case 'h':
             default:
                 usage();
@@ -4,6 +4,7 @@
 #include <datatype.h>
 
 #include "sdp.h"
+#include "rtpext.h"
 
 #ifdef HAVE_VLD
 #   include <vld.h>
@@ -27,6 +28,13 @@ struct _block_t
 
     int32_t     i_jitter;
 
+    /* picture tags set by the depacketizer */
+    int8_t      i_temporal_id;  /* -1 if unknown */
+    int8_t      i_reference;    /* 1 used for reference, 0 not, -1 unknown */
+    uint8_t     i_key;          /* FRAME_KEY_*, 0 if not a random access point */
+
+    rtp_ext_t   ext;          /* RFC 8285 header extensions */
+
     unsigned    i_nb_samples; /* Used for audio */
     int         i_rate;
 
@@ -34,6 +42,19 @@ struct _block_t
     uint8_t     *p_buffer;
 };
 
+typedef struct _rtcp_source_t rtcp_source_t;
+typedef struct _rtcp_fb_t rtcp_fb_t;
+typedef struct _gcc_t gcc_t;
+typedef struct _stats_t stats_t;
+typedef struct _timeline_t timeline_t;
+typedef struct _lossmap_t lossmap_t;
+typedef struct _pdv_t pdv_t;
+typedef struct _drift_t drift_t;
+typedef struct _avsync_t avsync_t;
+typedef struct _jbsim_t jbsim_t;
+typedef struct _frame_asm_t frame_asm_t;
+typedef struct _impact_t impact_t;
+
 typedef struct _rtp_pt_t
 {
     intptr_t   (*init) ( void * );
@@ -50,6 +71,7 @@ typedef struct _rtp_source_t
     uint32_t avg_jitter;  /* interarrival delay jitter estimate */
     mtime_t  last_rx;     /* last received packet local timestamp */
     uint32_t last_ts;     /* last received packet RTP timestamp */
+    int64_t  ext_ts;      /* last_ts unwrapped, arrival order */
 
     uint32_t ref_rtp;     /* sender RTP timestamp reference */
     mtime_t  ref_ntp;     /* sender NTP timestamp reference */
@@ -59,13 +81,58 @@ typedef struct _rtp_source_t
 
     uint16_t last_seq;    /* sequence of the next dequeued packet */
     block_t *blocks;      /* re-ordered blocks queue */
+    unsigned i_queued;    /* blocks in the queue */
+    unsigned i_queued_max;
+
+    uint64_t i_reordered; /* arrived before a lower sequence */
+    uint64_t i_lost;      /* given up when dequeued */
+    uint64_t i_late;      /* given up, then arrived */
+
+    rtcp_source_t *control; /* RTCP state, NULL until the first report */
+    rtcp_fb_t     *fb;      /* RTCP feedback log, NULL until needed */
+    rtp_ext_source_t *ext;  /* header extension state, NULL until needed */
+    gcc_t         *gcc;     /* bandwidth estimator replay, NULL if disabled */
+    stats_t       *stats;   /* histograms for the summary, NULL if disabled */
+    timeline_t    *tl;      /* windowed metrics, NULL if disabled */
+    lossmap_t     *lm;      /* receive status bitmaps, NULL if disabled */
+    pdv_t         *pdv;     /* delay variation, NULL if disabled */
+    drift_t       *drift;   /* RTP clock drift, NULL if disabled */
+    jbsim_t       *jb;      /* jitter buffer simulation, NULL if disabled */
+    frame_asm_t   *fa;      /* frames for the statistics, NULL if disabled */
+    impact_t      *impact;  /* loss impact on the frames, NULL if disabled */
     
     intptr_t   op;        /* Per-source private payload data handle */
     rtp_pt_t   pt;        /* PT specified functions */
 }rtp_source_t;
 
+#define RTCP_SR_HISTORY     8
+
+/** Sender report, as received */
+typedef struct _rtcp_sr_t
+{
+    uint64_t ntp;         /* NTP timestamp, 32.32 fixed point */
+    uint32_t rtp;         /* RTP timestamp of the same instant */
+    uint32_t packets;     /* sender's packet count */
+    uint32_t octets;      /* sender's octet count */
+    mtime_t  rx;          /* local receive time */
+}rtcp_sr_t;
+
+/** Last reception report block about a source */
+typedef struct _rtcp_rb_t
+{
+    uint32_t reporter;    /* SSRC of the receiver sending the report */
+    uint8_t  fraction;    /* fraction lost since last report, 1/256 */
+    int32_t  lost;        /* cumulative number of packets lost */
+    uint32_t ext_max_seq; /* extended highest sequence received */
+    uint32_t jitter;      /* interarrival jitter, RTP timestamp units */
+    uint32_t lsr;         /* last SR timestamp */
+    uint32_t dlsr;        /* delay since last SR, 1/65536 s */
+    mtime_t  rx;          /* local receive time */
+    mtime_t  rtt;         /* round trip time derived from lsr/dlsr, -1 if unknown */
+}rtcp_rb_t;
+
 /** State for an RTCP source */
-typedef struct _rtcp_source_t
+struct _rtcp_source_t
 {
     uint32_t ssrc;
     uint32_t jitter;      /* interarrival delay jitter estimate */
@@ -77,18 +144,79 @@ typedef struct _rtcp_source_t
     mtime_t  ref_rx;      /* receive time reference */
 
     uint32_t inaccuracy;  /* RTCP inaccuracy */
-}rtcp_source_t;
+
+    rtcp_sr_t sr[RTCP_SR_HISTORY]; /* sender reports, ring */
+    unsigned  i_sr;       /* number of sender reports received */
+
+    rtcp_rb_t rb;         /* last reception report about this source */
+    unsigned  i_rb;       /* number of reception reports received */
+
+    char      cname[256]; /* SDES CNAME, empty if unknown */
+
+    unsigned  i_sdes;
+    unsigned  i_bye;
+    unsigned  i_app;
+    unsigned  i_xr;
+    uint64_t  xr_rrtr;    /* last XR receiver reference time */
+};
 
 /** State for a RTP session: */
 typedef struct _rtp_session_t
 {
-    rtp_source_t  *srcv[32];
+    rtp_source_t **srcv;    /* grows by doubling */
     unsigned       srcc;
+    unsigned       i_srcv;  /* allocated */
+    rtp_source_t **srch;    /* by SSRC, linear probing, 2 * i_srcv slots */
 
-    rtcp_source_t  *control;
+    avsync_t      *avsync;  /* audio/video pairs, NULL if disabled */
+    struct _writer_t *writer;   /* asynchronous outputs, NULL if synchronous */
 
 }rtp_session_t;
 
+#define XRTP_AVSYNC_MAXIMUM     16
+#define XRTP_JB_MAXIMUM         32
+
+/** Simulated jitter buffer strategy */
+typedef struct _xrtp_jb_t
+{
+    uint8_t  i_type;        /**< JB_FIXED, JB_JITTER or JB_RAMJEE */
+    double   f_param;       /**< ms for fixed, jitter multiple otherwise */
+
+}xrtp_jb_t;
+
+/** User settings of a xrtp handle */
+typedef struct _xrtp_param_t
+{
+    uint8_t  b_mux;
+    uint8_t  b_print_out;
+
+    int      i_threads;     /**< > 1: shard sources over worker threads */
+
+    uint8_t  extmap[256];   /**< header extension ID to RTP_EXT_* type */
+
+    uint8_t  b_gcc;         /**< replay the delay-based bandwidth estimator */
+    uint8_t  b_stats;       /**< per source histograms for the summary */
+
+    mtime_t  i_window;      /**< > 0: timeline window (us) */
+
+    uint8_t  b_xr;          /**< write loss/duplicate RLE per source */
+
+    uint8_t  b_deskew;      /**< correct jitter and PTS - PCR for the clock drift */
+
+    uint8_t  b_avsync_cname;                    /**< pair audio/video by CNAME */
+    uint32_t avsync[2 * XRTP_AVSYNC_MAXIMUM];   /**< audio, video ssrc pairs */
+    unsigned i_avsync;
+
+    xrtp_jb_t jb[XRTP_JB_MAXIMUM];  /**< simulated jitter buffers */
+    unsigned  i_jb;
+
+    unsigned i_lookahead;   /**< > 0: wait for missing packets up to i_lookahead queued packets */
+    mtime_t  i_lookahead_time; /**< > 0: or up to this time (us) after the next packet */
+
+}xrtp_param_t;
+
+typedef struct _worker_pool_t worker_pool_t;
+
 #ifdef xrtp
 # undef xrtp
 #endif
@@ -102,8 +230,11 @@ typedef struct _xrtp
     uint16_t      max_dropout;  /**< Max packet forward misordering */
     uint16_t      max_misorder; /**< Max packet backward misordering */
 
-    uint8_t  b_mux;
-    uint8_t  b_print_out;
+    xrtp_param_t  param;
+
+    worker_pool_t *pool;        /**< NULL in single-threaded mode */
+    mtime_t       i_last_time;  /**< arrival time of the last dispatched packet */
+
     uint8_t  b_first_line;
 
 }xrtp;
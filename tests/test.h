@@ -0,0 +1,52 @@
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+ * Regression tests, run by ctest: a test program checks and goes on,
+ * then returns the number of failed checks.
+ */
+
+static int i_test_failed = 0;
+
+#define TEST_CHECK( cond ) \
+    do { \
+        if( !(cond) ) \
+        { \
+            fprintf( stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #cond ); \
+            i_test_failed++; \
+        } \
+    } while( 0 )
+
+#define TEST_RESULT() \
+    (printf( "%s: %s\n", __FILE__, i_test_failed ? "FAILED" : "ok" ), i_test_failed)
+
+/* a whole file written by the test, NULL if it can't be read */
+static inline uint8_t *test_load( const char *psz_file, size_t *pi_size )
+{
+    FILE *f = fopen( psz_file, "rb" );
+    uint8_t *p = NULL;
+    long i_size;
+
+    if( f == NULL )
+        return NULL;
+    if( fseek( f, 0, SEEK_END ) == 0 && (i_size = ftell( f )) > 0 )
+    {
+        p = (uint8_t *)malloc( i_size );
+        rewind( f );
+        if( p && fread( p, 1, i_size, f ) != (size_t)i_size )
+        {
+            free( p );
+            p = NULL;
+        }
+        *pi_size = (size_t)i_size;
+    }
+    fclose( f );
+
+    return p;
+}
+
+#endif //_TEST_H_
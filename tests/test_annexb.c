@@ -0,0 +1,162 @@
+/**
+ * @file test_annexb.c
+ * @brief Start code search and unescape kernels against the plain C one
+ *
+ * Exhaustive on short buffers: a 00 00 01 at every position and every
+ * alignment, cut by the end of the buffer, and the near misses. Every
+ * kernel the CPU runs must find the same start codes as the C kernel,
+ * whose results are checked against the definition. The unescape runs
+ * on random runs of 00, 03 and other bytes, to a copy and in place.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "annexb.h"
+
+#define TEST_SIZE   160     /* several 32 bytes blocks */
+#define TEST_ALIGN  64
+#define TEST_ROUNDS 2000
+
+static const char *kernels[] = { "c", "sse2", "avx2", "neon" };
+
+/* the definition */
+static const uint8_t *find_ref( const uint8_t *p, const uint8_t *p_end )
+{
+    for( ; p_end - p >= 3; p++ )
+    {
+        if( p[0] == 0 && p[1] == 0 && p[2] == 1 )
+            return p;
+    }
+    return p_end;
+}
+
+/* the definition: a 03 after two zeros is dropped, and counts as non zero */
+static int unescape_ref( uint8_t *p_dst, const uint8_t *p_src, int i_src )
+{
+    int i, i_out = 0, i_zeros = 0;
+
+    for( i = 0; i < i_src; i++ )
+    {
+        if( i_zeros >= 2 && p_src[i] == 3 )
+        {
+            i_zeros = 0;
+            continue;
+        }
+        i_zeros = p_src[i] ? 0 : i_zeros + 1;
+        p_dst[i_out++] = p_src[i];
+    }
+
+    return i_out;
+}
+
+static void check( const char *psz_kernel, const uint8_t *p, size_t i_size )
+{
+    const uint8_t *p_end = p + i_size;
+    const uint8_t *s, *r;
+
+    /* every start code, as a demuxer walks them */
+    for( s = p, r = p; ; s += 3, r += 3 )
+    {
+        s = annexb_find_startcode( s, p_end );
+        r = find_ref( r, p_end );
+        if( s != r )
+        {
+            fprintf( stderr, "%s: %td instead of %td in %zu bytes\n",
+                     psz_kernel, s - p, r - p, i_size );
+            i_test_failed++;
+            return;
+        }
+        if( s == p_end )
+            break;
+    }
+}
+
+static void test_kernel( const char *psz_kernel )
+{
+    static uint8_t buffer[TEST_ALIGN + TEST_SIZE + TEST_ALIGN];
+    uint8_t *base = buffer + TEST_ALIGN - ((uintptr_t)buffer % TEST_ALIGN);
+    unsigned i_align, i_pos, i_size;
+
+    for( i_align = 0; i_align < TEST_ALIGN; i_align += 7 )
+    {
+        uint8_t *p = base + i_align;
+
+        for( i_size = 0; i_size <= TEST_SIZE; i_size += i_size < 40 ? 1 : 13 )
+        {
+            for( i_pos = 0; i_pos < i_size + 2; i_pos++ )
+            {
+                /* zeros and ones around: 00 00 00 and 01 01 01 runs */
+                memset( p, i_pos & 1 ? 0x00 : 0x01, i_size );
+
+                /* a start code, maybe cut by the end */
+                if( i_pos < i_size ) p[i_pos] = 0;
+                if( i_pos + 1 < i_size ) p[i_pos + 1] = 0;
+                if( i_pos + 2 < i_size ) p[i_pos + 2] = 1;
+                check( psz_kernel, p, i_size );
+
+                /* 00 00 02 and 00 00 03: not start codes */
+                if( i_pos + 2 < i_size )
+                {
+                    p[i_pos + 2] = i_pos & 2 ? 2 : 3;
+                    check( psz_kernel, p, i_size );
+                }
+            }
+        }
+    }
+}
+
+static void test_unescape( const char *psz_kernel )
+{
+    static const uint8_t alphabet[] = { 0x00, 0x00, 0x00, 0x03, 0x03, 0x01, 0x80 };
+    static uint8_t src[TEST_ALIGN + TEST_SIZE], dst[TEST_SIZE], ref[TEST_SIZE];
+    uint32_t i_seed = 1;
+    unsigned i_round;
+
+    for( i_round = 0; i_round < TEST_ROUNDS; i_round++ )
+    {
+        uint8_t *p = src + i_round % TEST_ALIGN;
+        int i_size = (int)(i_round % (TEST_SIZE + 1));
+        int i, i_ref, i_out;
+
+        for( i = 0; i < i_size; i++ )
+        {
+            i_seed = i_seed * 1103515245 + 12345;
+            p[i] = alphabet[(i_seed >> 16) % sizeof(alphabet)];
+        }
+
+        i_ref = unescape_ref( ref, p, i_size );
+
+        i_out = annexb_unescape( dst, p, i_size );
+        if( i_out != i_ref || memcmp( dst, ref, i_ref ) )
+        {
+            fprintf( stderr, "%s: unescape of %d bytes differs\n", psz_kernel, i_size );
+            i_test_failed++;
+            return;
+        }
+
+        i_out = annexb_unescape( p, p, i_size );
+        if( i_out != i_ref || memcmp( p, ref, i_ref ) )
+        {
+            fprintf( stderr, "%s: unescape of %d bytes in place differs\n", psz_kernel, i_size );
+            i_test_failed++;
+            return;
+        }
+    }
+}
+
+int main( void )
+{
+    unsigned k;
+
+    for( k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++ )
+    {
+        if( annexb_select( kernels[k] ) < 0 )
+            continue;
+        test_kernel( kernels[k] );
+        test_unescape( kernels[k] );
+        printf( "%s kernel checked\n", kernels[k] );
+    }
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,164 @@
+/**
+ * @file test_archive.c
+ * @brief Archive written by archive_write(), read back by its layout
+ *
+ * Enough frames for three index segments, from three sources whose
+ * arrivals go back now and then. The reader follows archive.h only: it
+ * walks the segments from the trailer, checks each entry against its
+ * record and the frame bytes, then walks the records from the header.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_bytes.h>
+
+#include "test.h"
+#include "test_entry.h"
+
+#define TEST_FILE       "test_archive.arc"
+#define TEST_FRAMES     (2 * ARCHIVE_SEGMENT + 1000)
+
+/* the segments, from the trailer */
+static void test_index( const uint8_t *p, size_t i_size, uint8_t *seen )
+{
+    const uint8_t *trailer = p + i_size - ARCHIVE_TRAILER_SIZE;
+    int64_t i_segment = (int64_t)GetQWLE( trailer );
+    uint64_t i_entries = 0;
+    unsigned i_segments = 0;
+
+    TEST_CHECK( !memcmp( trailer + 16, "XRTPIDX", 8 ) );
+
+    while( i_segment >= 0 && (size_t)i_segment + ARCHIVE_RECORD_SIZE <= i_size )
+    {
+        const uint8_t *s = p + i_segment;
+        uint32_t i_bytes = GetDWLE( s + 4 );
+        int64_t  i_prev  = (int64_t)GetQWLE( s + 16 );
+        uint32_t i_last_ssrc = 0;
+        int64_t  i_last_arrival = INT64_MIN;
+        uint32_t i;
+
+        TEST_CHECK( s[15] == ARCHIVE_KIND_SEGMENT );
+        TEST_CHECK( i_bytes % ARCHIVE_ENTRY_SIZE == 0 );
+        TEST_CHECK( i_bytes <= ARCHIVE_SEGMENT * ARCHIVE_ENTRY_SIZE );
+        TEST_CHECK( i_prev < i_segment );
+
+        for( i = 0; i < i_bytes / ARCHIVE_ENTRY_SIZE; i++ )
+        {
+            const uint8_t *e = s + ARCHIVE_RECORD_SIZE + i * ARCHIVE_ENTRY_SIZE;
+            int64_t  i_offset  = (int64_t)GetQWLE( e );
+            int64_t  i_arrival = (int64_t)GetQWLE( e + 8 );
+            uint32_t ssrc      = GetDWLE( e + 16 );
+            uint32_t i_frame   = GetDWLE( e + 20 ) / 3000;
+            archive_entry_t ref;
+            uint8_t frame[64];
+            const uint8_t *r;
+
+            /* frames written since the previous segment, sorted */
+            if( i_offset <= i_prev || i_offset >= i_segment || i_frame >= TEST_FRAMES )
+            {
+                TEST_CHECK( !"entry out of its segment" );
+                return;
+            }
+            TEST_CHECK( ssrc > i_last_ssrc || (ssrc == i_last_ssrc && i_arrival >= i_last_arrival) );
+            i_last_ssrc    = ssrc;
+            i_last_arrival = i_arrival;
+
+            test_entry( i_frame, &ref, frame );
+            TEST_CHECK( ssrc == ref.ssrc && i_arrival == ref.i_arrival );
+            TEST_CHECK( GetDWLE( e + 24 ) == ref.i_size );
+            TEST_CHECK( e[28] == ref.i_pt && e[29] == ref.i_type && e[30] == ref.i_flags );
+
+            /* the record it points to, and the frame */
+            r = p + i_offset;
+            TEST_CHECK( GetDWLE( r ) == ref.ssrc && GetDWLE( r + 4 ) == ref.i_size );
+            TEST_CHECK( GetDWLE( r + 8 ) == ref.i_rtp_timestamp );
+            TEST_CHECK( r[12] == ref.i_pt && r[13] == ref.i_type && r[14] == ref.i_flags );
+            TEST_CHECK( r[15] == ARCHIVE_KIND_FRAME );
+            TEST_CHECK( (int64_t)GetQWLE( r + 16 ) == ref.i_arrival );
+            TEST_CHECK( !memcmp( r + ARCHIVE_RECORD_SIZE, frame, ref.i_size ) );
+
+            TEST_CHECK( !seen[i_frame] );
+            seen[i_frame] = 1;
+        }
+
+        i_entries += i_bytes / ARCHIVE_ENTRY_SIZE;
+        i_segments++;
+        i_segment = i_prev;
+    }
+
+    TEST_CHECK( i_segment == -1 );
+    TEST_CHECK( i_segments == 3 );
+    TEST_CHECK( i_entries == TEST_FRAMES );
+    TEST_CHECK( GetQWLE( trailer + 8 ) == TEST_FRAMES );
+}
+
+/* the records, from the header, as a file without trailer is read */
+static void test_records( const uint8_t *p, size_t i_size )
+{
+    size_t i_offset = ARCHIVE_HEADER_SIZE;
+    size_t i_end = i_size - ARCHIVE_TRAILER_SIZE;
+    unsigned i_frames = 0, i_segments = 0;
+
+    TEST_CHECK( !memcmp( p, "XRTPARC", 8 ) );
+    TEST_CHECK( GetDWLE( p + 8 ) == ARCHIVE_VERSION );
+
+    while( i_offset + ARCHIVE_RECORD_SIZE <= i_end )
+    {
+        const uint8_t *r = p + i_offset;
+
+        if( r[15] == ARCHIVE_KIND_FRAME )
+        {
+            /* in the order written */
+            TEST_CHECK( GetDWLE( r + 8 ) == 3000 * i_frames );
+            i_frames++;
+        }
+        else
+            i_segments++;
+        i_offset += ARCHIVE_RECORD_SIZE + GetDWLE( r + 4 );
+    }
+
+    TEST_CHECK( i_offset == i_end );
+    TEST_CHECK( i_frames == TEST_FRAMES && i_segments == 3 );
+}
+
+int main( void )
+{
+    archive_t *a;
+    uint8_t *p, *seen;
+    size_t i_size = 0;
+    unsigned i;
+
+    output_init( 0 );
+
+    a = archive_open( TEST_FILE, 0 );
+    TEST_CHECK( a != NULL );
+    if( a == NULL )
+        return TEST_RESULT();
+
+    for( i = 0; i < TEST_FRAMES; i++ )
+    {
+        archive_entry_t e;
+        uint8_t frame[64];
+
+        test_entry( i, &e, frame );
+        TEST_CHECK( archive_write( a, &e, frame ) == 0 );
+    }
+    archive_close( a );
+
+    p    = test_load( TEST_FILE, &i_size );
+    seen = (uint8_t *)calloc( TEST_FRAMES, 1 );
+    TEST_CHECK( p != NULL && i_size > ARCHIVE_HEADER_SIZE + ARCHIVE_TRAILER_SIZE );
+    if( p && seen && i_size > ARCHIVE_HEADER_SIZE + ARCHIVE_TRAILER_SIZE )
+    {
+        test_index( p, i_size, seen );
+        test_records( p, i_size );
+        TEST_CHECK( memchr( seen, 0, TEST_FRAMES ) == NULL );
+    }
+
+    free( seen );
+    free( p );
+    remove( TEST_FILE );
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,33 @@
+#ifndef _TEST_ENTRY_H_
+#define _TEST_ENTRY_H_
+
+#include <string.h>
+
+#include "archive.h"
+
+/*
+ * Index entries of the archive and .es.idx tests: three sources whose
+ * arrivals go back now and then, offsets increasing.
+ */
+
+/* entry i, and its i_size bytes of frame in p if not NULL */
+static inline void test_entry( unsigned i, archive_entry_t *e, uint8_t *p )
+{
+    unsigned k;
+
+    memset( e, 0, sizeof(*e) );
+    e->i_offset        = 1000 * (int64_t)i + (int64_t)(i % 7) * 3;
+    e->i_arrival       = 1000 * (mtime_t)i - (i % 5 == 4 ? 4500 : 0);
+    e->ssrc            = 0x1000 + i % 3;
+    e->i_rtp_timestamp = 3000 * i;
+    e->i_size          = i % 37;
+    e->i_pt            = (uint8_t)(96 + i % 3);
+    e->i_type          = (uint8_t)(i % 4);
+    e->i_flags         = (i % 30 == 0 ? ARCHIVE_FLAG_KEY : 0)
+                       | (i % 11 == 0 ? ARCHIVE_FLAG_DAMAGED : 0);
+
+    for( k = 0; p && k < e->i_size; k++ )
+        p[k] = (uint8_t)(i + k);
+}
+
+#endif //_TEST_ENTRY_H_
@@ -0,0 +1,173 @@
+/**
+ * @file test_h264.c
+ * @brief Bitstream reader and H.264 parser against golden NAL units
+ *
+ * The NAL units are hand assembled, their syntax elements are in the
+ * comments: a 1080p High profile stream, IDR, P and non reference B
+ * slices, and a POC LSB wrap.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "bitstream.h"
+#include "h264.h"
+
+/* profile 100, level 40, sps 0, chroma 1, log2_max_frame_num 4,
+ * poc type 0, log2_max_poc_lsb 6, 4 refs, 120x68 MBs, frame_mbs_only,
+ * cropped by 4 at the bottom */
+static const uint8_t sps[] = { 0x64, 0x00, 0x28, 0xac, 0xd9, 0x40, 0x78, 0x02, 0x27, 0xe5, 0x40 };
+/* the same with log2_max_frame_num_minus4 13 */
+static const uint8_t sps_bad[] = { 0x64, 0x00, 0x28, 0xac, 0x1d, 0x65, 0x01, 0xe0, 0x08, 0x9f, 0x95 };
+/* pps 0, sps 0, CABAC */
+static const uint8_t pps[] = { 0xee, 0x3c, 0x80 };
+/* slices of pps 0: type, frame_num, [idr_pic_id,] pic_order_cnt_lsb */
+static const uint8_t idr[]    = { 0x88, 0x84, 0x05, 0xa8 };     /* I 7, 0, 0, 0 */
+static const uint8_t p[]      = { 0x9a, 0x24, 0x2d, 0x40 };     /* P 5, 1, 8 */
+static const uint8_t b[]      = { 0x9e, 0x42, 0x2d, 0x40 };     /* B 6, 2, 4 */
+static const uint8_t p_40[]   = { 0x9a, 0x54, 0x2d, 0x40 };     /* P 5, 2, 40 */
+static const uint8_t p_wrap[] = { 0x9a, 0x64, 0x2d, 0x40 };     /* P 5, 3, 8 */
+
+/* profile 77, level 40, sps 0, log2_max_frame_num 4, poc type 1:
+ * offset_for_non_ref_pic -2, offset_for_top_to_bottom_field 2, one
+ * reference frame of 4 per cycle; 120x34 map units of fields, cropped
+ * to 1920x1080 */
+static const uint8_t sps_poc1[] = { 0x4d, 0x00, 0x28, 0xd0, 0xa4, 0x42, 0x10, 0x0f, 0x00, 0x88, 0xfb, 0x40 };
+/* pps 0, sps 0, bottom_field_pic_order_in_frame_present */
+static const uint8_t pps_poc1[] = { 0xde, 0x3c, 0x80 };
+/* type, frame_num, field, [bottom,] [idr_pic_id,] delta_pic_order_cnt[0], [[1]] */
+static const uint8_t idr_top[] = { 0x88, 0x85, 0xc0 };          /* I 7, 0, top, 0, 0 */
+static const uint8_t idr_bot[] = { 0x88, 0x87, 0xc0 };          /* I 7, 0, bottom, 0, 0 */
+static const uint8_t p_frame[] = { 0x9a, 0x29, 0xa0 };          /* P 5, 1, frame, 0, 3 */
+static const uint8_t p_bot[]   = { 0x9a, 0x5a, 0x80 };          /* P 5, 2, bottom, 1 */
+
+static void test_bitstream( void )
+{
+    static const uint8_t escaped[] = { 0x00, 0x00, 0x03, 0x01, 0xff };
+    static const uint8_t codes[] = { 0xa6, 0x40 };
+    static const uint8_t zeros[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0xff };
+    bsr_t s;
+
+    /* 00 00 03 01: the 03 is not part of the payload */
+    bsr_init( &s, escaped, sizeof(escaped) );
+    TEST_CHECK( bsr_read( &s, 24 ) == 0x000001 );
+    TEST_CHECK( bsr_read( &s, 8 ) == 0xff );
+    TEST_CHECK( !s.b_error );
+
+    /* 1 010 011 00100 */
+    bsr_init( &s, codes, sizeof(codes) );
+    TEST_CHECK( bsr_read_ue( &s ) == 0 );
+    TEST_CHECK( bsr_read_ue( &s ) == 1 );
+    TEST_CHECK( bsr_read_se( &s ) == -1 );
+    TEST_CHECK( bsr_read_ue( &s ) == 3 );
+    TEST_CHECK( !s.b_error );
+
+    /* more than 31 leading zeros: an error, and what was cached after
+     * them is not read as the next bits */
+    bsr_init( &s, zeros, sizeof(zeros) );
+    TEST_CHECK( bsr_read_ue( &s ) == 0 );
+    TEST_CHECK( s.b_error );
+    TEST_CHECK( bsr_read( &s, 32 ) == 0 );
+    TEST_CHECK( bsr_read( &s, 16 ) == 0 );
+}
+
+static void test_h264( void )
+{
+    h264_parser_t *h = h264_parser_create();
+    h264_slice_t sl;
+
+    TEST_CHECK( h264_parse_nal( h, 0x67, sps, sizeof(sps), &sl ) == H264_NAL_SPS );
+    TEST_CHECK( h->sps[0].b_valid );
+    TEST_CHECK( h->sps[0].i_profile == 100 && h->sps[0].i_level == 40 );
+    TEST_CHECK( h->sps[0].i_width == 1920 && h->sps[0].i_height == 1080 );
+    TEST_CHECK( h->sps[0].i_log2_max_frame_num == 4 );
+    TEST_CHECK( h->sps[0].i_poc_type == 0 && h->sps[0].i_log2_max_poc_lsb == 6 );
+    TEST_CHECK( h->sps[0].b_chroma_format && h->sps[0].i_chroma_format == 1 );
+    TEST_CHECK( h->sps[0].i_bit_depth_luma == 0 && h->sps[0].i_bit_depth_chroma == 0 );
+
+    /* the same SPS alone, as mp4.c reads it */
+    {
+        h264_sps_t alone;
+
+        TEST_CHECK( h264_parse_sps( sps, sizeof(sps), &alone ) == 0 );
+        TEST_CHECK( alone.b_valid && alone.i_profile == 100 && alone.i_chroma_format == 1 );
+        TEST_CHECK( alone.i_width == 1920 && alone.i_height == 1080 );
+        TEST_CHECK( h264_parse_sps( sps, 6, &alone ) == -1 );
+    }
+
+    /* a slice before its PPS is not tagged */
+    TEST_CHECK( h264_parse_nal( h, 0x65, idr, sizeof(idr), &sl ) == -1 );
+    TEST_CHECK( sl.i_nal_type == 0 );
+
+    TEST_CHECK( h264_parse_nal( h, 0x68, pps, sizeof(pps), &sl ) == H264_NAL_PPS );
+
+    TEST_CHECK( h264_parse_nal( h, 0x65, idr, sizeof(idr), &sl ) == H264_NAL_IDR );
+    TEST_CHECK( sl.b_idr && sl.i_slice_type == 2 && sl.i_nal_ref_idc == 3 );
+    TEST_CHECK( sl.i_frame_num == 0 && sl.i_poc == 0 );
+    TEST_CHECK( sl.i_width == 1920 && sl.i_height == 1080 );
+
+    TEST_CHECK( h264_parse_nal( h, 0x41, p, sizeof(p), &sl ) == H264_NAL_SLICE );
+    TEST_CHECK( !sl.b_idr && sl.i_slice_type == 0 && sl.i_nal_ref_idc == 2 );
+    TEST_CHECK( sl.i_frame_num == 1 && sl.i_poc == 8 );
+
+    TEST_CHECK( h264_parse_nal( h, 0x01, b, sizeof(b), &sl ) == H264_NAL_SLICE );
+    TEST_CHECK( sl.i_slice_type == 1 && sl.i_nal_ref_idc == 0 );
+    TEST_CHECK( sl.i_frame_num == 2 && sl.i_poc == 4 );
+
+    /* 40 then 8: the LSB wrapped, half of 64 apart */
+    TEST_CHECK( h264_parse_nal( h, 0x41, p_40, sizeof(p_40), &sl ) == H264_NAL_SLICE );
+    TEST_CHECK( sl.i_poc == 40 );
+    TEST_CHECK( h264_parse_nal( h, 0x41, p_wrap, sizeof(p_wrap), &sl ) == H264_NAL_SLICE );
+    TEST_CHECK( sl.i_poc == 72 );
+
+    /* truncated in the middle of the SPS */
+    TEST_CHECK( h264_parse_nal( h, 0x67, sps, 6, &sl ) == -1 );
+
+    h264_parser_destroy( h );
+
+    /* log2_max_frame_num above 16 */
+    h = h264_parser_create();
+    TEST_CHECK( h264_parse_nal( h, 0x67, sps_bad, sizeof(sps_bad), &sl ) == -1 );
+    TEST_CHECK( !h->sps[0].b_valid );
+    h264_parser_destroy( h );
+}
+
+/* POC type 1 fields: the bottom ones are offset from the top (8-10) */
+static void test_h264_poc1( void )
+{
+    h264_parser_t *h = h264_parser_create();
+    h264_slice_t sl;
+
+    TEST_CHECK( h264_parse_nal( h, 0x67, sps_poc1, sizeof(sps_poc1), &sl ) == H264_NAL_SPS );
+    TEST_CHECK( h->sps[0].i_poc_type == 1 && !h->sps[0].b_frame_mbs_only );
+    TEST_CHECK( h->sps[0].i_offset_for_non_ref_pic == -2 );
+    TEST_CHECK( h->sps[0].i_offset_for_top_to_bottom_field == 2 );
+    TEST_CHECK( h->sps[0].i_ref_frames_in_poc_cycle == 1 && h->sps[0].i_offset_for_ref_frame[0] == 4 );
+    TEST_CHECK( h->sps[0].i_width == 1920 && h->sps[0].i_height == 1080 );
+    TEST_CHECK( h264_parse_nal( h, 0x68, pps_poc1, sizeof(pps_poc1), &sl ) == H264_NAL_PPS );
+
+    TEST_CHECK( h264_parse_nal( h, 0x65, idr_top, sizeof(idr_top), &sl ) == H264_NAL_IDR );
+    TEST_CHECK( sl.b_field && !sl.b_bottom && sl.i_poc == 0 );
+
+    TEST_CHECK( h264_parse_nal( h, 0x65, idr_bot, sizeof(idr_bot), &sl ) == H264_NAL_IDR );
+    TEST_CHECK( sl.b_field && sl.b_bottom && sl.i_poc == 2 );
+
+    /* a frame: the smaller of 4 and 4 + 2 + 3 */
+    TEST_CHECK( h264_parse_nal( h, 0x41, p_frame, sizeof(p_frame), &sl ) == H264_NAL_SLICE );
+    TEST_CHECK( !sl.b_field && sl.i_frame_num == 1 && sl.i_poc == 4 );
+
+    /* expected 8, + 2 + 1 */
+    TEST_CHECK( h264_parse_nal( h, 0x41, p_bot, sizeof(p_bot), &sl ) == H264_NAL_SLICE );
+    TEST_CHECK( sl.b_field && sl.b_bottom && sl.i_frame_num == 2 && sl.i_poc == 11 );
+
+    h264_parser_destroy( h );
+}
+
+int main( void )
+{
+    test_bitstream();
+    test_h264();
+    test_h264_poc1();
+
+    return TEST_RESULT();
+}
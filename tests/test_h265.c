@@ -0,0 +1,128 @@
+/**
+ * @file test_h265.c
+ * @brief H.265 parser against golden NAL units
+ *
+ * The NAL units are hand assembled, their syntax elements are in the
+ * comments: a 1080p Main stream with 3 temporal sub-layers, so that
+ * the parameter sets carry emulation prevention bytes.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "h265.h"
+
+static const uint8_t vps[] = {                      /* vps 0, 3 sub-layers */
+    0x0c, 0x05, 0xff, 0xff, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00,
+    0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x78, 0x00, 0x00, 0x15, 0xc0, 0x90 };
+/* sps 0, 3 sub-layers, chroma 1, 1920x1088 cropped by 4 at the bottom,
+ * log2_max_poc_lsb 8, CTB 64: 30x17 CTBs, 9 bits addresses */
+static const uint8_t sps[] = {
+    0x05, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00,
+    0x00, 0x03, 0x00, 0x78, 0x00, 0x00, 0xa0, 0x03, 0xc0, 0x80, 0x11, 0x07,
+    0xcb, 0x94, 0x57, 0x92 };
+/* the same with log2_max_pic_order_cnt_lsb_minus4 13 */
+static const uint8_t sps_bad[] = {
+    0x05, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00,
+    0x00, 0x03, 0x00, 0x78, 0x00, 0x00, 0xa0, 0x03, 0xc0, 0x80, 0x11, 0x07,
+    0xcb, 0x8e, 0x15, 0xe4, 0x80 };
+/* sps 0, 1 sub-layer, chroma 1, 1920x1152 cropped by 72 at the bottom,
+ * CTB 64: 30x18 CTBs uncropped, 10 bits addresses (17 rows if cropped) */
+static const uint8_t sps_crop[] = {
+    0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00,
+    0x00, 0x03, 0x00, 0x78, 0xa0, 0x03, 0xc0, 0x80, 0x12, 0x07, 0xc1, 0x2e,
+    0x59, 0x5e, 0x49, 0x36, 0xb2 };
+/* pps 0, sps 0, dependent slice segments */
+static const uint8_t pps[] = { 0xe0, 0x40 };
+/* slice segments of pps 0: first, [dependent, address,] type, [POC LSB] */
+static const uint8_t idr[]     = { 0xad, 0x6a };        /* 1, I */
+static const uint8_t dep[]     = { 0x37, 0xfa, 0xd4 };  /* 0, 1, 255 */
+static const uint8_t trail_r[] = { 0xd0, 0x42, 0xd4 };  /* 1, P, 8 */
+static const uint8_t trail_2[] = { 0xe0, 0x8b, 0x50 };  /* 1, B, 4 */
+static const uint8_t trail_1[] = { 0xe0, 0xcb, 0x50 };  /* 1, B, 6 */
+static const uint8_t cra[]     = { 0xac, 0x41, 0x6a };  /* 1, I, 16 */
+
+/* nal_unit_type, TemporalId + 1 */
+static const uint8_t nal_vps[2]  = { 32 << 1, 1 };
+static const uint8_t nal_sps[2]  = { 33 << 1, 1 };
+static const uint8_t nal_pps[2]  = { 34 << 1, 1 };
+static const uint8_t nal_idr[2]  = { 19 << 1, 1 };
+static const uint8_t nal_trail_r[2] = { 1 << 1, 1 };
+static const uint8_t nal_trail_n2[2] = { 0, 3 };
+static const uint8_t nal_trail_n1[2] = { 0, 2 };
+static const uint8_t nal_cra[2]  = { 21 << 1, 1 };
+
+int main( void )
+{
+    h265_parser_t *h = h265_parser_create();
+    h265_slice_t sl;
+
+    TEST_CHECK( h265_parse_nal( h, nal_vps, vps, sizeof(vps), &sl ) == H265_NAL_VPS );
+    TEST_CHECK( h->vps[0].b_valid && h->vps[0].i_max_sub_layers == 3 );
+
+    TEST_CHECK( h265_parse_nal( h, nal_sps, sps, sizeof(sps), &sl ) == H265_NAL_SPS );
+    TEST_CHECK( h->sps[0].b_valid && h->sps[0].i_max_sub_layers == 3 );
+    TEST_CHECK( h->sps[0].i_width == 1920 && h->sps[0].i_height == 1080 );
+    TEST_CHECK( h->sps[0].i_log2_max_poc_lsb == 8 );
+    TEST_CHECK( h->sps[0].i_ctb_address_bits == 9 );
+    TEST_CHECK( h->sps[0].b_temporal_id_nesting );
+    TEST_CHECK( (h->sps[0].general_ptl[0] & 0x1F) == 1 && h->sps[0].general_ptl[11] == 120 );
+    TEST_CHECK( h->sps[0].i_chroma_format == 1 );
+    TEST_CHECK( h->sps[0].i_bit_depth_luma == 0 && h->sps[0].i_bit_depth_chroma == 0 );
+
+    /* the same SPS alone, as mp4.c reads it */
+    {
+        h265_sps_t alone;
+
+        TEST_CHECK( h265_parse_sps( sps, sizeof(sps), &alone ) == 0 );
+        TEST_CHECK( alone.b_valid && alone.i_max_sub_layers == 3 );
+        TEST_CHECK( !memcmp( alone.general_ptl, h->sps[0].general_ptl, sizeof(alone.general_ptl) ) );
+        TEST_CHECK( alone.i_width == 1920 && alone.i_height == 1080 );
+    }
+
+    TEST_CHECK( h265_parse_nal( h, nal_pps, pps, sizeof(pps), &sl ) == H265_NAL_PPS );
+    TEST_CHECK( h->pps[0].b_valid && h->pps[0].b_dependent_slice_segments );
+
+    TEST_CHECK( h265_parse_nal( h, nal_idr, idr, sizeof(idr), &sl ) == H265_NAL_IDR_W_RADL );
+    TEST_CHECK( sl.b_first && !sl.b_dependent && sl.i_slice_type == 2 );
+    TEST_CHECK( sl.i_temporal_id == 0 && sl.b_reference && sl.i_poc == 0 );
+    TEST_CHECK( sl.i_width == 1920 && sl.i_height == 1080 );
+
+    /* a dependent segment has the type of the independent one */
+    TEST_CHECK( h265_parse_nal( h, nal_idr, dep, sizeof(dep), &sl ) == H265_NAL_IDR_W_RADL );
+    TEST_CHECK( !sl.b_first && sl.b_dependent && sl.i_slice_type == 2 );
+
+    TEST_CHECK( h265_parse_nal( h, nal_trail_r, trail_r, sizeof(trail_r), &sl ) == 1 );
+    TEST_CHECK( sl.i_slice_type == 1 && sl.b_reference && sl.i_poc == 8 );
+
+    /* TRAIL_N of the top sub-layer: nobody references it */
+    TEST_CHECK( h265_parse_nal( h, nal_trail_n2, trail_2, sizeof(trail_2), &sl ) == 0 );
+    TEST_CHECK( sl.i_temporal_id == 2 && !sl.b_reference );
+    TEST_CHECK( sl.i_slice_type == 0 && sl.i_poc == 4 );
+
+    /* TRAIL_N of a lower sub-layer: the upper ones may */
+    TEST_CHECK( h265_parse_nal( h, nal_trail_n1, trail_1, sizeof(trail_1), &sl ) == 0 );
+    TEST_CHECK( sl.i_temporal_id == 1 && sl.b_reference && sl.i_poc == 6 );
+
+    /* a CRA in the middle of the stream keeps the POC MSB */
+    TEST_CHECK( h265_parse_nal( h, nal_cra, cra, sizeof(cra), &sl ) == H265_NAL_CRA );
+    TEST_CHECK( H265_IS_IRAP( sl.i_nal_type ) && sl.i_poc == 16 );
+
+    h265_parser_destroy( h );
+
+    /* the slice addresses cover the CTBs under the conformance window */
+    h = h265_parser_create();
+    TEST_CHECK( h265_parse_nal( h, nal_sps, sps_crop, sizeof(sps_crop), &sl ) == H265_NAL_SPS );
+    TEST_CHECK( h->sps[0].b_valid && h->sps[0].i_max_sub_layers == 1 );
+    TEST_CHECK( h->sps[0].i_width == 1920 && h->sps[0].i_height == 1080 );
+    TEST_CHECK( h->sps[0].i_ctb_address_bits == 10 );
+    h265_parser_destroy( h );
+
+    /* log2_max_pic_order_cnt_lsb above 16 */
+    h = h265_parser_create();
+    TEST_CHECK( h265_parse_nal( h, nal_sps, sps_bad, sizeof(sps_bad), &sl ) == -1 );
+    TEST_CHECK( !h->sps[0].b_valid );
+    h265_parser_destroy( h );
+
+    return TEST_RESULT();
+}
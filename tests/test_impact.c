@@ -0,0 +1,133 @@
+/**
+ * @file test_impact.c
+ * @brief Frame assembly of lossy packets and loss impact
+ *
+ * The packets of a P frame up to its marker are lost, the next packet
+ * after the gap starting an intact IDR: the loss is the P frame's, which
+ * opens a corruption the IDR closes. A gap between two complete frames
+ * is charged to the frame that follows it.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "frame.h"
+#include "impact.h"
+
+#define TEST_TICK       3000
+
+static frame_t  frames[8];
+static int      i_frames;
+
+static void test_output( void *opaque, const frame_t *f )
+{
+    (void)opaque;
+
+    if( i_frames < 8 )
+        frames[i_frames] = *f;
+    i_frames++;
+
+    impact_frame( (impact_t *)opaque, f );
+}
+
+/* one packet of a frame, 2 per frame, the second with the marker */
+static void test_packet( frame_asm_t *fa, int k, int i_part, int b_gap, int b_key )
+{
+    static uint8_t p_payload[100];
+    block_t block;
+
+    memset( &block, 0, sizeof(block) );
+    block.i_rtp_timestamp = (uint32_t)(k * TEST_TICK);
+    block.i_pts           = k * 33333 + i_part * 1000;
+    block.i_buffer        = sizeof(p_payload);
+    block.p_buffer        = p_payload;
+    block.i_temporal_id   = -1;
+    block.i_reference     = 1;
+    block.i_key           = b_key ? FRAME_KEY_IDR : 0;
+    block.i_flags         = b_key ? BLOCK_FLAG_TYPE_I : BLOCK_FLAG_TYPE_P;
+    if( b_gap )
+        block.i_flags |= BLOCK_FLAG_DISCONTINUITY;
+    if( i_part == 1 )
+        block.i_flags |= BLOCK_FLAG_END_OF_FRAME;
+
+    TEST_CHECK( frame_asm_packet( fa, &block ) == 0 );
+    TEST_CHECK( frame_asm_write( fa, block.p_buffer, block.i_buffer ) == 0 );
+    frame_asm_packet_end( fa, &block );
+}
+
+/* IDR, P without its tail, IDR */
+static void test_lost_marker( void )
+{
+    impact_t    *im = impact_create( 90000 );
+    frame_asm_t *fa = frame_asm_create( test_output, im );
+
+    i_frames = 0;
+
+    test_packet( fa, 0, 0, 0, 1 );
+    test_packet( fa, 0, 1, 0, 1 );
+    test_packet( fa, 1, 0, 0, 0 );
+    /* P part 1 and its marker lost */
+    test_packet( fa, 2, 0, 1, 1 );
+    test_packet( fa, 2, 1, 0, 1 );
+    frame_asm_destroy( fa );
+
+    TEST_CHECK( i_frames == 3 );
+    TEST_CHECK( frames[0].i_flags == 0 );
+    TEST_CHECK( frames[1].i_flags == (FRAME_FLAG_LOSS | FRAME_FLAG_NO_MARKER) );
+    TEST_CHECK( frames[1].i_gaps == 1 );
+    TEST_CHECK( frames[2].i_flags == 0 );
+    TEST_CHECK( frames[2].i_gaps == 0 );
+
+    TEST_CHECK( im->i_hit == 1 );
+    TEST_CHECK( im->i_hit_key == 0 );
+    TEST_CHECK( im->i_hit_reference == 1 );
+    TEST_CHECK( im->i_gaps == 1 );
+    TEST_CHECK( im->i_corruptions == 1 );
+    TEST_CHECK( im->i_corrupted == 1 );
+    TEST_CHECK( im->i_propagated == 0 );
+    TEST_CHECK( !im->b_corrupted );
+    TEST_CHECK( im->recovery.i_total == 1 );
+
+    impact_destroy( im );
+}
+
+/* IDR, P with its marker, a gap, P: the second P is hit */
+static void test_lost_head( void )
+{
+    impact_t    *im = impact_create( 90000 );
+    frame_asm_t *fa = frame_asm_create( test_output, im );
+
+    i_frames = 0;
+
+    test_packet( fa, 0, 0, 0, 1 );
+    test_packet( fa, 0, 1, 0, 1 );
+    test_packet( fa, 1, 0, 0, 0 );
+    test_packet( fa, 1, 1, 0, 0 );
+    /* part 0 of frame 2 lost */
+    test_packet( fa, 2, 1, 1, 0 );
+    test_packet( fa, 3, 0, 0, 0 );
+    test_packet( fa, 3, 1, 0, 0 );
+    frame_asm_destroy( fa );
+
+    TEST_CHECK( i_frames == 4 );
+    TEST_CHECK( frames[1].i_flags == 0 );
+    TEST_CHECK( frames[2].i_flags == FRAME_FLAG_LOSS );
+    TEST_CHECK( frames[3].i_flags == 0 );
+
+    TEST_CHECK( im->i_hit == 1 );
+    TEST_CHECK( im->i_hit_reference == 1 );
+    TEST_CHECK( im->i_corrupted == 2 );
+    TEST_CHECK( im->i_propagated == 1 );
+    TEST_CHECK( im->b_corrupted );
+
+    impact_destroy( im );
+}
+
+int main( void )
+{
+    test_lost_marker();
+    test_lost_head();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,78 @@
+/**
+ * @file test_index.c
+ * @brief .es.idx records through a small output, read back
+ *
+ * The sidecar is archive_entry_pack() records written to an output
+ * opened with OUTPUT_SMALL, here behind a writer thread as with -o
+ * async: the buffer must stay small, the records come back as laid
+ * out in archive.h, their offsets increasing.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_bytes.h>
+
+#include "test.h"
+#include "test_entry.h"
+#include "writer.h"
+
+#define TEST_FILE       "test_index.es.idx"
+#define TEST_RECORDS    20000   /* 640 KB, 20 times the small buffer */
+
+int main( void )
+{
+    writer_t *w;
+    output_t *o;
+    FILE *f;
+    uint8_t record[ARCHIVE_ENTRY_SIZE];
+    int64_t i_last = -1;
+    unsigned i;
+
+    output_init( 0 );
+
+    w = writer_create( WRITER_THREAD );
+    o = output_open( TEST_FILE, OUTPUT_SMALL, w );
+    TEST_CHECK( w != NULL && o != NULL );
+    if( w == NULL || o == NULL )
+        return TEST_RESULT();
+
+    for( i = 0; i < TEST_RECORDS; i++ )
+    {
+        archive_entry_t e;
+
+        test_entry( i, &e, NULL );
+        archive_entry_pack( record, &e );
+        TEST_CHECK( output_write( o, record, sizeof(record) ) == 0 );
+    }
+    TEST_CHECK( o->i_size == OUTPUT_BUFFER_MINIMUM );
+    TEST_CHECK( output_tell( o ) == (int64_t)TEST_RECORDS * ARCHIVE_ENTRY_SIZE );
+
+    output_close( o );
+    writer_destroy( w );
+
+    f = fopen( TEST_FILE, "rb" );
+    TEST_CHECK( f != NULL );
+    for( i = 0; f && fread( record, 1, sizeof(record), f ) == sizeof(record); i++ )
+    {
+        archive_entry_t ref;
+        int64_t i_offset = (int64_t)GetQWLE( record );
+
+        test_entry( i, &ref, NULL );
+        TEST_CHECK( i_offset == ref.i_offset && i_offset > i_last );
+        TEST_CHECK( (int64_t)GetQWLE( record + 8 ) == ref.i_arrival );
+        TEST_CHECK( GetDWLE( record + 16 ) == ref.ssrc );
+        TEST_CHECK( GetDWLE( record + 20 ) == ref.i_rtp_timestamp );
+        TEST_CHECK( GetDWLE( record + 24 ) == ref.i_size );
+        TEST_CHECK( record[28] == ref.i_pt && record[29] == ref.i_type );
+        TEST_CHECK( record[30] == ref.i_flags && record[31] == 0 );
+        i_last = i_offset;
+    }
+    TEST_CHECK( i == TEST_RECORDS );
+
+    if( f )
+        fclose( f );
+    remove( TEST_FILE );
+
+    return TEST_RESULT();
+}
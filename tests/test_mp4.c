@@ -0,0 +1,328 @@
+/**
+ * @file test_mp4.c
+ * @brief fMP4 written by mp4_frame(), walked box by box
+ *
+ * An H.264 stream with B frames, in decode order, its RTP timestamps
+ * wrapping, after a frame that comes before any keyframe: the file
+ * must be ftyp, moov with an avc3/avcC of the stream parameter sets,
+ * then moof/mdat pairs whose samples are the NAL units given, at their
+ * presentation times, no fragment splitting a frame from the B frames
+ * that reference it. Then the hev1/hvcC of an H.265 stream.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_bytes.h>
+
+#include "test.h"
+#include "mp4.h"
+
+#define TEST_FILE       "test_mp4.mp4"
+#define TEST_FRAGMENT   4
+#define TEST_BASE       0xFFFFF000u     /* RTP timestamp of the IDR */
+#define TEST_TICK       3000
+
+/* golden parameter sets of test_h264.c and test_h265.c */
+static const uint8_t sps264[] = { 0x67, 0x64, 0x00, 0x28, 0xac, 0xd9, 0x40, 0x78, 0x02, 0x27, 0xe5, 0x40 };
+static const uint8_t pps264[] = { 0x68, 0xee, 0x3c, 0x80 };
+static const uint8_t vps265[] = {
+    0x40, 0x01,
+    0x0c, 0x05, 0xff, 0xff, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00,
+    0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x78, 0x00, 0x00, 0x15, 0xc0, 0x90 };
+static const uint8_t sps265[] = {
+    0x42, 0x01,
+    0x05, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00,
+    0x00, 0x03, 0x00, 0x78, 0x00, 0x00, 0xa0, 0x03, 0xc0, 0x80, 0x11, 0x07,
+    0xcb, 0x94, 0x57, 0x92 };
+static const uint8_t pps265[] = { 0x44, 0x01, 0xe0, 0x40 };
+static const uint8_t aud264[] = { 0x09, 0xf0 };
+static const uint8_t p264[]   = { 0x41, 0x9a, 0x24 };
+
+/* decode order: I P B B P B B ..., presentation times in ticks */
+static const int pts[] = { 0, 3, 1, 2, 6, 4, 5, 9, 7, 8, 12, 10, 11 };
+#define TEST_FRAMES     (int)(sizeof(pts) / sizeof(pts[0]))
+
+/* start code and NAL unit */
+static size_t put_nal( uint8_t *p, const uint8_t *nal, size_t i_nal, int b_long )
+{
+    size_t i = 0;
+
+    if( b_long )
+        p[i++] = 0;
+    p[i++] = 0; p[i++] = 0; p[i++] = 1;
+    memcpy( p + i, nal, i_nal );
+
+    return i + i_nal;
+}
+
+/* the slice NAL unit of frame k, no zero byte in it */
+static size_t slice( uint8_t *nal, int k )
+{
+    size_t i_size = 20 + 7 * k, i;
+
+    nal[0] = k == 0 ? 0x65 : pts[k] % 3 == 0 ? 0x41 : 0x01;
+    for( i = 1; i < i_size; i++ )
+        nal[i] = (uint8_t)(0x10 + (k * 31 + i) % 0xE0);
+
+    return i_size;
+}
+
+/* first box of the type in [i_start, i_end), 0 if none */
+static size_t box_find( const uint8_t *p, size_t i_start, size_t i_end, const char *psz_type )
+{
+    while( i_start + 8 <= i_end )
+    {
+        size_t i_size = GetDWBE( p + i_start );
+
+        if( i_size < 8 || i_start + i_size > i_end )
+            return 0;
+        if( !memcmp( p + i_start + 4, psz_type, 4 ) )
+            return i_start;
+        i_start += i_size;
+    }
+    return 0;
+}
+
+#define BOX_END( p, o ) ((o) + GetDWBE( (p) + (o) ))
+
+/* the sample entry in the stsd of the moov, 0 if none */
+static size_t sample_entry( const uint8_t *p, size_t i_size, const char *psz_entry )
+{
+    size_t moov = box_find( p, 0, i_size, "moov" ), o;
+
+    if( !moov || !(o = box_find( p, moov + 8, BOX_END( p, moov ), "trak" ))
+     || !(o = box_find( p, o + 8, BOX_END( p, o ), "mdia" ))
+     || !(o = box_find( p, o + 8, BOX_END( p, o ), "minf" ))
+     || !(o = box_find( p, o + 8, BOX_END( p, o ), "stbl" ))
+     || !(o = box_find( p, o + 8, BOX_END( p, o ), "stsd" )) )
+        return 0;
+
+    return box_find( p, o + 16, BOX_END( p, o ), psz_entry );
+}
+
+static void test_h264( void )
+{
+    mp4_t *m = mp4_open( TEST_FILE, MP4_CODEC_H264, 90000, TEST_FRAGMENT, 0, NULL );
+    uint8_t buffer[512], nal[128];
+    uint8_t *p;
+    size_t i_size = 0, o, avcc, moof;
+    int64_t i_dts_next = 0, i_max_pts = -1;
+    unsigned i_sequence = 0;
+    int i_sample = 0, k;
+    frame_t f;
+
+    TEST_CHECK( m != NULL );
+    if( m == NULL )
+        return;
+
+    memset( &f, 0, sizeof(f) );
+    f.p_buffer = buffer;
+    f.i_width  = 1920;
+    f.i_height = 1080;
+
+    /* a P frame before any keyframe: dropped */
+    f.i_buffer        = put_nal( buffer, p264, sizeof(p264), 0 );
+    f.i_rtp_timestamp = TEST_BASE - TEST_TICK;
+    f.i_block_flags   = BLOCK_FLAG_TYPE_P;
+    TEST_CHECK( mp4_frame( m, &f ) == 0 );
+
+    for( k = 0; k < TEST_FRAMES; k++ )
+    {
+        f.i_buffer = 0;
+        if( k == 0 )
+        {
+            /* AUD, SPS, PPS behind 4 bytes start codes */
+            f.i_buffer += put_nal( buffer, aud264, sizeof(aud264), 1 );
+            f.i_buffer += put_nal( buffer + f.i_buffer, sps264, sizeof(sps264), 1 );
+            f.i_buffer += put_nal( buffer + f.i_buffer, pps264, sizeof(pps264), 1 );
+        }
+        f.i_buffer += put_nal( buffer + f.i_buffer, nal, slice( nal, k ), k == 0 );
+        buffer[f.i_buffer++] = 0;                   /* trailing_zero_8bits */
+
+        f.i_rtp_timestamp = TEST_BASE + (uint32_t)(pts[k] * TEST_TICK);
+        f.i_block_flags   = k == 0 ? BLOCK_FLAG_TYPE_I
+                          : pts[k] % 3 == 0 ? BLOCK_FLAG_TYPE_P : BLOCK_FLAG_TYPE_B;
+        TEST_CHECK( mp4_frame( m, &f ) == 0 );
+    }
+    TEST_CHECK( m->i_dropped == 1 );
+    mp4_close( m );
+
+    p = test_load( TEST_FILE, &i_size );
+    TEST_CHECK( p != NULL );
+    if( p == NULL )
+        return;
+
+    /* init segment */
+    TEST_CHECK( box_find( p, 0, i_size, "ftyp" ) == 0 && !memcmp( p + 4, "ftyp", 4 ) );
+    TEST_CHECK( box_find( p, 0, i_size, "moov" ) == GetDWBE( p ) );
+    o = sample_entry( p, i_size, "avc3" );
+    TEST_CHECK( o != 0 );
+    if( o == 0 )
+        goto end;
+    TEST_CHECK( GetDWBE( p + o + 32 ) == (1920u << 16 | 1080) );
+    avcc = box_find( p, o + 86, BOX_END( p, o ), "avcC" );
+    TEST_CHECK( avcc != 0 );
+    if( avcc )
+    {
+        const uint8_t *c = p + avcc + 8;
+
+        TEST_CHECK( c[0] == 1 && c[1] == 100 && c[3] == 40 && c[4] == 0xFF );
+        TEST_CHECK( c[5] == 0xE1 && (size_t)(c[6] << 8 | c[7]) == sizeof(sps264) );
+        TEST_CHECK( !memcmp( c + 8, sps264, sizeof(sps264) ) );
+        c += 8 + sizeof(sps264);
+        TEST_CHECK( c[0] == 1 && (size_t)(c[1] << 8 | c[2]) == sizeof(pps264) );
+        TEST_CHECK( !memcmp( c + 3, pps264, sizeof(pps264) ) );
+        /* high profile: 4:2:0, 8 bits */
+        c += 3 + sizeof(pps264);
+        TEST_CHECK( c[0] == 0xFD && c[1] == 0xF8 && c[2] == 0xF8 && c[3] == 0 );
+        TEST_CHECK( c + 4 == p + BOX_END( p, avcc ) );
+    }
+
+    /* fragments */
+    for( moof = box_find( p, 0, i_size, "moof" ); moof; )
+    {
+        size_t mdat = BOX_END( p, moof ), traf, tfdt, trun, data;
+        int64_t i_dts, i_min_pts = INT64_MAX, i_frag_max = -1;
+        uint32_t i, i_count;
+
+        TEST_CHECK( mdat + 8 <= i_size && !memcmp( p + mdat + 4, "mdat", 4 ) );
+        TEST_CHECK( GetDWBE( p + box_find( p, moof + 8, mdat, "mfhd" ) + 12 ) == ++i_sequence );
+        traf = box_find( p, moof + 8, mdat, "traf" );
+        tfdt = box_find( p, traf + 8, BOX_END( p, traf ), "tfdt" );
+        trun = box_find( p, traf + 8, BOX_END( p, traf ), "trun" );
+        TEST_CHECK( traf && tfdt && trun );
+        if( !traf || !tfdt || !trun )
+            break;
+
+        TEST_CHECK( GetDWBE( p + box_find( p, traf + 8, BOX_END( p, traf ), "tfhd" ) + 8 ) == 0x020000 );
+        TEST_CHECK( p[tfdt + 8] == 1 );
+        i_dts = (int64_t)((uint64_t)GetDWBE( p + tfdt + 12 ) << 32 | GetDWBE( p + tfdt + 16 ));
+        TEST_CHECK( i_dts == i_dts_next );
+
+        TEST_CHECK( GetDWBE( p + trun + 8 ) == 0x01000F01 );
+        i_count = GetDWBE( p + trun + 12 );
+        data    = moof + GetDWBE( p + trun + 16 );
+        TEST_CHECK( data == mdat + 8 );
+        TEST_CHECK( i_count >= TEST_FRAGMENT || BOX_END( p, mdat ) == i_size );
+
+        for( i = 0; i < i_count && i_sample < TEST_FRAMES; i++, i_sample++ )
+        {
+            const uint8_t *s = p + trun + 20 + 16 * i;
+            uint32_t i_sample_size = GetDWBE( s + 4 );
+            int64_t i_pts = i_dts + (int32_t)GetDWBE( s + 12 );
+            size_t i_nal, i_ref = slice( nal, i_sample );
+            const uint8_t *n = p + data;
+
+            TEST_CHECK( i_pts == (int64_t)pts[i_sample] * TEST_TICK );
+            TEST_CHECK( GetDWBE( s + 8 ) == (i_sample == 0 ? 0x02000000u : 0x01010000u) );
+
+            /* 4 bytes lengths, the parameter sets kept, not the AUD */
+            if( i_sample == 0 )
+            {
+                TEST_CHECK( GetDWBE( n ) == sizeof(sps264) && !memcmp( n + 4, sps264, sizeof(sps264) ) );
+                n += 4 + sizeof(sps264);
+                TEST_CHECK( GetDWBE( n ) == sizeof(pps264) && !memcmp( n + 4, pps264, sizeof(pps264) ) );
+                n += 4 + sizeof(pps264);
+            }
+            i_nal = GetDWBE( n );
+            TEST_CHECK( i_nal == i_ref && !memcmp( n + 4, nal, i_ref ) );
+            TEST_CHECK( (size_t)(n + 4 + i_nal - (p + data)) == i_sample_size );
+
+            data  += i_sample_size;
+            i_dts += GetDWBE( s );
+            if( i_pts < i_min_pts )
+                i_min_pts = i_pts;
+            if( i_pts > i_frag_max )
+                i_frag_max = i_pts;
+        }
+        TEST_CHECK( data == BOX_END( p, mdat ) );
+
+        /* B frames stay with their reference */
+        TEST_CHECK( i_min_pts > i_max_pts );
+        i_max_pts  = i_frag_max;
+        i_dts_next = i_dts;
+
+        moof = BOX_END( p, mdat ) < i_size ? BOX_END( p, mdat ) : 0;
+        TEST_CHECK( !moof || !memcmp( p + moof + 4, "moof", 4 ) );
+    }
+    TEST_CHECK( i_sample == TEST_FRAMES );
+    TEST_CHECK( i_sequence == 3 );
+
+end:
+    free( p );
+    remove( TEST_FILE );
+}
+
+static void test_h265( void )
+{
+    mp4_t *m = mp4_open( TEST_FILE, MP4_CODEC_H265, 90000, TEST_FRAGMENT, 0, NULL );
+    static const uint8_t idr[] = { 0x26, 0x01, 0xad, 0x6a, 0x55, 0x55 };
+    uint8_t buffer[256];
+    uint8_t *p;
+    size_t i_size = 0, o, hvcc;
+    frame_t f;
+
+    TEST_CHECK( m != NULL );
+    if( m == NULL )
+        return;
+
+    memset( &f, 0, sizeof(f) );
+    f.p_buffer        = buffer;
+    f.i_width         = 1920;
+    f.i_height        = 1080;
+    f.i_rtp_timestamp = TEST_BASE;
+    f.i_block_flags   = BLOCK_FLAG_TYPE_I;
+    f.i_buffer  = put_nal( buffer, vps265, sizeof(vps265), 1 );
+    f.i_buffer += put_nal( buffer + f.i_buffer, sps265, sizeof(sps265), 1 );
+    f.i_buffer += put_nal( buffer + f.i_buffer, pps265, sizeof(pps265), 1 );
+    f.i_buffer += put_nal( buffer + f.i_buffer, idr, sizeof(idr), 1 );
+    TEST_CHECK( mp4_frame( m, &f ) == 0 );
+    mp4_close( m );
+
+    p = test_load( TEST_FILE, &i_size );
+    TEST_CHECK( p != NULL );
+    if( p == NULL )
+        return;
+
+    o = sample_entry( p, i_size, "hev1" );
+    TEST_CHECK( o != 0 );
+    hvcc = o ? box_find( p, o + 86, BOX_END( p, o ), "hvcC" ) : 0;
+    TEST_CHECK( hvcc != 0 );
+    if( hvcc )
+    {
+        const uint8_t *c = p + hvcc + 8;
+        static const uint8_t *params[3] = { vps265, sps265, pps265 };
+        static const size_t i_params[3] = { sizeof(vps265), sizeof(sps265), sizeof(pps265) };
+        int i;
+
+        /* general_profile_idc 1, level 120, 3 sub-layers, nested */
+        TEST_CHECK( c[0] == 1 && (c[1] & 0x1F) == 1 && c[12] == 120 );
+        /* 4:2:0, 8 bits */
+        TEST_CHECK( c[16] == 0xFD && c[17] == 0xF8 && c[18] == 0xF8 );
+        TEST_CHECK( c[21] == ((3 << 3) | (1 << 2) | 3) );
+        TEST_CHECK( c[22] == 3 );
+        c += 23;
+        for( i = 0; i < 3; i++ )
+        {
+            TEST_CHECK( (c[0] & 0x3F) == 32 + i && (c[1] << 8 | c[2]) == 1 );
+            TEST_CHECK( (size_t)(c[3] << 8 | c[4]) == i_params[i] );
+            TEST_CHECK( !memcmp( c + 5, params[i], i_params[i] ) );
+            c += 5 + i_params[i];
+        }
+    }
+    TEST_CHECK( box_find( p, 0, i_size, "moof" ) != 0 );
+
+    free( p );
+    remove( TEST_FILE );
+}
+
+int main( void )
+{
+    output_init( 0 );
+
+    test_h264();
+    test_h265();
+
+    return TEST_RESULT();
+}
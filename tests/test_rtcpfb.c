@@ -0,0 +1,83 @@
+/**
+ * @file test_rtcpfb.c
+ * @brief Keyframe request storms
+ *
+ * RTCP_FB_STORM PLIs within one second make a storm, one less or
+ * spread over more than one second does not.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xrtp_bytes.h>
+
+#include "test.h"
+#include "rtcp.h"
+#include "rtcpfb.h"
+#include "session.h"
+
+#define TEST_SSRC       0x12345678
+
+static rtp_source_t src;
+
+/* the only source of the test session */
+rtp_source_t *rtp_source_find( const rtp_session_t *session, uint32_t ssrc )
+{
+    (void)session;
+
+    return ssrc == TEST_SSRC ? &src : NULL;
+}
+
+static void test_pli( mtime_t now )
+{
+    uint8_t p[12];
+
+    p[0] = 0x80 | 1;            /* PLI */
+    p[1] = RTCP_PSFB;
+    SetWBE( p + 2, 2 );
+    SetDWBE( p + 4, 0x1 );
+    SetDWBE( p + 8, TEST_SSRC );
+
+    TEST_CHECK( rtcp_fb_packet( NULL, p, sizeof(p), now ) == 0 );
+}
+
+/* i_count PLIs i_interval apart from now on */
+static mtime_t test_plis( mtime_t now, int i_count, mtime_t i_interval )
+{
+    for( int i = 0; i < i_count; i++, now += i_interval )
+        test_pli( now );
+
+    return now;
+}
+
+int main( void )
+{
+    mtime_t now = CLOCK_FREQ;
+
+    /* one less than a storm, then spread out */
+    now = test_plis( now, RTCP_FB_STORM - 1, CLOCK_FREQ / 10 );
+    TEST_CHECK( src.fb != NULL );
+    if( src.fb == NULL )
+        return TEST_RESULT();
+    TEST_CHECK( src.fb->i_storms == 0 );
+
+    now += 2 * CLOCK_FREQ;
+    now = test_plis( now, RTCP_FB_STORM, CLOCK_FREQ / 2 );
+    TEST_CHECK( src.fb->i_storms == 0 );
+
+    /* exactly a storm */
+    now += 2 * CLOCK_FREQ;
+    now = test_plis( now, RTCP_FB_STORM, CLOCK_FREQ / (2 * RTCP_FB_STORM) );
+    TEST_CHECK( src.fb->i_storms == 1 );
+    TEST_CHECK( src.fb->b_storm );
+
+    /* still the same storm */
+    test_pli( now );
+    TEST_CHECK( src.fb->i_storms == 1 );
+
+    TEST_CHECK( src.fb->i_pli == 3 * RTCP_FB_STORM );
+
+    rtcp_fb_destroy( src.fb );
+
+    return TEST_RESULT();
+}